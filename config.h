@@ -146,7 +146,9 @@
     !defined(VFS_DF_SUPPORT)         && \
     !defined(VFS_EEPROM_SUPPORT)     && \
     !defined(VFS_EEPROM_RAW_SUPPORT) && \
-    !defined(VFS_DC3840_SUPPORT)
+    !defined(VFS_DC3840_SUPPORT)     && \
+    !defined(VFS_SRAM_SUPPORT)       && \
+    !defined(CAPTURE_SUPPORT)
 #  define VFS_TEENSY 1
 #endif
 
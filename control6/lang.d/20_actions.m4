@@ -3,7 +3,9 @@
 ################################
 define(`THREAD', `define(`action_thread_ident', __line__)divert(0)dnl
  {0, {0} },define(`action_thread_$1_idx', action_thread_count)dnl
+define(`action_thread_cur', action_thread_count)dnl
 define(`action_thread_count', incr(action_thread_count))dnl
+THREAD_NAME($1)dnl
 divert(action_divert)dnl
 
 /* Thread: action_thread_ident */
@@ -12,9 +14,25 @@ static
 PT_THREAD(action_thread_$1(struct pt *pt)) {
   PT_BEGIN(pt);
 divert(normal_end_divert)
-  if (action_threads[action_thread_$1_idx].started) { THREAD_DO($1) }dnl
+  if (action_threads[action_thread_$1_idx].started
+      && c6_runnable(&action_threads[action_thread_$1_idx])) { THREAD_DO($1) }dnl
 divert(action_divert)')
 
+dnl Thread names for the "c6 threads" statistics, see CONTROL_END.
+define(`THREAD_NAME', `ifdef(`threads_used', `', `dnl
+define(`threads_used')dnl
+divert(action_names_divert)dnl
+#ifdef CONTROL6_STATS_SUPPORT
+PGM_P const action_thread_names[] PROGMEM = {
+')dnl
+divert(globals_divert)dnl
+#ifdef CONTROL6_STATS_SUPPORT
+const char PROGMEM action_thread_$1_name[] = "$1";
+#endif
+divert(action_names_divert)dnl
+  action_thread_$1_name,
+')
+
 define(`INTHREAD', `ifdef(`action_thread_ident', `$1', `$2')')
 define(`DIE', `errprint(`ERROR: $1
 ')m4exit(255)')
@@ -36,13 +54,106 @@ define(`THREAD_STOP',  `action_threads[action_thread_$1_idx].started = 0;')
 define(`THREAD_WAIT',  `action_threads[action_thread_$1_idx].started = 0;
 PT_WAIT_WHILE(pt, action_threads[action_thread_$1_idx].started == 1);')
 define(`THREAD_RESTART',  `do { action_threads[action_thread_$1_idx].started = 1; 
+  action_threads[action_thread_$1_idx].sleep = 0;
   PT_INIT(&action_threads[action_thread_$1_idx].pt); } while(0);')
+
+dnl Parking threads: a thread in WAIT_MS or WAIT_EVENT sets sleep and is
+dnl not scheduled by control6_run until its deadline has passed or an event
+dnl (pin change, UDP/TCP data, ECMD variable write) has been signalled.
+define(`WAIT_MS', `INTHREAD(`', `DIE(`WAIT_MS outside of THREAD')')dnl
+action_threads[action_thread_cur].wake = c6_now + C6_MS2TICKS($1);
+  PT_WAIT_UNTIL(pt, c6_timer_expired(&action_threads[action_thread_cur]));')
+define(`WAIT_EVENT', `INTHREAD(`', `DIE(`WAIT_EVENT outside of THREAD')')dnl
+PT_WAIT_UNTIL(pt, c6_event_wait(&action_threads[action_thread_cur], ($1)));')
+define(`EVENT_SIGNAL', `c6_event = 1')
+
 divert(action_table_divert)dnl
+#if ARCH == ARCH_HOST
+#include <sys/time.h>
+#define C6_TICKS_PER_SEC 1000
+#else
+#include <util/atomic.h>
+#include "core/periodic.h"
+#define C6_TICKS_PER_SEC CONF_MTICKS_PER_SEC
+#endif
+
+/* Milliseconds to scheduler ticks, without overflowing for long waits. */
+#define C6_MS2TICKS(ms) ((uint32_t) (ms) / 1000 * C6_TICKS_PER_SEC + \
+			 (uint32_t) (ms) % 1000 * C6_TICKS_PER_SEC / 1000)
+
+#define C6_SLEEP_TIMER	1
+#define C6_SLEEP_EVENT	2
+
 struct action {
   uint8_t started;
   struct pt pt;
+  uint8_t sleep;
+  uint32_t wake;
+#ifdef CONTROL6_STATS_SUPPORT
+  uint32_t runs;
+  uint32_t skips;
+#endif
 };
 
+/* Scheduler time of the current control6_run pass. */
+uint32_t c6_now;
+/* Set by the event sources, collected at the start of control6_run. */
+uint8_t c6_event;
+uint8_t c6_event_run;
+
+static inline uint32_t
+c6_clock(void)
+{
+#if ARCH == ARCH_HOST
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#else
+  uint32_t now;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    now = periodic_mticks_count;
+  }
+  return now;
+#endif
+}
+
+static inline uint8_t
+c6_runnable(struct action *a)
+{
+  if ((a->sleep == C6_SLEEP_TIMER && (int32_t) (c6_now - a->wake) < 0)
+      || (a->sleep == C6_SLEEP_EVENT && !c6_event_run))
+  {
+#ifdef CONTROL6_STATS_SUPPORT
+    a->skips++;
+#endif
+    return 0;
+  }
+  a->sleep = 0;
+#ifdef CONTROL6_STATS_SUPPORT
+  a->runs++;
+#endif
+  return 1;
+}
+
+static inline uint8_t
+c6_timer_expired(struct action *a)
+{
+  if ((int32_t) (c6_now - a->wake) >= 0)
+    return 1;
+  a->sleep = C6_SLEEP_TIMER;
+  return 0;
+}
+
+static inline uint8_t
+c6_event_wait(struct action *a, uint8_t cond)
+{
+  if (cond)
+    return 1;
+  a->sleep = C6_SLEEP_EVENT;
+  return 0;
+}
+
 define(`THREAD_EXIT', `PT_EXIT (pt);')
 
 define(`THREAD_STARTED', `action_threads[action_thread_$1_idx].started')
@@ -17,7 +17,10 @@ struct c6_option_t {
 struct c6_option_t c6_ecmd_vars[] = {
   /* hier alle variablen definieren */
 divert(init_divert)void control6_init(void) {
-divert(normal_start_divert)void control6_run(void) { dnl
+divert(normal_start_divert)void control6_run(void) {
+  c6_event_run = c6_event;
+  c6_event = 0;
+  c6_now = c6_clock();
 divert(normal_divert)')
 define(`CONTROL_END', `divert(control_end_divert)
 }
@@ -34,6 +37,7 @@ divert(ecmd_variable_divert)dnl
   for(i = 0;i < ' ecmd_global_count `;i ++) {
     if (strcmp_P(varname, c6_ecmd_vars[i].name) == 0) {
       c6_ecmd_vars[i].value = value;
+      c6_event = 1;
       return 1;
     }
   }
@@ -54,15 +58,33 @@ uint8_t control6_get(const char *varname, struct c6_vario_type *value) {
 divert(timer_divert)
 };
 
-divert(pin_table_divert)
+divert(pin_table_divert)pin_table_text
 };
 
 divert(init_divert)dnl
+pin_init_text`'dnl
 }
 
+divert(update_pin_divert)dnl
+pin_update_text`'dnl
+
 divert(action_table_divert)
 };
 
+ifdef(`threads_used', `divert(action_names_divert)};
+
+#define C6_THREADS 'action_thread_count`
+#include "control6/threads_ecmd.c"
+#endif  /* CONTROL6_STATS_SUPPORT */
+
+/*
+  -- Ethersex META --
+    ecmd_ifdef(CONTROL6_STATS_SUPPORT)
+      ecmd_feature(c6_threads, "c6 threads",, List the Control6 threads with their state and run statistics)
+    ecmd_endif()
+*/
+')dnl
+
 divert(control_end_divert)
 ')
 
@@ -22,5 +22,6 @@ divert(old_divert)')dnl
 (current_time - timers[timer_$1])')
 
 define(`TIMER_WAIT', `PT_WAIT_UNTIL(pt, TIMER($1) >= $2);')
-define(`WAIT', `TIMER_START(`timer_on_'action_thread_ident); TIMER_WAIT(`timer_on_'action_thread_ident, ($1));')
+define(`WAIT', `INTHREAD(`WAIT_MS((uint32_t) ($1) * 1000)',
+  `TIMER_START(`timer_on_'__line__); TIMER_WAIT(`timer_on_'__line__, ($1));')')
 
@@ -91,8 +91,10 @@ define(`TCP_HANDLER_END', `
     PT_END(pt);
   }
 
-  if (uip_newdata ())
+  if (uip_newdata ()) {
     ((char *) uip_appdata)[uip_len] = 0;
+    c6_event = 1;
+  }
 
   if (uip_rexmit ())
     /* restore old lc context to automatically do the retransmit */
@@ -110,8 +110,10 @@ define(`UDP_HANDLER_END', `
     PT_END(pt);
   }
 
-  if (uip_newdata ())
+  if (uip_newdata ()) {
     ((char *) uip_appdata)[uip_len] = 0;
+    c6_event = 1;
+  }
 
   inline_thread(&UDP_STATE->pt);
 }
@@ -18,22 +18,41 @@ divert(old_divert)dnl')
 define(`PIN_PULLUP', `define(`old_divert', divnum)divert(init_divert)  PIN_SET($1);
 divert(old_divert)dnl')
 
-define(`PIN_NEW', `ifdef(`pin_$1_used', `', `define(`pin_$1_used')define(`old_divert', divnum)dnl
-divert(pin_table_divert)  { 0 },dnl
+dnl PIN_NEW only collects the pin table, init and update code in macros
+dnl (written out by CONTROL_END), so it also works within the arguments of
+dnl other macros, e.g. WAIT_EVENT(PIN_RISING(KEY)).
+define(`pin_table_text', `')
+define(`pin_init_text', `')
+define(`pin_update_text', `')
+define(`PIN_NEW', `ifdef(`pin_$1_used', `', `define(`pin_$1_used')dnl
 define(`pin_$1_idx', pin_count)dnl
 define(`pin_count', incr(pin_count))dnl
-divert(init_divert) pin_states[pin_$1_idx].old_state = PIN_HIGH($1) ? 1 : 0; 
-divert(update_pin_divert)  
-  pin_states[pin_$1_idx].old_state = PIN_HIGH($1) ? 1 : 0; 
-divert(old_divert)')')
+define(`pin_table_text', defn(`pin_table_text')`  { 0 },')dnl
+define(`pin_init_text', defn(`pin_init_text')` pin_states['pin_$1_idx`].old_state = PIN_HIGH($1) ? 1 : 0; 
+')dnl
+define(`pin_update_text', defn(`pin_update_text')`  
+  pin_states['pin_$1_idx`].edge = 0;
+  if (pin_states['pin_$1_idx`].old_state != (PIN_HIGH($1) ? 1 : 0)) {
+    pin_states['pin_$1_idx`].old_state ^= 1;
+    pin_states['pin_$1_idx`].edge = pin_states['pin_$1_idx`].old_state
+      ? PIN_EDGE_RISING : PIN_EDGE_FALLING;
+    c6_event = 1;
+  }
+')')')
 
-define(`PIN_RISING', `PIN_NEW($1)(!pin_states[pin_$1_idx].old_state && PIN_HIGH($1))')
-define(`PIN_FALLING', `PIN_NEW($1)(pin_states[pin_$1_idx].old_state && !PIN_HIGH($1))')
+dnl The edge seen at the end of a pass is latched for the whole next pass,
+dnl so that threads parked in WAIT_EVENT and woken by it still see it.
+define(`PIN_RISING', `PIN_NEW($1)(pin_states[pin_$1_idx].edge == PIN_EDGE_RISING)')
+define(`PIN_FALLING', `PIN_NEW($1)(pin_states[pin_$1_idx].edge == PIN_EDGE_FALLING)')
 define(`PIN_LOW', `!PIN_HIGH($1)')
 
 divert(pin_table_divert)
+#define PIN_EDGE_RISING		1
+#define PIN_EDGE_FALLING	2
+
 struct pin_state {
   uint8_t old_state;
+  uint8_t edge;
 };
 
 struct pin_state pin_states[] ={
@@ -0,0 +1,35 @@
+################################
+# ECMD CALL
+################################
+define(`ECMD_CALL_USED', `ifdef(`ecmd_call_used', `', `dnl
+define(`ecmd_call_used')dnl
+divert(globals_divert)
+#ifndef ECMD_PARSER_SUPPORT
+#error Please define ECMD
+#endif
+
+#include "protocols/ecmd/parser.h"
+#include "protocols/ecmd/via_tcp/ecmd_state.h"
+
+static int16_t
+c6_ecmd_call(ecmd_handler_t func, PGM_P args)
+{
+  char output[ECMD_OUTPUTBUF_LENGTH];
+  return ecmd_call_P(func, args, output, sizeof(output));
+}
+
+')dnl
+ifdef(`ecmd_call_$1_used', `', `dnl
+define(`ecmd_call_$1_used')dnl
+divert(globals_divert)dnl
+int16_t parse_cmd_$1(char *cmd, char *output, uint16_t len);
+')')
+
+dnl ==========================================================================
+dnl ECMD_CALL(name, args)
+dnl   Call the local ECMD command name (the first argument of its
+dnl   ecmd_feature) with the string args, the handler is bound at build time.
+dnl   Returns the length of the output like ecmd_parse_command.
+dnl ==========================================================================
+define(`ECMD_CALL', `define(`old_divert', divnum)ECMD_CALL_USED($1)divert(old_divert)dnl
+c6_ecmd_call(parse_cmd_$1, PSTR($2))')
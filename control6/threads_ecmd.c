@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Included by the generated control6.c, which provides action_threads,
+   action_thread_names and C6_THREADS. */
+
+#include <stdio.h>
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* The name and the state of a thread go into separate lines, so that
+   long names and large counters fit the ecmd output buffer. */
+typedef struct
+{
+  uint8_t magic;
+  uint8_t slot;
+  uint8_t counters;
+} c6_threads_state_t;
+
+int16_t
+parse_cmd_c6_threads(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  c6_threads_state_t *state = (c6_threads_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->slot = 0;
+    state->counters = 0;
+  }
+
+  if (state->slot >= C6_THREADS)
+    return ECMD_FINAL_OK;
+
+  if (!state->counters)
+  {
+    PGM_P name = (PGM_P) pgm_read_word(&action_thread_names[state->slot]);
+    state->counters = 1;
+    int16_t n = snprintf_P(output, len, PSTR("%S"), name);
+    return ECMD_AGAIN(n < len ? n : len - 1);
+  }
+
+  struct action *a = &action_threads[state->slot++];
+  state->counters = 0;
+
+  /* state: s = stopped, r = runnable, t = waiting for the timer,
+     e = waiting for an event */
+  char c = !a->started ? 's' : a->sleep == C6_SLEEP_TIMER ? 't' :
+    a->sleep == C6_SLEEP_EVENT ? 'e' : 'r';
+
+  return ECMD_AGAIN(snprintf_P(output, len, PSTR("  %c %lu %lu"), c,
+                               a->runs, a->skips));
+}
@@ -53,6 +53,8 @@ crc_checksum (void *data, uint8_t length)
 
 #ifdef EEPROM_SUPPORT
 
+#ifndef EEPROM_WRITE_BEHIND_SUPPORT
+
 void
 eeprom_write_block_hack (void *dst, const void *src, size_t n)
 {
@@ -78,6 +80,334 @@ eeprom_get_chksum (void)
   return eeprom_crc;
 }
 
+#else /* EEPROM_WRITE_BEHIND_SUPPORT */
+
+/* Bytes to be written are queued and written by the EE_READY interrupt,
+ * one byte per ~3.3ms, instead of busy-waiting in the mainloop.  Bytes
+ * that already hold the requested value are not queued at all.
+ *
+ * The config crc is kept in RAM and updated incrementally: the Dallas
+ * crc8 is linear, so changing byte i from a to b changes the crc by
+ * crc(a ^ b followed by the remaining zero bytes).  Feeding 127 zero
+ * bytes maps any crc onto itself, so at most 126 crc steps are needed
+ * per changed byte, no matter how large struct eeprom_config_t is. */
+
+#define EEPROM_CRC_ZERO_PERIOD 127
+#define EEPROM_CRC_LEN (sizeof (struct eeprom_config_t) - 1)
+
+struct eeprom_wb_entry_t
+{
+  uint16_t addr;
+  uint8_t value;
+};
+
+static struct eeprom_wb_entry_t eeprom_wb_queue[CONF_EEPROM_WB_QUEUE_LEN];
+static volatile uint8_t eeprom_wb_head;
+static volatile uint8_t eeprom_wb_count;
+
+static uint8_t eeprom_crc;
+static uint8_t eeprom_crc_valid;
+
+#if ARCH == ARCH_HOST
+/* no interrupt on host, eeprom_wb_process drains the queue instead */
+#define EEPROM_WB_LOCK()
+#define EEPROM_WB_UNLOCK()
+#else
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#ifndef EEPE
+#define EEPE  EEWE
+#define EEMPE EEMWE
+#endif
+#define EEPROM_WB_LOCK()    (EECR &= (uint8_t) ~_BV(EERIE))
+#define EEPROM_WB_UNLOCK() \
+  do { if (eeprom_wb_count) EECR |= _BV(EERIE); } while (0)
+#endif
+
+/* Write the oldest queued byte, must be called with the queue locked
+ * or from the EE_READY interrupt. */
+static void
+eeprom_wb_write_next (void)
+{
+  struct eeprom_wb_entry_t *e = &eeprom_wb_queue[eeprom_wb_head];
+
+#if ARCH == ARCH_HOST
+  eeprom_write_byte ((uint8_t *) e->addr, e->value);
+#else
+  /* EEPE must be set within four cycles after EEMPE */
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    EEAR = e->addr;
+    EEDR = e->value;
+    EECR |= _BV(EEMPE);
+    EECR |= _BV(EEPE);
+  }
+#endif
+
+  if (++eeprom_wb_head >= CONF_EEPROM_WB_QUEUE_LEN)
+    eeprom_wb_head = 0;
+  eeprom_wb_count--;
+}
+
+#if ARCH == ARCH_HOST
+void
+eeprom_wb_process (void)
+{
+  if (eeprom_wb_count)
+    eeprom_wb_write_next ();
+}
+#else
+ISR (EE_READY_vect)
+{
+  if (eeprom_wb_count)
+    eeprom_wb_write_next ();
+  else
+    EECR &= (uint8_t) ~_BV(EERIE);
+}
+#endif
+
+/* Returns the queue entry for addr or NULL, queue must be locked. */
+static struct eeprom_wb_entry_t *
+eeprom_wb_find (uint16_t addr)
+{
+  uint8_t idx = eeprom_wb_head;
+  for (uint8_t i = 0; i < eeprom_wb_count; i++)
+    {
+      if (eeprom_wb_queue[idx].addr == addr)
+        return &eeprom_wb_queue[idx];
+      if (++idx >= CONF_EEPROM_WB_QUEUE_LEN)
+        idx = 0;
+    }
+  return NULL;
+}
+
+/* Current value of addr, including pending writes, queue must be locked. */
+static uint8_t
+eeprom_wb_read_byte (uint16_t addr)
+{
+  struct eeprom_wb_entry_t *e = eeprom_wb_find (addr);
+  if (e)
+    return e->value;
+
+  eeprom_busy_wait ();
+  return eeprom_read_byte ((uint8_t *) addr);
+}
+
+static void
+eeprom_wb_flush_one (void)
+{
+  eeprom_busy_wait ();
+  eeprom_wb_write_next ();
+}
+
+void
+eeprom_flush (void)
+{
+  EEPROM_WB_LOCK ();
+  while (eeprom_wb_count)
+    eeprom_wb_flush_one ();
+  eeprom_busy_wait ();
+}
+
+/* Crc difference caused by changing the byte at pos by delta. */
+static uint8_t
+eeprom_crc_delta (uint16_t pos, uint8_t delta)
+{
+  uint8_t crc = _crc_ibutton_update (0, delta);
+  uint8_t zeros = (EEPROM_CRC_LEN - 1 - pos) % EEPROM_CRC_ZERO_PERIOD;
+
+  while (zeros--)
+    crc = _crc_ibutton_update (crc, 0);
+
+  return crc;
+}
+
+static uint8_t
+eeprom_crc_calc (void)
+{
+  uint8_t crc = 0;
+
+  for (uint16_t i = 0; i < EEPROM_CRC_LEN; i++)
+    crc = _crc_ibutton_update (crc, eeprom_wb_read_byte (i));
+
+  return crc;
+}
+
+void
+eeprom_write_block_hack (void *dst, const void *src, size_t n)
+{
+  uint16_t addr = (uint16_t) (size_t) dst;
+  const uint8_t *p = src;
+
+  EEPROM_WB_LOCK ();
+  if (!eeprom_crc_valid)
+    {
+      eeprom_crc = eeprom_crc_calc ();
+      eeprom_crc_valid = 1;
+    }
+
+  for (; n; n--, addr++, p++)
+    {
+      struct eeprom_wb_entry_t *e = eeprom_wb_find (addr);
+      uint8_t old = e ? e->value : eeprom_wb_read_byte (addr);
+
+      if (old == *p)
+        continue;
+
+      if (addr < EEPROM_CRC_LEN)
+        eeprom_crc ^= eeprom_crc_delta (addr, old ^ *p);
+
+      if (e)
+        {
+          e->value = *p;
+          continue;
+        }
+
+      if (eeprom_wb_count == CONF_EEPROM_WB_QUEUE_LEN)
+        eeprom_wb_flush_one ();
+
+      uint8_t idx = eeprom_wb_head + eeprom_wb_count;
+      if (idx >= CONF_EEPROM_WB_QUEUE_LEN)
+        idx -= CONF_EEPROM_WB_QUEUE_LEN;
+      eeprom_wb_queue[idx].addr = addr;
+      eeprom_wb_queue[idx].value = *p;
+      eeprom_wb_count++;
+    }
+  EEPROM_WB_UNLOCK ();
+}
+
+void
+eeprom_read_block_hack (void *dst, const void *src, size_t n)
+{
+  uint16_t addr = (uint16_t) (size_t) src;
+  uint8_t *p = dst;
+
+  EEPROM_WB_LOCK ();
+  if (eeprom_wb_count)
+    {
+      while (n--)
+        *p++ = eeprom_wb_read_byte (addr++);
+    }
+  else
+    {
+      eeprom_busy_wait ();
+      eeprom_read_block (dst, src, n);
+    }
+  EEPROM_WB_UNLOCK ();
+}
+
+uint8_t
+eeprom_get_chksum (void)
+{
+  if (!eeprom_crc_valid)
+    {
+      EEPROM_WB_LOCK ();
+      eeprom_crc = eeprom_crc_calc ();
+      eeprom_crc_valid = 1;
+      EEPROM_WB_UNLOCK ();
+    }
+
+  return eeprom_crc;
+}
+
+#endif /* EEPROM_WRITE_BEHIND_SUPPORT */
+
+
+#ifdef EEPROM_WEAR_SUPPORT
+
+/* Slot crc covers the sequence number and the payload. */
+static uint8_t
+eeprom_wear_slot_crc (uint8_t *slot, uint8_t len, uint8_t *seq)
+{
+  uint8_t buf[8];
+  uint8_t crc = 0;
+
+  eeprom_read_block_hack (seq, slot, 1);
+  crc = _crc_ibutton_update (crc, *seq);
+  slot++;
+
+  while (len)
+    {
+      uint8_t n = len > sizeof (buf) ? sizeof (buf) : len;
+      eeprom_read_block_hack (buf, slot, n);
+      for (uint8_t i = 0; i < n; i++)
+        crc = _crc_ibutton_update (crc, buf[i]);
+      slot += n;
+      len -= n;
+    }
+
+  return crc;
+}
+
+/* Find the most recent valid slot, returns CONF_EEPROM_WEAR_SLOTS if there
+ * is none.  Sequence numbers of valid slots are only a few steps apart, so
+ * serial number arithmetic picks the newest one even after the counter
+ * wrapped. */
+static uint8_t
+eeprom_wear_find (uint8_t *base, uint8_t len, uint8_t *seq)
+{
+  uint8_t newest = CONF_EEPROM_WEAR_SLOTS;
+  uint8_t *slot = base;
+
+  for (uint8_t i = 0; i < CONF_EEPROM_WEAR_SLOTS; i++)
+    {
+      uint8_t s, crc;
+      eeprom_read_block_hack (&crc, slot + len + 1, 1);
+      if (eeprom_wear_slot_crc (slot, len, &s) == crc && s != 0xff &&
+          (newest == CONF_EEPROM_WEAR_SLOTS || (int8_t) (s - *seq) > 0))
+        {
+          newest = i;
+          *seq = s;
+        }
+      slot += EEPROM_WEAR_SLOT_SIZE (len);
+    }
+
+  return newest;
+}
+
+void
+eeprom_wear_write (uint8_t *base, uint8_t len, const void *data)
+{
+  uint8_t seq = 0;
+  uint8_t idx = eeprom_wear_find (base, len, &seq);
+
+  if (idx == CONF_EEPROM_WEAR_SLOTS)
+    idx = 0;
+  else if (++idx == CONF_EEPROM_WEAR_SLOTS)
+    idx = 0;
+
+  uint8_t *slot = base + idx * EEPROM_WEAR_SLOT_SIZE (len);
+  const uint8_t *p = data;
+
+  /* 0xff is never used, so an erased slot is never taken for valid */
+  if (++seq == 0xff)
+    seq = 0;
+  uint8_t crc = _crc_ibutton_update (0, seq);
+  for (uint8_t i = 0; i < len; i++)
+    crc = _crc_ibutton_update (crc, p[i]);
+
+  eeprom_write_block_hack (slot, &seq, 1);
+  eeprom_write_block_hack (slot + 1, data, len);
+  eeprom_write_block_hack (slot + len + 1, &crc, 1);
+}
+
+uint8_t
+eeprom_wear_read (uint8_t *base, uint8_t len, void *data)
+{
+  uint8_t seq = 0;
+  uint8_t idx = eeprom_wear_find (base, len, &seq);
+
+  if (idx == CONF_EEPROM_WEAR_SLOTS)
+    return 0;
+
+  eeprom_read_block_hack (data, base + idx * EEPROM_WEAR_SLOT_SIZE (len) + 1,
+                          len);
+  return 1;
+}
+
+#endif /* EEPROM_WEAR_SUPPORT */
+
 
 
 void
@@ -128,6 +458,12 @@ eeprom_init (void)
   eeprom_save (stella_channel_values, stella_temp, 10);
 #endif
 
+#if defined(EEPROM_WEAR_SUPPORT) && defined(STELLA_SUPPORT)
+  /* supersede stale slots left over from before the reset */
+  uint8_t stella_wear_temp[STELLA_CHANNELS] = { 0 };
+  eeprom_wear_save (stella_channel_values, stella_wear_temp, STELLA_CHANNELS);
+#endif
+
 #ifdef DMX_FXSLOT_SUPPORT
   struct fxslot_struct_stripped fxslots_temp[DMX_FXSLOT_AMOUNT] = { {0,0,0,0,0,0,0} };
   eeprom_save (dmx_fxslots, fxslots_temp, DMX_FXSLOT_AMOUNT*sizeof(struct fxslot_struct_stripped));
@@ -180,6 +516,12 @@ eeprom_init (void)
   };
   eeprom_save (tanklevel_params, &tanklevel_temp, sizeof(tanklevel_params_t));
 #endif
+
+#ifdef UIP_ROUTE_SUPPORT
+  struct route_entry_t route_temp[CONF_UIP_ROUTES];
+  memset (route_temp, ROUTE_UNUSED, sizeof (route_temp));
+  eeprom_save (route_table, route_temp, sizeof (route_temp));
+#endif
   eeprom_update_chksum ();
 }
 
@@ -73,6 +73,10 @@
 #include "services/spotlight/spotlight.h"
 #endif
 
+#ifdef UIP_ROUTE_SUPPORT
+#include "protocols/uip/uip_route.h"
+#endif
+
 struct eeprom_config_t
 {
 #ifdef ETHERNET_SUPPORT
@@ -151,16 +155,72 @@ struct eeprom_config_t
 #ifdef SPOTLIGHT_SUPPORT
   spotlight_params_t spotlight_params;
 #endif
+
+#ifdef UIP_ROUTE_SUPPORT
+  struct route_entry_t route_table[CONF_UIP_ROUTES];
+#endif
   uint8_t crc;
 };
 
 
 #define EEPROM_CONFIG_BASE  (uint8_t *)0x0000
 
+#ifdef EEPROM_WEAR_SUPPORT
+/* Each slot holds a sequence number, the payload and a crc over both. */
+#define EEPROM_WEAR_SLOT_SIZE(len)  ((len) + 2)
+
+/* Frequently changing values are kept outside of struct eeprom_config_t,
+ * so updating them neither touches the config crc nor wears out a single
+ * cell.  Every value rotates through CONF_EEPROM_WEAR_SLOTS slots. */
+struct eeprom_wear_t
+{
+#ifdef STELLA_SUPPORT
+  uint8_t stella_channel_values[CONF_EEPROM_WEAR_SLOTS]
+    [EEPROM_WEAR_SLOT_SIZE(STELLA_CHANNELS)];
+#endif
+};
+
+#define EEPROM_WEAR_BASE \
+  (EEPROM_CONFIG_BASE + sizeof(struct eeprom_config_t))
+
+/* First byte not used by the configuration. */
+#define EEPROM_CONFIG_END \
+  (sizeof(struct eeprom_config_t) + sizeof(struct eeprom_wear_t))
+#else
+#define EEPROM_CONFIG_END (sizeof(struct eeprom_config_t))
+#endif /* EEPROM_WEAR_SUPPORT */
+
 
 uint8_t crc_checksum (void *data, uint8_t length);
 void eeprom_write_block_hack (void *dst, const void *src, size_t n);
 
+#if defined(EEPROM_SUPPORT) && defined(EEPROM_WRITE_BEHIND_SUPPORT)
+/* Like eeprom_read_block, but also sees data still sitting in the
+ * write-behind queue. */
+void eeprom_read_block_hack (void *dst, const void *src, size_t n);
+
+/* Synchronously write out all queued bytes. */
+void eeprom_flush (void);
+#else
+#define eeprom_read_block_hack(dst, src, n) eeprom_read_block(dst, src, n)
+#define eeprom_flush()
+#endif
+
+#ifdef EEPROM_WEAR_SUPPORT
+/* Write len bytes of data to the next slot of the ring at base. */
+void eeprom_wear_write (uint8_t *base, uint8_t len, const void *data);
+
+/* Read the most recent slot of the ring at base, returns 0 if the ring
+ * holds no valid slot at all. */
+uint8_t eeprom_wear_read (uint8_t *base, uint8_t len, void *data);
+
+#define eeprom_wear_save(dst, data, len) \
+  eeprom_wear_write(EEPROM_WEAR_BASE + offsetof(struct eeprom_wear_t, dst), len, data)
+
+#define eeprom_wear_restore(dst, mem, len) \
+  eeprom_wear_read(EEPROM_WEAR_BASE + offsetof(struct eeprom_wear_t, dst), len, mem)
+#endif
+
 /* Reset the EEPROM to sane defaults. */
 void eeprom_reset (void);
 
@@ -187,10 +247,10 @@ uint8_t eeprom_get_chksum (void);
 
 /* Reads len byte from eeprom at dst into mem */
 #define eeprom_restore(dst, mem, len) \
-  eeprom_read_block(mem, EEPROM_CONFIG_BASE + offsetof(struct eeprom_config_t, dst), len)
+  eeprom_read_block_hack(mem, EEPROM_CONFIG_BASE + offsetof(struct eeprom_config_t, dst), len)
 
 #define eeprom_restore_offset(dst, off, mem, len) \
-  eeprom_read_block(mem, EEPROM_CONFIG_BASE + offsetof(struct eeprom_config_t, dst) + off, len)
+  eeprom_read_block_hack(mem, EEPROM_CONFIG_BASE + offsetof(struct eeprom_config_t, dst) + off, len)
 
 #define eeprom_restore_ip(dst,mem) \
     eeprom_restore(dst, mem, IPADDR_LEN)
@@ -24,12 +24,20 @@
 #define EEPROM_SIZE 2048
 extern uint8_t eeprom_data[EEPROM_SIZE];
 
-#define eeprom_write_byte(ptr,val)	(eeprom_data[(int)ptr] = val)
+#define eeprom_write_byte(ptr,val)	eeprom_host_write_byte((int)ptr, val)
 
 #define eeprom_read_byte(ptr)		(eeprom_data[(int)ptr])
 #define eeprom_read_block(dst,src,n)	memmove(dst,&eeprom_data[(int)src],n)
+#define eeprom_busy_wait()		do { } while (0)
+#define eeprom_is_ready()		1
 
+void eeprom_host_write_byte (int addr, uint8_t val);
 void eeprom_host_init (void);
 void eeprom_host_exit (void);
 
+#ifdef EEPROM_WRITE_BEHIND_SUPPORT
+/* Emulates the EE_READY interrupt, one byte per mainloop pass. */
+void eeprom_wb_process (void);
+#endif
+
 #endif	/* HOST_AVR_EEPROM_H */
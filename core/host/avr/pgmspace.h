@@ -37,6 +37,7 @@ int snprintf_P (char *, int, const char *fmt, ...);
 #define strstr_P(a...)		strstr(a)
 #define strcat_P(a...)		strcat(a)
 #define strcpy_P(a...)		strcpy(a)
+#define strncpy_P(a...)		strncpy(a)
 #define strcmp_P(a...)		strcmp(a)
 #define strncmp_P(a...)		strncmp(a)
 #define strncasecmp_P(a...)	strncasecmp(a)
@@ -17,17 +17,34 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
 
+#include "config.h"
+#include "core/eeprom.h"
 #include "core/host/avr/eeprom.h"
 
 uint8_t eeprom_data[EEPROM_SIZE];
 
+/* Write cycles per cell, to check the wear caused by the firmware. */
+static uint32_t eeprom_host_cycles[EEPROM_SIZE];
+
+void
+eeprom_host_write_byte (int addr, uint8_t val)
+{
+  eeprom_host_cycles[addr]++;
+  eeprom_data[addr] = val;
+}
+
 void
 eeprom_host_init (void)
 {
+  /* erased cells read as 0xff, just like on the real device */
+  memset (eeprom_data, 0xff, EEPROM_SIZE);
+
   int fd = open ("eeprom.bin", O_RDONLY);
   if (fd < 0) return;
 
@@ -38,6 +55,23 @@ eeprom_host_init (void)
 void
 eeprom_host_exit (void)
 {
+  uint32_t total = 0, max = 0;
+  int max_addr = 0;
+
+  eeprom_flush ();
+
+  for (int i = 0; i < EEPROM_SIZE; i++)
+    {
+      total += eeprom_host_cycles[i];
+      if (eeprom_host_cycles[i] > max)
+	{
+	  max = eeprom_host_cycles[i];
+	  max_addr = i;
+	}
+    }
+  printf ("eeprom: %u write cycles, max %u at 0x%03x\n",
+	  (unsigned) total, (unsigned) max, max_addr);
+
   int fd = open ("eeprom.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
   if (fd < 0) return;
 
@@ -50,4 +84,5 @@ eeprom_host_exit (void)
   header(core/host/avr/eeprom.h)
   initearly(eeprom_host_init)
   atexit(eeprom_host_exit)
+  ifdef(`conf_EEPROM_WRITE_BEHIND', `mainloop(eeprom_wb_process)')
 */
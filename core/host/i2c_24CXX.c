@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/* RAM backed emulation of an I2C 24CXX EEPROM, persisted to 24cxx.bin.
+ * Writes behave like on the chip: they wrap around within a chip page
+ * and every write transaction costs one write cycle of that page. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "config.h"
+#include "hardware/i2c/master/i2c_24CXX.h"
+
+#define I2C_24CXX_HOST_PAGES \
+  (CONF_I2C_24CXX_HOST_SIZE / CONF_I2C_24CXX_PAGESIZE)
+
+static uint8_t i2c_24cxx_data[CONF_I2C_24CXX_HOST_SIZE];
+static uint32_t i2c_24cxx_cycles[I2C_24CXX_HOST_PAGES];
+static uint32_t i2c_24cxx_read_bytes;
+
+void
+i2c_24CXX_init (void)
+{
+  memset (i2c_24cxx_data, 0xff, sizeof (i2c_24cxx_data));
+
+  int fd = open ("24cxx.bin", O_RDONLY);
+  if (fd < 0) return;
+
+  read (fd, i2c_24cxx_data, sizeof (i2c_24cxx_data));
+  close (fd);
+}
+
+void
+i2c_24CXX_exit (void)
+{
+  uint32_t total = 0, max = 0;
+
+  for (int i = 0; i < I2C_24CXX_HOST_PAGES; i++)
+    {
+      total += i2c_24cxx_cycles[i];
+      if (i2c_24cxx_cycles[i] > max)
+	max = i2c_24cxx_cycles[i];
+    }
+  printf ("24cxx: %u bytes read, %u write cycles, max %u per page\n",
+	  (unsigned) i2c_24cxx_read_bytes, (unsigned) total, (unsigned) max);
+
+  int fd = open ("24cxx.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return;
+
+  write (fd, i2c_24cxx_data, sizeof (i2c_24cxx_data));
+  close (fd);
+}
+
+uint8_t
+i2c_24CXX_set_addr (uint16_t addr)
+{
+  return addr < CONF_I2C_24CXX_HOST_SIZE;
+}
+
+uint8_t
+i2c_24CXX_read_block (uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  for (uint8_t i = 0; i < len; i++)
+    ptr[i] = i2c_24cxx_data[(addr + i) % CONF_I2C_24CXX_HOST_SIZE];
+
+  i2c_24cxx_read_bytes += len;
+  return len;
+}
+
+static void
+i2c_24CXX_write_page (uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  uint16_t page = (addr % CONF_I2C_24CXX_HOST_SIZE) / CONF_I2C_24CXX_PAGESIZE;
+  uint16_t base = page * CONF_I2C_24CXX_PAGESIZE;
+
+  for (uint8_t i = 0; i < len; i++)
+    i2c_24cxx_data[base + (addr + i) % CONF_I2C_24CXX_PAGESIZE] = ptr[i];
+
+  i2c_24cxx_cycles[page]++;
+}
+
+uint8_t
+i2c_24CXX_write_block (uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  uint8_t written = 0;
+
+  /* split at chip page boundaries, like the real driver does */
+  while (written < len)
+    {
+      uint16_t chunk = CONF_I2C_24CXX_PAGESIZE -
+	(addr + written) % CONF_I2C_24CXX_PAGESIZE;
+      if (chunk > len - written)
+	chunk = len - written;
+
+      i2c_24CXX_write_page (addr + written, ptr + written, chunk);
+      written += chunk;
+    }
+
+  return written;
+}
+
+uint8_t
+i2c_24CXX_write_byte (uint16_t addr, uint8_t data)
+{
+  return i2c_24CXX_write_block (addr, &data, 1);
+}
+
+uint8_t
+i2c_24CXX_compare_block (uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  for (uint8_t i = 0; i < len; i++)
+    if (ptr[i] != i2c_24cxx_data[(addr + i) % CONF_I2C_24CXX_HOST_SIZE])
+      return 0;
+
+  return len;
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/i2c/master/i2c_24CXX.h)
+  initearly(i2c_24CXX_init)
+  atexit(i2c_24CXX_exit)
+*/
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/* RAM backed emulation of the 23K256 serial RAM.  Like the chip it is
+ * cleared on start and addresses wrap around at the end. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "hardware/serial_ram/23k256/sram_23k256.h"
+
+static uint8_t sram23k256_data[SRAM23K256_SIZE];
+static uint32_t sram23k256_read_bytes, sram23k256_written_bytes;
+
+int16_t
+sram23k256_init (void)
+{
+  memset (sram23k256_data, 0, sizeof (sram23k256_data));
+  return 0;
+}
+
+void
+sram23k256_exit (void)
+{
+  printf ("23k256: %u bytes read, %u bytes written\n",
+	  (unsigned) sram23k256_read_bytes,
+	  (unsigned) sram23k256_written_bytes);
+}
+
+void
+sram23k256_read (uint16_t address_ui16, uint8_t dataPtr_pui8[],
+		 uint8_t len_ui8)
+{
+  for (uint8_t i = 0; i < len_ui8; i++)
+    dataPtr_pui8[i] = sram23k256_data[(address_ui16 + i) % SRAM23K256_SIZE];
+  sram23k256_read_bytes += len_ui8;
+}
+
+void
+sram23k256_write (uint16_t address_ui16, uint8_t dataPtr_pui8[],
+		  uint8_t len_ui8)
+{
+  for (uint8_t i = 0; i < len_ui8; i++)
+    sram23k256_data[(address_ui16 + i) % SRAM23K256_SIZE] = dataPtr_pui8[i];
+  sram23k256_written_bytes += len_ui8;
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/serial_ram/23k256/sram_23k256.h)
+  initearly(sram23k256_init)
+  atexit(sram23k256_exit)
+*/
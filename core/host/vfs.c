@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #include "core/vfs/vfs.h"
 
@@ -84,21 +85,34 @@ vfs_host_close (struct vfs_file_handle_t *fh)
   g_free (fh);
 }
 
+/* Pretend to be a slow SPI/I2C device. */
+#if CONF_VFS_HOST_LATENCY > 0
+#define vfs_host_delay() usleep (CONF_VFS_HOST_LATENCY)
+#else
+#define vfs_host_delay() do { } while (0)
+#endif
+
 vfs_size_t 
 vfs_host_read  (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
 {
-  return read (fh->u.host.fd, buf, length);
+  vfs_host_delay ();
+  ssize_t len = read (fh->u.host.fd, buf, length);
+  return len < 0 ? 0 : len;
 }
 
-/* vfs_size_t 
-vfs_host_size (struct vfs_file_handle_t *)
+vfs_size_t 
+vfs_host_size (struct vfs_file_handle_t *fh)
 {
-  return 0;
-} */
+  struct stat st;
+  if (fstat (fh->u.host.fd, &st) != 0)
+    return 0;
+  return st.st_size;
+}
 
 uint8_t 
 vfs_host_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset, uint8_t whence)
 {
+  vfs_host_delay ();
   off_t o = lseek (fh->u.host.fd, offset, whence);
   if (o == (off_t) -1) return -1;
   return 0;
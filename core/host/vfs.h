@@ -46,7 +46,7 @@ uint8_t vfs_host_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* truncate */		\
     NULL, /* create */			\
     NULL, /* unlink */			\
-    NULL, /* size */			\
+    vfs_host_size,			\
   }
 
 #endif  /* CORE_HOST_VFS_H */
@@ -25,12 +25,16 @@
 #include "config.h"
 #include "core/debug.h"
 #include "core/global.h"
+#include "core/eeprom.h"
 #include "core/mbr.h"
 
 mbr_config_t mbr_config;
 
 void write_mbr(void )
 {
+  /* Queued config bytes must not be overtaken by the mbr write */
+  eeprom_flush();
+
   /* Restore volatile parts */
   mbr_t mbr;
   eeprom_read_block(&mbr, EEPROM_MBR_OFFSET, sizeof(mbr));
@@ -45,6 +49,9 @@ void write_mbr(void )
 
 int restore_mbr(void )
 {
+  /* Don't read behind the back of queued or half written bytes */
+  eeprom_flush();
+
   mbr_t mbr;
   eeprom_read_block(&mbr, EEPROM_MBR_OFFSET, sizeof(mbr));
   memcpy(&mbr_config, &mbr.mbr_config, sizeof(mbr_config_t));
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Run time profiling of the mainloop and timer functions and the main
+ * ISRs.
+ *
+ * The time is taken from the periodic timer, that is in timer counts
+ * (F_CPU / PERIODIC_PRESCALER), which are summed up without a division
+ * so it is cheap enough for ISRs, too.  The ISRs are accounted to the
+ * function they interrupted as well. */
+
+#include <string.h>
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "config.h"
+#include "core/periodic.h"
+#include "prof.h"
+
+#ifdef PERIODIC_ADJUST_SUPPORT
+#define FRAGMENTS_PER_TICK (PERIODIC_COUNTER_COMPARE + 1)
+#else
+#define FRAGMENTS_PER_TICK (PERIODIC_TOP + 1)
+#endif
+
+static const char prof_name_isr_periodic[] PROGMEM = "isr periodic";
+static const char prof_name_isr_clock[] PROGMEM = "isr clock";
+static const char prof_name_isr_ecmd_usart[] PROGMEM = "isr ecmd usart";
+static const char prof_name_dynamic_timers[] PROGMEM = "dynamic timers";
+
+static PGM_P const prof_fixed_names[PROF_FIRST] PROGMEM = {
+  prof_name_isr_periodic,
+  prof_name_isr_clock,
+  prof_name_isr_ecmd_usart,
+  prof_name_dynamic_timers,
+};
+
+
+void
+prof_clear(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    memset(prof_entries, 0,
+           (PROF_FIRST + prof_generated) * sizeof(struct prof_entry_t));
+  }
+}
+
+void
+prof_account(uint8_t slot, periodic_timestamp_t * start)
+{
+  periodic_timestamp_t now;
+  periodic_milliticks(&now);
+
+  uint32_t t = (now.ticks - start->ticks) * FRAGMENTS_PER_TICK
+    + now.fragments - start->fragments;
+  if ((int32_t) t < 0)
+    t = 0;                      /* overflow of the counter not seen yet */
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    struct prof_entry_t *e = &prof_entries[slot];
+    if (e->count != UINT32_MAX)
+      e->count++;
+    e->total = (e->total + t < e->total) ? UINT32_MAX : e->total + t;
+    if (t > e->max)
+      e->max = t;
+  }
+}
+
+uint8_t
+prof_get(uint8_t slot, struct prof_entry_t *entry, PGM_P * name)
+{
+  if (slot >= PROF_FIRST + prof_generated)
+    return 0;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *entry = prof_entries[slot];
+  }
+
+  if (slot < PROF_FIRST)
+    *name = (PGM_P) pgm_read_word(&prof_fixed_names[slot]);
+  else
+    *name = (PGM_P) pgm_read_word(&prof_names[slot - PROF_FIRST]);
+  return 1;
+}
+
+uint32_t
+prof_counts2us(uint32_t counts)
+{
+  return (uint64_t) counts * PERIODIC_PRESCALER * 1000000UL / F_CPU;
+}
+
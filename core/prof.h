@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#ifdef PROF_SUPPORT
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "core/periodic.h"
+
+/* Fixed slots, the ones of the mainloop and timer functions follow in
+   the order meta.c calls them. */
+#define PROF_ISR_PERIODIC       0
+#define PROF_ISR_CLOCK          1
+#define PROF_ISR_ECMD_USART     2
+#define PROF_DYNAMIC_TIMERS     3
+#define PROF_FIRST              4
+
+/* Times are in periodic timer counts, see prof_counts2us. */
+struct prof_entry_t
+{
+  uint32_t count;
+  uint32_t total;
+  uint32_t max;
+};
+
+/* Generated by meta_magic*.m4. */
+extern struct prof_entry_t prof_entries[];
+extern PGM_P const prof_names[] PROGMEM;
+extern const uint8_t prof_generated;
+extern const uint8_t prof_timer_base;   /* scheduler only */
+
+void prof_clear(void);
+
+/* Account the time since START to SLOT. */
+void prof_account(uint8_t slot, periodic_timestamp_t * start);
+
+/* Copy SLOT to ENTRY and its name (in program space) to NAME, returns 0
+   if there is no such slot. */
+uint8_t prof_get(uint8_t slot, struct prof_entry_t *entry, PGM_P * name);
+
+uint32_t prof_counts2us(uint32_t counts);
+
+#define PROF_CALL(slot, call)                   \
+  do {                                          \
+    periodic_timestamp_t _prof_start;           \
+    periodic_milliticks(&_prof_start);          \
+    call;                                       \
+    prof_account(slot, &_prof_start);           \
+  } while (0)
+
+#define PROF_ISR_BEGIN()                        \
+  periodic_timestamp_t _prof_isr_start;         \
+  periodic_milliticks(&_prof_isr_start)
+#define PROF_ISR_END(slot) prof_account(slot, &_prof_isr_start)
+
+#else /* PROF_SUPPORT */
+
+#define PROF_CALL(slot, call) do { call; } while (0)
+#define PROF_ISR_BEGIN()
+#define PROF_ISR_END(slot)
+
+#endif /* PROF_SUPPORT */
+
+#endif /* PROF_H */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "prof.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* The name and the counters of a slot go into separate lines, so that
+   even the largest counters fit the ecmd output buffer. */
+typedef struct
+{
+  uint8_t magic;
+  uint8_t slot;
+  uint8_t counters;
+} prof_list_state_t;
+
+int16_t
+parse_cmd_prof(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  prof_list_state_t *state = (prof_list_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->slot = 0;
+    state->counters = 0;
+  }
+
+  struct prof_entry_t e;
+  PGM_P name;
+  if (!prof_get(state->slot, &e, &name))
+    return ECMD_FINAL_OK;
+
+  if (!state->counters)
+  {
+    state->counters = 1;
+    int16_t n = snprintf_P(output, len, PSTR("%S"), name);
+    return ECMD_AGAIN(n < len ? n : len - 1);
+  }
+
+  state->slot++;
+  state->counters = 0;
+  return ECMD_AGAIN(snprintf_P(output, len, PSTR("  %lu %lu %lu"), e.count,
+                               prof_counts2us(e.total),
+                               prof_counts2us(e.max)));
+}
+
+int16_t
+parse_cmd_prof_clear(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  prof_clear();
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block(Miscellaneous)
+  ecmd_feature(prof_clear, "prof clear",, Reset the profiling counters.)
+  ecmd_feature(prof, "prof",, List calls, total and maximum time in us of the mainloop and timer functions and ISRs.)
+*/
@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include "scheduler.h"
+#include "core/prof.h"
 
 #include <avr/pgmspace.h>
 
@@ -62,7 +63,7 @@ scheduler_dispatch_timer(void)
       scheduler_static_timers_control[i].state &= (uint8_t)~TIMER_RUNNABLE;
       scheduler_static_timers_control[i].state |= TIMER_RUNNING;
 
-      (*timer_func)();
+      PROF_CALL(prof_timer_base + i, (*timer_func)());
 
       // reset delay
       scheduler_static_timers_control[i].delay =
@@ -85,7 +86,7 @@ scheduler_dispatch_timer(void)
       scheduler_dynamic_timers[i].state &= (uint8_t)~TIMER_RUNNABLE;
       scheduler_dynamic_timers[i].state |= TIMER_RUNNING;
 
-      (*scheduler_dynamic_timers[i].timer)();
+      PROF_CALL(PROF_DYNAMIC_TIMERS, (*scheduler_dynamic_timers[i].timer)());
 
       if ((scheduler_dynamic_timers[i].state & TIMER_ONESHOT) == TIMER_ONESHOT)
       {
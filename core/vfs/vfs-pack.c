@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+typedef uint32_t vfs_size_t;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>             // PATH_MAX
+
+#include "vfs_inline.h"
+
+#define MAX_IMAGE_SIZE 262144
+#define MAX_FILES 256
+
+struct file
+{
+  struct vfs_inline_entry_t entry;
+  uint8_t *data;
+  int data_len;
+};
+
+static struct file files[MAX_FILES];
+
+static void
+usage(int exitval)
+{
+  fprintf(exitval ? stderr : stdout,
+          "Usage: vfs-pack IMAGE BLOCKSZ FILE...\n"
+          "Append a packed image of all FILEs to ethersex IMAGE.\n"
+          "FILE.gz is taken instead of FILE if it exists.\n\n");
+  exit(exitval);
+}
+
+static uint8_t
+crc_update(uint8_t crc, uint8_t data)
+{
+  uint8_t i;
+  for (i = 0; i < 8; i++)
+  {
+    if ((crc ^ data) & 1)
+      crc = (crc >> 1) ^ 0x8c;
+    else
+      crc = crc >> 1;
+
+    data = data >> 1;
+  }
+
+  return crc;
+}
+
+static uint8_t
+crc_calc(uint8_t * data, int len)
+{
+  uint8_t crc = 0;
+  int i;
+
+  for (i = 0; i < len; i++)
+    crc = crc_update(crc, data[i]);
+
+  return crc;
+}
+
+static int
+read_file(const char *fn, uint8_t * buf)
+{
+  FILE *f = fopen(fn, "rb");
+  if (f == NULL)
+    return -1;
+
+  int len = fread(buf, 1, MAX_IMAGE_SIZE, f);
+  fclose(f);
+  return len;
+}
+
+/* Greedy LZSS, see vfs_inline.h for the format. */
+static int
+lz_compress(const uint8_t * in, int len, uint8_t * out)
+{
+  int pos = 0, o = 0, flag_pos = 0, bit = 8;
+
+  while (pos < len)
+  {
+    if (bit == 8)
+    {
+      flag_pos = o++;
+      out[flag_pos] = 0;
+      bit = 0;
+    }
+
+    int best_len = 0, best_dist = 0;
+    int max = len - pos;
+    if (max > VFS_INLINE_LZ_MAX_MATCH)
+      max = VFS_INLINE_LZ_MAX_MATCH;
+
+    for (int dist = 1; dist <= VFS_INLINE_LZ_WINDOW && dist <= pos; dist++)
+    {
+      int l = 0;
+      while (l < max && in[pos - dist + l] == in[pos + l])
+        l++;
+      if (l > best_len)
+      {
+        best_len = l;
+        best_dist = dist;
+      }
+    }
+
+    if (best_len >= VFS_INLINE_LZ_MIN_MATCH)
+    {
+      out[o++] = best_dist - 1;
+      out[o++] = best_len - VFS_INLINE_LZ_MIN_MATCH;
+      pos += best_len;
+    }
+    else
+    {
+      out[flag_pos] |= 1 << bit;
+      out[o++] = in[pos++];
+    }
+    bit++;
+  }
+
+  return o;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+  const struct file *fa = a, *fb = b;
+  if (fa->entry.hash != fb->entry.hash)
+    return fa->entry.hash < fb->entry.hash ? -1 : 1;
+  return strncmp(fa->entry.fn, fb->entry.fn, VFS_INLINE_FNLEN);
+}
+
+int
+main(int argc, char **argv)
+{
+  static uint8_t buf_image[MAX_IMAGE_SIZE], buf_file[MAX_IMAGE_SIZE];
+  static uint8_t buf_lz[MAX_IMAGE_SIZE * 9 / 8 + 1];
+  int image_len, pagesz, count = argc - 3;
+  int sizes[3] = { 0, 0, 0 };
+
+  if (argc == 2 && strcmp(argv[1], "--help") == 0)
+    usage(0);
+  if (argc < 3)
+    usage(1);
+  if (count > MAX_FILES)
+  {
+    fprintf(stderr, "vfs-pack: Too many files.\n");
+    return 1;
+  }
+
+  pagesz = atoi(argv[2]);
+  if (pagesz == 0 || pagesz % 2 || pagesz < 64 || pagesz > 256)
+  {
+    fprintf(stderr, "vfs-pack: Invalid page size: %d.\n", pagesz);
+    return 1;
+  }
+
+  if ((image_len = read_file(argv[1], buf_image)) < 0)
+  {
+    fprintf(stderr, "vfs-pack: Unable to read %s.\n", argv[1]);
+    return 1;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    struct file *f = &files[i];
+    char filename_gz[PATH_MAX], *name = argv[i + 3], *ptr;
+    int len, gz_len;
+
+    if ((len = read_file(name, buf_file)) < 0)
+    {
+      fprintf(stderr, "vfs-pack: Unable to read %s.\n", name);
+      return 1;
+    }
+    if (len > UINT16_MAX)
+    {
+      fprintf(stderr, "vfs-pack: %s is too large.\n", name);
+      return 1;
+    }
+
+    while ((ptr = strchr(name, '/')))
+      name = ptr + 1;
+    if (strlen(name) > VFS_INLINE_FNLEN)
+    {
+      fprintf(stderr, "vfs-pack: Filename %s is too long.\n", name);
+      return 1;
+    }
+    strncpy(f->entry.fn, name, VFS_INLINE_FNLEN);
+    f->entry.hash = vfs_inline_hash(f->entry.fn);
+
+    /* Take the smallest of stored, LZ and (if do-embed made one) gzip. */
+    f->entry.flags = VFS_INLINE_STORED;
+    f->entry.len = len;
+    f->data_len = len;
+    f->data = malloc(len + 1);
+    memcpy(f->data, buf_file, len);
+
+    int lz_len = lz_compress(buf_file, len, buf_lz);
+    if (lz_len < f->data_len)
+    {
+      f->entry.flags = VFS_INLINE_LZ;
+      f->data_len = lz_len;
+      memcpy(f->data, buf_lz, lz_len);
+    }
+
+    snprintf(filename_gz, sizeof(filename_gz), "%s.gz", argv[i + 3]);
+    if ((gz_len = read_file(filename_gz, buf_file)) >= 0
+        && gz_len < f->data_len)
+    {
+      f->entry.flags = VFS_INLINE_GZIP;
+      f->entry.len = gz_len;
+      f->data_len = gz_len;
+      memcpy(f->data, buf_file, gz_len);
+    }
+
+    sizes[f->entry.flags]++;
+    fprintf(stderr, "vfs-pack: %-6s %5d -> %5d (%s)\n", f->entry.fn, len,
+            f->data_len, f->entry.flags == VFS_INLINE_LZ ? "lz" :
+            f->entry.flags == VFS_INLINE_GZIP ? "gzip" : "stored");
+  }
+
+  qsort(files, count, sizeof(struct file), compare_entries);
+  for (int i = 1; i < count; i++)
+    if (compare_entries(&files[i - 1], &files[i]) == 0)
+    {
+      fprintf(stderr, "vfs-pack: Duplicate file %.6s.\n", files[i].entry.fn);
+      return 1;
+    }
+
+  fwrite(buf_image, 1, image_len, stdout);
+  while (image_len % pagesz)
+  {
+    putchar(0xFF);
+    image_len++;
+  }
+
+  uint32_t offset = 1 + sizeof(struct vfs_inline_image_t)
+    + count * sizeof(struct vfs_inline_entry_t);
+  for (int i = 0; i < count; i++)
+  {
+    files[i].entry.offset = offset;
+    offset += files[i].data_len;
+  }
+
+  /* the crc covers the count and the index */
+  struct vfs_inline_image_t image = {.count = count };
+  image.crc = crc_calc((uint8_t *) & image, sizeof(image) - 1);
+  for (int i = 0; i < count; i++)
+    for (unsigned j = 0; j < sizeof(struct vfs_inline_entry_t); j++)
+      image.crc = crc_update(image.crc, ((uint8_t *) & files[i].entry)[j]);
+
+  putchar(VFS_INLINE_PACKED_MAGIC);
+  fwrite(&image, sizeof(image), 1, stdout);
+  for (int i = 0; i < count; i++)
+    fwrite(&files[i].entry, sizeof(struct vfs_inline_entry_t), 1, stdout);
+  for (int i = 0; i < count; i++)
+    fwrite(files[i].data, 1, files[i].data_len, stdout);
+
+  fprintf(stderr, "vfs-pack: %d files (%d stored, %d lz, %d gzip), "
+          "%u bytes\n", count, sizes[VFS_INLINE_STORED],
+          sizes[VFS_INLINE_LZ], sizes[VFS_INLINE_GZIP], offset);
+
+  return 0;
+}
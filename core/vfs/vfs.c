@@ -21,11 +21,16 @@
  */
 
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "core/debug.h"
 #include "core/vfs/vfs.h"
+#include "core/vfs/vfs_cache.h"
 #ifndef VFS_TEENSY
 
 const struct vfs_func_t vfs_funcs[] PROGMEM = {
+#ifdef VFS_SRAM_SUPPORT
+  VFS_SRAM_FUNCS,
+#endif
 #ifdef VFS_EEPROM_SUPPORT
   VFS_EEPROM_FUNCS,
 #endif
@@ -50,6 +55,9 @@ const struct vfs_func_t vfs_funcs[] PROGMEM = {
 #ifdef VFS_DC3840_SUPPORT
   VFS_DC3840_FUNCS,
 #endif
+#ifdef CAPTURE_SUPPORT
+  VFS_CAPTURE_FUNCS,
+#endif
 #ifdef VFS_HOST_SUPPORT
   VFS_HOST_FUNCS,
 #endif
@@ -68,6 +76,11 @@ vfs_open(const char *filename)
       fh = funcs.open(filename);
   }
 
+#ifdef VFS_CACHE_SUPPORT
+  if (fh)
+    vfs_cache_attach(fh, 0);
+#endif
+
   return fh;
 }
 
@@ -81,8 +94,20 @@ vfs_create(const char *name)
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     if (funcs.create)
       fh = funcs.create(name);
+#ifdef VFS_SRAM_SUPPORT
+    /* Names below "ram/" belong to the RAM disk even if it can't create
+       them (directory full, name too long, out of memory). */
+    if (i == VFS_SRAM
+        && strncmp(name, VFS_SRAM_PREFIX, strlen(VFS_SRAM_PREFIX)) == 0)
+      break;
+#endif
   }
 
+#ifdef VFS_CACHE_SUPPORT
+  if (fh)
+    vfs_cache_attach(fh, 1);
+#endif
+
   return fh;
 }
 
@@ -94,6 +119,17 @@ vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t * handle,
   struct vfs_func_t funcs;
   memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
 
+#ifdef VFS_CACHE_SUPPORT
+  if (vfs_cached(handle))
+  {
+    if (flag == 0)
+      return vfs_cache_read(handle, buf, length);
+    if (flag == 1)
+      return vfs_cache_write(handle, buf, length);
+    vfs_cache_sync_file(handle);
+  }
+#endif
+
   if (flag == 0 && funcs.read)
     return funcs.read(handle, buf, length);
 
@@ -114,6 +150,26 @@ vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t * handle,
   struct vfs_func_t funcs;
   memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
 
+#ifdef VFS_CACHE_SUPPORT
+  if (vfs_cached(handle))
+  {
+    if (flag == 0)
+      return vfs_cache_fseek(handle, length, whence);
+
+    vfs_cache_sync_file(handle);
+    if (flag == 1 && funcs.truncate)
+    {
+      vfs_size_t pos = handle->cache_pos;
+      vfs_cache_invalidate(handle);
+      uint8_t ret = funcs.truncate(handle, length);
+      /* Truncating may release the storage the file id refers to. */
+      vfs_cache_attach(handle, 1);
+      handle->cache_pos = pos < length ? pos : length;
+      return ret;
+    }
+  }
+#endif
+
   if (flag == 0 && funcs.fseek)
     /* handle, offset, whence */
     return funcs.fseek(handle, length, whence);
@@ -131,6 +187,13 @@ uint8_t
 vfs_unlink(const char *name)
 {
   uint8_t retval = 1;
+
+#ifdef VFS_CACHE_SUPPORT
+  /* The file id is unknown here, drop all cached blocks. */
+  vfs_sync();
+  vfs_cache_invalidate(NULL);
+#endif
+
   for (uint8_t i = 0; retval != 0 && i < VFS_LAST; i++)
   {
     struct vfs_func_t funcs;
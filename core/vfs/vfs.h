@@ -28,6 +28,9 @@
 
 enum vfs_type_t
 {
+#ifdef VFS_SRAM_SUPPORT
+  VFS_SRAM,			/* first, claims the "ram/" prefix */
+#endif
 #ifdef VFS_EEPROM_SUPPORT
   VFS_EEPROM,
 #endif
@@ -52,6 +55,9 @@ enum vfs_type_t
 #ifdef VFS_DC3840_SUPPORT
   VFS_DC3840,
 #endif
+#ifdef CAPTURE_SUPPORT
+  VFS_CAPTURE,
+#endif
 #ifdef VFS_HOST_SUPPORT
   VFS_HOST,
 #endif
@@ -80,6 +86,8 @@ typedef uint32_t vfs_size_t;
 #include "hardware/i2c/master/vfs_eeprom_raw.h"
 #include "hardware/camera/vfs_dc3840.h"
 #include "core/host/vfs.h"
+#include "hardware/serial_ram/23k256/vfs_sram.h"
+#include "protocols/uip/vfs_capture.h"
 
 struct vfs_file_handle_t
 {
@@ -87,6 +95,13 @@ struct vfs_file_handle_t
    * file handle. */
   uint8_t fh_type;
 
+#ifdef VFS_CACHE_SUPPORT
+  /* File id used by the block cache (0: not cached) and the position
+   * of the handle, the backend position is only valid on cache misses. */
+  uint32_t cache_id;
+  vfs_size_t cache_pos;
+#endif
+
   union
   {
     vfs_file_handle_eeprom_t ee;
@@ -96,6 +111,8 @@ struct vfs_file_handle_t
     vfs_file_handle_inline_t il;
     vfs_file_handle_dc3840_t dc3840;
     vfs_file_handle_host_t host;
+    vfs_file_handle_sram_t sram;
+    vfs_file_handle_capture_t capture;
   } u;
 };
 
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Block cache between vfs.c and the backends.
+ *
+ * Files are cut into blocks of CONF_VFS_CACHE_BLOCK_SIZE bytes, a block is
+ * identified by the backend type, a per-backend file id and its number.
+ * Blocks are replaced least recently used first.  A cached handle keeps its
+ * own position, the backend position is only set right before the backend
+ * is accessed.  Dirty blocks always belong to an open handle, they are
+ * written back on eviction, fseek, size, truncate, close and vfs_sync(). */
+
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "config.h"
+#include "core/debug.h"
+#include "core/vfs/vfs.h"
+#include "core/vfs/vfs_cache.h"
+
+#ifdef VFS_SD_SUPPORT
+#include "hardware/storage/sd_reader/fat.h"
+#endif
+#ifdef VFS_HOST_SUPPORT
+#include <sys/stat.h>
+#endif
+
+#define BS CONF_VFS_CACHE_BLOCK_SIZE
+
+#define VFS_CACHE_VALID  0x01
+#define VFS_CACHE_DIRTY  0x02
+
+struct vfs_cache_block_t
+{
+  uint8_t flags;
+  uint8_t type;
+  uint32_t id;
+  vfs_size_t block;
+  uint16_t len;                 /* valid bytes in data */
+  uint16_t dirty_lo;            /* dirty range [lo, hi) */
+  uint16_t dirty_hi;
+  uint16_t stamp;
+  struct vfs_file_handle_t *owner;
+  uint8_t data[BS];
+};
+
+static struct vfs_cache_block_t vfs_cache[CONF_VFS_CACHE_BLOCKS];
+static uint16_t vfs_cache_clock;
+/* Set when a write back moved the backend position. */
+static uint8_t vfs_cache_moved;
+
+struct vfs_cache_stats_t vfs_cache_stats;
+
+
+static void
+vfs_cache_funcs(uint8_t type, struct vfs_func_t *funcs)
+{
+  memcpy_P(funcs, &vfs_funcs[type], sizeof(struct vfs_func_t));
+}
+
+/* Return a file id that stays the same for as long as the file exists,
+ * or 0 if the file can't be cached. */
+static uint32_t
+vfs_cache_file_id(struct vfs_file_handle_t *fh)
+{
+  switch (fh->fh_type)
+  {
+#ifdef VFS_EEPROM_SUPPORT
+    case VFS_EEPROM:
+      return fh->u.ee.file_page;
+#endif
+#ifdef VFS_DF_SUPPORT
+    case VFS_DF:
+      return (uint32_t) fh->u.df.inode + 1;
+#endif
+#ifdef VFS_SD_SUPPORT
+    case VFS_SD:
+      /* Empty files have no cluster yet. */
+      return fh->u.sd->dir_entry.cluster;
+#endif
+#ifdef VFS_HOST_SUPPORT
+    case VFS_HOST:
+    {
+      struct stat st;
+      if (fstat(fh->u.host.fd, &st) != 0)
+        return 0;
+      return (uint32_t) st.st_ino;
+    }
+#endif
+    default:
+      /* Inline files are read from program memory anyway, raw and
+       * camera handles are no files. */
+      return 0;
+  }
+}
+
+static uint8_t
+vfs_cache_is_file(struct vfs_cache_block_t *b, struct vfs_file_handle_t *fh)
+{
+  return (b->flags & VFS_CACHE_VALID) && b->type == fh->fh_type
+    && b->id == fh->cache_id;
+}
+
+static struct vfs_cache_block_t *
+vfs_cache_lookup(struct vfs_file_handle_t *fh, vfs_size_t block)
+{
+  for (uint8_t i = 0; i < CONF_VFS_CACHE_BLOCKS; i++)
+    if (vfs_cache_is_file(&vfs_cache[i], fh) && vfs_cache[i].block == block)
+      return &vfs_cache[i];
+
+  return NULL;
+}
+
+static void
+vfs_cache_touch(struct vfs_cache_block_t *b)
+{
+  b->stamp = ++vfs_cache_clock;
+}
+
+static uint8_t
+vfs_cache_flush_block(struct vfs_cache_block_t *b)
+{
+  if (!(b->flags & VFS_CACHE_DIRTY))
+    return 0;
+
+  struct vfs_func_t funcs;
+  vfs_cache_funcs(b->type, &funcs);
+  b->flags &= ~VFS_CACHE_DIRTY;
+  vfs_cache_moved = 1;
+
+  uint16_t n = b->dirty_hi - b->dirty_lo;
+  if (funcs.fseek(b->owner, b->block * BS + b->dirty_lo, SEEK_SET) != 0
+      || funcs.write(b->owner, b->data + b->dirty_lo, n) != n)
+  {
+    debug_printf("vfs_cache: write back of block %lu failed\n",
+                 (unsigned long) b->block);
+    b->flags = 0;
+    return 1;
+  }
+
+  vfs_cache_stats.writeback++;
+  return 0;
+}
+
+/* Pick the least recently used block, but never KEEP. */
+static struct vfs_cache_block_t *
+vfs_cache_victim(struct vfs_cache_block_t *keep)
+{
+  struct vfs_cache_block_t *victim = NULL;
+
+  for (uint8_t i = 0; i < CONF_VFS_CACHE_BLOCKS; i++)
+  {
+    struct vfs_cache_block_t *b = &vfs_cache[i];
+    if (b == keep)
+      continue;
+    if (!(b->flags & VFS_CACHE_VALID))
+      return b;
+    if (victim == NULL
+        || (int16_t) (b->stamp - victim->stamp) < 0)
+      victim = b;
+  }
+
+  /* Dirty blocks of a file have to reach the backend in ascending
+   * order, a hole at the end of the file can't be written. */
+  if (victim->flags & VFS_CACHE_DIRTY)
+    vfs_cache_sync_file(victim->owner);
+
+  victim->flags = 0;
+  return victim;
+}
+
+/* Read block number BLOCK of FH into B, the backend position is left
+ * at the start of the following block. */
+static void
+vfs_cache_fill(struct vfs_file_handle_t *fh, struct vfs_cache_block_t *b,
+               vfs_size_t block, uint8_t seek)
+{
+  struct vfs_func_t funcs;
+  vfs_cache_funcs(fh->fh_type, &funcs);
+
+  b->flags = VFS_CACHE_VALID;
+  b->type = fh->fh_type;
+  b->id = fh->cache_id;
+  b->block = block;
+  b->len = 0;
+  vfs_cache_touch(b);
+
+  /* Seeking fails beyond the end of file, that's an empty block. */
+  if (seek && funcs.fseek(fh, block * BS, SEEK_SET) != 0)
+    return;
+
+  vfs_size_t len = funcs.read(fh, b->data, BS);
+  if (len <= BS)
+    b->len = len;
+}
+
+/* Return block BLOCK of FH, reading it from the backend unless FILL is
+ * zero (the caller overwrites all of it). */
+static struct vfs_cache_block_t *
+vfs_cache_get(struct vfs_file_handle_t *fh, vfs_size_t block, uint8_t fill)
+{
+  struct vfs_cache_block_t *b = vfs_cache_lookup(fh, block);
+  if (b)
+  {
+    vfs_cache_stats.hits++;
+    vfs_cache_touch(b);
+    return b;
+  }
+
+  vfs_cache_stats.misses++;
+
+  /* Evicting may flush blocks of this very file, look for the
+   * predecessor before that. */
+  uint8_t sequential = block == 0 || vfs_cache_lookup(fh, block - 1);
+
+  b = vfs_cache_victim(NULL);
+  if (!fill)
+  {
+    b->flags = VFS_CACHE_VALID;
+    b->type = fh->fh_type;
+    b->id = fh->cache_id;
+    b->block = block;
+    b->len = 0;
+    vfs_cache_touch(b);
+    return b;
+  }
+
+  vfs_cache_fill(fh, b, block, 1);
+
+#ifdef VFS_CACHE_READAHEAD_SUPPORT
+  /* Sequential access, fetch the next block while the backend is
+   * positioned there anyway. */
+  if (CONF_VFS_CACHE_BLOCKS > 1 && sequential && b->len == BS
+      && vfs_cache_lookup(fh, block + 1) == NULL)
+  {
+    vfs_cache_moved = 0;
+    struct vfs_cache_block_t *next = vfs_cache_victim(b);
+    vfs_cache_fill(fh, next, block + 1, vfs_cache_moved);
+    /* Keep the block that was asked for the most recent one. */
+    vfs_cache_touch(b);
+    vfs_cache_stats.readahead++;
+  }
+#else
+  (void) sequential;
+#endif
+
+  return b;
+}
+
+
+void
+vfs_cache_attach(struct vfs_file_handle_t *fh, uint8_t created)
+{
+  struct vfs_func_t funcs;
+  vfs_cache_funcs(fh->fh_type, &funcs);
+
+  fh->cache_pos = 0;
+  fh->cache_id = 0;
+  if (!funcs.read || !funcs.fseek || !funcs.size)
+    return;
+
+  fh->cache_id = vfs_cache_file_id(fh);
+
+  /* A created file may reuse the id of a removed one. */
+  if (created && fh->cache_id)
+    vfs_cache_invalidate(fh);
+}
+
+vfs_size_t
+vfs_cache_read(struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  vfs_size_t done = 0;
+
+  while (done < length)
+  {
+    uint16_t off = fh->cache_pos % BS;
+    struct vfs_cache_block_t *b = vfs_cache_get(fh, fh->cache_pos / BS, 1);
+    if (off >= b->len)
+      break;                    /* End of file. */
+
+    uint16_t n = b->len - off;
+    if (n > length - done)
+      n = length - done;
+
+    memcpy((uint8_t *) buf + done, b->data + off, n);
+    done += n;
+    fh->cache_pos += n;
+
+    if (b->len < BS)
+      break;
+  }
+
+  return done;
+}
+
+vfs_size_t
+vfs_cache_write(struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  struct vfs_func_t funcs;
+  vfs_cache_funcs(fh->fh_type, &funcs);
+  if (!funcs.write)
+    return 0;
+
+#ifdef VFS_CACHE_WRITEBACK_SUPPORT
+  vfs_size_t done = 0;
+
+  while (done < length)
+  {
+    uint16_t off = fh->cache_pos % BS;
+    uint16_t n = BS - off;
+    if (n > length - done)
+      n = length - done;
+
+    struct vfs_cache_block_t *b =
+      vfs_cache_get(fh, fh->cache_pos / BS, n != BS);
+    if (off > b->len)
+      break;                    /* Would leave a hole. */
+
+    memcpy(b->data + off, (uint8_t *) buf + done, n);
+    if (off + n > b->len)
+      b->len = off + n;
+
+    if (b->flags & VFS_CACHE_DIRTY)
+    {
+      if (off < b->dirty_lo)
+        b->dirty_lo = off;
+      if (off + n > b->dirty_hi)
+        b->dirty_hi = off + n;
+    }
+    else
+    {
+      b->flags |= VFS_CACHE_DIRTY;
+      b->dirty_lo = off;
+      b->dirty_hi = off + n;
+    }
+    b->owner = fh;
+
+    done += n;
+    fh->cache_pos += n;
+  }
+
+  return done;
+#else
+  /* Write through, cached blocks of the file get stale. */
+  vfs_cache_invalidate(fh);
+  if (funcs.fseek(fh, fh->cache_pos, SEEK_SET) != 0)
+    return 0;
+
+  vfs_size_t done = funcs.write(fh, buf, length);
+  fh->cache_pos += done;
+  return done;
+#endif
+}
+
+uint8_t
+vfs_cache_fseek(struct vfs_file_handle_t *fh, vfs_size_t offset,
+                uint8_t whence)
+{
+  struct vfs_func_t funcs;
+  vfs_cache_funcs(fh->fh_type, &funcs);
+
+  vfs_size_t pos;
+  switch (whence)
+  {
+    case SEEK_SET:
+      pos = offset;
+      break;
+
+    case SEEK_CUR:
+      pos = fh->cache_pos + offset;
+      break;
+
+    case SEEK_END:
+      vfs_cache_sync_file(fh);
+      pos = funcs.size(fh) + offset;
+      break;
+
+    default:
+      return -1;
+  }
+
+  /* Positions within cached data need no backend access. */
+  struct vfs_cache_block_t *b = vfs_cache_lookup(fh, pos / BS);
+  if (b && pos % BS <= b->len)
+  {
+    fh->cache_pos = pos;
+    return 0;
+  }
+
+  /* Let the backend check the position. */
+  vfs_cache_sync_file(fh);
+  uint8_t ret = funcs.fseek(fh, pos, SEEK_SET);
+  if (ret == 0)
+    fh->cache_pos = pos;
+
+  return ret;
+}
+
+void
+vfs_cache_sync_file(struct vfs_file_handle_t *fh)
+{
+  for (;;)
+  {
+    struct vfs_cache_block_t *first = NULL;
+
+    for (uint8_t i = 0; i < CONF_VFS_CACHE_BLOCKS; i++)
+    {
+      struct vfs_cache_block_t *b = &vfs_cache[i];
+      if ((b->flags & VFS_CACHE_DIRTY) && vfs_cache_is_file(b, fh)
+          && (first == NULL || b->block < first->block))
+        first = b;
+    }
+
+    if (first == NULL)
+      return;
+
+    vfs_cache_flush_block(first);
+  }
+}
+
+void
+vfs_sync(void)
+{
+  for (uint8_t i = 0; i < CONF_VFS_CACHE_BLOCKS; i++)
+    if (vfs_cache[i].flags & VFS_CACHE_DIRTY)
+      vfs_cache_sync_file(vfs_cache[i].owner);
+}
+
+void
+vfs_cache_invalidate(struct vfs_file_handle_t *fh)
+{
+  for (uint8_t i = 0; i < CONF_VFS_CACHE_BLOCKS; i++)
+  {
+    struct vfs_cache_block_t *b = &vfs_cache[i];
+    if (fh ? vfs_cache_is_file(b, fh) : !(b->flags & VFS_CACHE_DIRTY))
+      b->flags = 0;
+  }
+}
+
+/*
+  -- Ethersex META --
+  header(core/vfs/vfs_cache.h)
+*/
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef VFS_CACHE_H
+#define VFS_CACHE_H
+
+#include "core/vfs/vfs.h"
+
+#ifdef VFS_CACHE_SUPPORT
+
+#ifdef VFS_TEENSY
+#error "The VFS block cache needs a backend besides VFS inlining"
+#endif
+
+#ifndef CONF_VFS_CACHE_BLOCKS
+#define CONF_VFS_CACHE_BLOCKS 4
+#endif
+#ifndef CONF_VFS_CACHE_BLOCK_SIZE
+#define CONF_VFS_CACHE_BLOCK_SIZE 64
+#endif
+
+struct vfs_cache_stats_t
+{
+  uint16_t hits;
+  uint16_t misses;
+  uint16_t readahead;
+  uint16_t writeback;
+};
+
+extern struct vfs_cache_stats_t vfs_cache_stats;
+
+/* Attach a freshly opened (CREATED != 0: created) handle to the cache.
+ * Handles of backends without a stable file id stay uncached. */
+void vfs_cache_attach(struct vfs_file_handle_t *fh, uint8_t created);
+
+vfs_size_t vfs_cache_read(struct vfs_file_handle_t *fh, void *buf,
+                          vfs_size_t length);
+vfs_size_t vfs_cache_write(struct vfs_file_handle_t *fh, void *buf,
+                           vfs_size_t length);
+uint8_t vfs_cache_fseek(struct vfs_file_handle_t *fh, vfs_size_t offset,
+                        uint8_t whence);
+
+/* Write back the dirty blocks of FH, in ascending file order. */
+void vfs_cache_sync_file(struct vfs_file_handle_t *fh);
+
+/* Write back all dirty blocks. */
+void vfs_sync(void);
+
+/* Forget cached blocks of FH, or all clean blocks if FH is NULL. */
+void vfs_cache_invalidate(struct vfs_file_handle_t *fh);
+
+#define vfs_cached(fh)  ((fh)->cache_id != 0)
+
+#else
+
+#define vfs_sync()  do { } while (0)
+
+#endif /* VFS_CACHE_SUPPORT */
+
+#endif /* VFS_CACHE_H */
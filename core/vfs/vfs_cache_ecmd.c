@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "core/vfs/vfs.h"
+#include "core/vfs/vfs_cache.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+#ifdef VFS_HOST_SUPPORT
+#include <sys/time.h>
+#endif
+
+
+int16_t
+parse_cmd_vfs_cache(char *cmd, char *output, uint16_t len)
+{
+  while (*cmd == ' ')
+    cmd++;
+
+  if (strcmp_P(cmd, PSTR("reset")) == 0)
+  {
+    memset(&vfs_cache_stats, 0, sizeof(vfs_cache_stats));
+    return ECMD_FINAL_OK;
+  }
+
+  return ECMD_FINAL(snprintf_P(output, len,
+                               PSTR("hit %u miss %u ahead %u wb %u"),
+                               vfs_cache_stats.hits,
+                               vfs_cache_stats.misses,
+                               vfs_cache_stats.readahead,
+                               vfs_cache_stats.writeback));
+}
+
+
+int16_t
+parse_cmd_vfs_sync(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  vfs_sync();
+  return ECMD_FINAL_OK;
+}
+
+
+#ifdef VFS_HOST_SUPPORT
+/* Read FILE three times in small chunks, like httpd does. */
+int16_t
+parse_cmd_vfs_bench(char *cmd, char *output, uint16_t len)
+{
+  while (*cmd == ' ')
+    cmd++;
+
+  struct vfs_file_handle_t *fh = vfs_open(cmd);
+  if (fh == NULL)
+    return ECMD_ERR_PARSE_ERROR;
+
+  struct vfs_cache_stats_t before = vfs_cache_stats;
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  uint32_t total = 0;
+  uint8_t buf[16];
+  for (uint8_t pass = 0; pass < 3; pass++)
+  {
+    vfs_size_t n;
+    vfs_rewind(fh);
+    while ((n = vfs_read(fh, buf, sizeof(buf))) > 0)
+      total += n;
+  }
+
+  gettimeofday(&end, NULL);
+  vfs_close(fh);
+
+  uint32_t us = (end.tv_sec - start.tv_sec) * 1000000UL
+    + end.tv_usec - start.tv_usec;
+  return ECMD_FINAL(snprintf_P(output, len,
+                               PSTR("%lu B %lu us hit %u miss %u"),
+                               (unsigned long) total, (unsigned long) us,
+                               (uint16_t) (vfs_cache_stats.hits - before.hits),
+                               (uint16_t) (vfs_cache_stats.misses -
+                                           before.misses)));
+}
+#endif
+
+/*
+  -- Ethersex META --
+  block([[VFS]])
+  ecmd_feature(vfs_cache, "vfs cache",[reset], Show (or reset) the block cache statistics.)
+  ecmd_feature(vfs_sync, "vfs sync",, Write dirty cache blocks back.)
+  ecmd_ifdef(VFS_HOST_SUPPORT)
+    ecmd_feature(vfs_bench, "vfs bench ", FILE, Read FILE three times in 16 byte chunks and show the time taken.)
+  ecmd_endif()
+*/
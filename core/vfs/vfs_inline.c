@@ -20,8 +20,10 @@
  */
 
 #include <avr/pgmspace.h>
+#include <util/crc16.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "core/eeprom.h"
 #include "core/vfs/vfs.h"
@@ -33,6 +35,202 @@
 #endif
 
 
+#ifdef VFS_INLINE_PACKED_SUPPORT
+static void
+vfs_inline_read_P (void *dst, vfs_size_t offset, uint8_t len)
+{
+  for (uint8_t i = 0; i < len; i ++)
+    ((uint8_t *) dst)[i] = __pgm_read_byte (offset + i);
+}
+
+/* Whether the header of the image at OFFSET is valid.  The crc covers the
+ * entry count and the whole index, so a stray magic byte in the firmware
+ * isn't taken for an image that easily. */
+static uint8_t
+vfs_inline_image_valid (vfs_size_t offset, struct vfs_inline_image_t *image)
+{
+  uint32_t index = (uint32_t) offset + 1 + sizeof (*image);
+  uint32_t end = index
+    + (uint32_t) image->count * sizeof (struct vfs_inline_entry_t);
+  if (end > (uint32_t) FLASHEND + 1)
+    return 0;
+
+  uint8_t crc = crc_checksum (image, sizeof (*image) - 1);
+  for (; index < end; index ++)
+    crc = _crc_ibutton_update (crc, __pgm_read_byte ((vfs_size_t) index));
+  return crc == image->crc;
+}
+
+/* Offset of the packed image, 0 if there is none.  The flash is only
+ * searched on the first call, 1 is never a page boundary. */
+static vfs_size_t
+vfs_inline_image (struct vfs_inline_image_t *image)
+{
+  static vfs_size_t image_offset = 1;
+
+  if (image_offset == 1)
+    {
+      image_offset = 0;
+      for (vfs_size_t offset = FLASHEND - SPM_PAGESIZE + 1; offset;
+	   offset -= SPM_PAGESIZE)
+	{
+	  if (__pgm_read_byte (offset) != VFS_INLINE_PACKED_MAGIC)
+	    continue;
+
+	  vfs_inline_read_P (image, offset + 1, sizeof (*image));
+	  if (vfs_inline_image_valid (offset, image))
+	    {
+	      image_offset = offset;
+	      break;
+	    }
+	}
+    }
+
+  if (image_offset)
+    vfs_inline_read_P (image, image_offset + 1, sizeof (*image));
+
+  return image_offset;
+}
+
+struct vfs_file_handle_t *
+vfs_inline_open (const char *filename)
+{
+  struct vfs_inline_image_t image;
+  vfs_size_t base = vfs_inline_image (&image);
+  if (base == 0)
+    return NULL;
+
+  vfs_size_t index = base + 1 + sizeof (image);
+  uint16_t hash = vfs_inline_hash (filename);
+  struct vfs_inline_entry_t entry;
+
+  /* Find the first entry with this hash, ... */
+  uint16_t lo = 0, hi = image.count;
+  while (lo < hi)
+    {
+      uint16_t mid = lo + (hi - lo) / 2;
+      vfs_inline_read_P (&entry, index + mid * sizeof (entry),
+			 sizeof (entry.hash));
+      if (entry.hash < hash)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  /* ... then compare names until the hash changes. */
+  for (; lo < image.count; lo ++)
+    {
+      vfs_inline_read_P (&entry, index + lo * sizeof (entry), sizeof (entry));
+      if (entry.hash != hash)
+	return NULL;
+      if (strncmp (entry.fn, filename, VFS_INLINE_FNLEN) == 0)
+	break;
+    }
+
+  if (lo == image.count)
+    return NULL;		/* File not found. */
+
+  struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
+  if (fh == NULL)
+    return NULL;
+
+  fh->fh_type = VFS_INLINE;
+  fh->u.il.offset = base + entry.offset;
+  fh->u.il.pos = 0;
+  fh->u.il.len = entry.len;
+  fh->u.il.lz = NULL;
+
+  if (entry.flags == VFS_INLINE_LZ)
+    {
+      fh->u.il.lz = malloc (sizeof (struct vfs_inline_lz_t));
+      if (fh->u.il.lz == NULL)
+	{
+	  free (fh);
+	  return NULL;
+	}
+      fh->u.il.lz->in = fh->u.il.offset;
+      fh->u.il.lz->bits = 0;
+      fh->u.il.lz->match_len = 0;
+      fh->u.il.lz->wpos = 0;
+    }
+
+  return fh;
+}
+
+void
+vfs_inline_close (struct vfs_file_handle_t *fh)
+{
+  free (fh->u.il.lz);
+  free (fh);
+}
+
+/* Decompress LENGTH bytes to BUF, or skip them if BUF is NULL. */
+static vfs_size_t
+vfs_inline_lz_read (struct vfs_file_handle_t *fh, uint8_t *buf,
+		    vfs_size_t length)
+{
+  struct vfs_inline_lz_t *lz = fh->u.il.lz;
+  vfs_size_t n = 0;
+
+  for (; n < length && fh->u.il.pos < fh->u.il.len; n ++)
+    {
+      uint8_t c;
+
+      if (lz->match_len == 0)
+	{
+	  if (lz->bits == 0)
+	    {
+	      lz->flags = __pgm_read_byte (lz->in ++);
+	      lz->bits = 8;
+	    }
+
+	  uint8_t literal = lz->flags & 1;
+	  lz->flags >>= 1;
+	  lz->bits --;
+
+	  if (literal)
+	    {
+	      c = __pgm_read_byte (lz->in ++);
+	      goto out;
+	    }
+
+	  lz->match_dist = __pgm_read_byte (lz->in ++);
+	  lz->match_len = __pgm_read_byte (lz->in ++)
+	    + VFS_INLINE_LZ_MIN_MATCH;
+	}
+
+      c = lz->window[(uint8_t) (lz->wpos - lz->match_dist - 1)];
+      lz->match_len --;
+
+    out:
+      lz->window[lz->wpos ++] = c;
+      if (buf)
+	buf[n] = c;
+      fh->u.il.pos ++;
+    }
+
+  return n;
+}
+
+vfs_size_t
+vfs_inline_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  if (fh->u.il.lz)
+    return vfs_inline_lz_read (fh, buf, length);
+
+  vfs_size_t len = fh->u.il.len - fh->u.il.pos;
+  if (length < len) len = length;
+
+  for (vfs_size_t i = 0; i < len; i ++)
+    ((unsigned char *)buf)[i] =
+      __pgm_read_byte (fh->u.il.offset + fh->u.il.pos + i);
+
+  fh->u.il.pos += (uint16_t)len;
+  return len;
+}
+
+#else  /* not VFS_INLINE_PACKED_SUPPORT */
+
 struct vfs_file_handle_t *
 vfs_inline_open (const char *filename)
 {
@@ -89,8 +287,9 @@ vfs_inline_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
   fh->u.il.pos += (uint16_t)len;
   return len;
 }
+#endif	/* not VFS_INLINE_PACKED_SUPPORT */
 
-#ifndef VFS_TEENSY
+#if !defined(VFS_TEENSY) || defined(VFS_INLINE_PACKED_SUPPORT)
 uint8_t
 vfs_inline_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
 		  uint8_t whence)
@@ -118,6 +317,23 @@ vfs_inline_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
   if (new_pos > fh->u.il.len)
     return -1;			/* Beyond end of file. */
 
+#ifdef VFS_INLINE_PACKED_SUPPORT
+  if (fh->u.il.lz)
+    {
+      /* The stream can only be decompressed forward. */
+      if (new_pos < fh->u.il.pos)
+	{
+	  fh->u.il.lz->in = fh->u.il.offset;
+	  fh->u.il.lz->bits = 0;
+	  fh->u.il.lz->match_len = 0;
+	  fh->u.il.lz->wpos = 0;
+	  fh->u.il.pos = 0;
+	}
+      vfs_inline_lz_read (fh, NULL, new_pos - fh->u.il.pos);
+      return 0;
+    }
+#endif
+
   fh->u.il.pos = new_pos;
   return 0;
 }
@@ -127,4 +343,4 @@ vfs_inline_size (struct vfs_file_handle_t *fh)
 {
   return fh->u.il.len;
 }
-#endif	/* VFS_TEENSY */
+#endif	/* not VFS_TEENSY or VFS_INLINE_PACKED_SUPPORT */
@@ -37,10 +37,61 @@ union vfs_inline_node_t {
   unsigned char raw[0];
 };
 
+/* Packed image, written by vfs-pack at a page boundary after the
+ * firmware: magic, header, the index sorted by (hash, fn) and the file
+ * data without any padding. */
+#define VFS_INLINE_PACKED_MAGIC 0x24
+
+#define VFS_INLINE_STORED 0
+#define VFS_INLINE_LZ     1	/* LZSS, decompressed on the fly */
+#define VFS_INLINE_GZIP   2	/* gzip, for the browser */
+
+/* LZSS stream: a flag byte announces the next eight items (LSB first),
+ * set bits are literal bytes, clear bits two byte back references:
+ * distance - 1 and length - VFS_INLINE_LZ_MIN_MATCH. */
+#define VFS_INLINE_LZ_WINDOW    256
+#define VFS_INLINE_LZ_MIN_MATCH 3
+#define VFS_INLINE_LZ_MAX_MATCH (255 + VFS_INLINE_LZ_MIN_MATCH)
+
+struct __attribute__((__packed__)) vfs_inline_image_t {
+  uint16_t count;		/* Number of index entries. */
+  uint8_t crc;			/* Over count and the index. */
+};
+
+struct __attribute__((__packed__)) vfs_inline_entry_t {
+  uint16_t hash;
+  char fn[VFS_INLINE_FNLEN];
+  uint8_t flags;
+  uint32_t offset;		/* Relative to the magic byte. */
+  uint16_t len;			/* Uncompressed length. */
+};
+
+static inline uint16_t
+vfs_inline_hash (const char *fn)
+{
+  uint16_t hash = 5381;
+  for (uint8_t i = 0; i < VFS_INLINE_FNLEN && fn[i]; i ++)
+    hash = (hash * 33) ^ (uint8_t) fn[i];
+  return hash;
+}
+
+struct vfs_inline_lz_t {
+  uint16_t match_len;		/* Bytes left of the current match. */
+  uint8_t match_dist;		/* Its distance - 1. */
+  uint8_t flags;		/* Flag byte, shifted. */
+  uint8_t bits;			/* Flags left in it. */
+  uint8_t wpos;
+  vfs_size_t in;		/* Read position in program memory. */
+  uint8_t window[VFS_INLINE_LZ_WINDOW];
+};
+
 typedef struct {
   vfs_size_t offset;		/* Offset in program memory. */
   uint16_t pos;			/* Position in file. */
   uint16_t len;			/* Length of file. */
+#ifdef VFS_INLINE_PACKED_SUPPORT
+  struct vfs_inline_lz_t *lz;	/* NULL unless VFS_INLINE_LZ */
+#endif
 } vfs_file_handle_inline_t;
 
 /* vfs_sd_ Prototypes. */
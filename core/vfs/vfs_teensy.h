@@ -37,9 +37,16 @@
 
 #define vfs_open	vfs_inline_open
 #define vfs_read	vfs_inline_read
+#define vfs_size(fh)	((fh)->u.il.len)
+#ifdef VFS_INLINE_PACKED_SUPPORT
+/* Compressed files have to be decompressed up to the position. */
+#define vfs_close	vfs_inline_close
+#define vfs_fseek	vfs_inline_fseek
+#define vfs_rewind(fh)  vfs_inline_fseek(fh, 0, SEEK_SET)
+#else
 #define vfs_close(i)	free(i)
 #define vfs_fseek(fh,p,w)   (((w) == SEEK_SET) ? ((fh)->u.il.pos = (p)) : -1)
-#define vfs_size(fh)	((fh)->u.il.len)
 #define vfs_rewind(fh)  ((fh)->u.il.pos = 0)
+#endif
 
 #endif  /* VFS_TEENSY_H */
@@ -34,6 +34,7 @@
 #include "core/global.h"
 #include "core/debug.h"
 #include "core/spi.h"
+#include "core/eeprom.h"
 #include "core/mbr.h"
 #include "network.h"
 #include "core/portio/portio.h"
@@ -246,6 +247,7 @@ main (void)
 #ifdef DCF77_SUPPORT
       ACSR &= ~_BV (ACIE);
 #endif
+      eeprom_flush();
       cli();
 #ifdef _ATMEGA2560
       EIND = 0x01;
@@ -257,6 +259,7 @@ main (void)
 #ifndef TEENSY_SUPPORT
     if (status.request_wdreset)
     {
+      eeprom_flush();
       cli();
       wdt_enable(WDTO_15MS);
       for (;;);
@@ -265,6 +268,7 @@ main (void)
 
     if (status.request_reset)
     {
+      eeprom_flush();
       cli();
 #ifdef _ATMEGA2560
       EIND = 0x00;
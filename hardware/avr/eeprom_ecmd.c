@@ -28,7 +28,7 @@
 #include "protocols/ecmd/ecmd-base.h"
 #include "core/util/string_parsing.h"
 
-#define eeprom_start (sizeof(struct eeprom_config_t))
+#define eeprom_start (EEPROM_CONFIG_END)
 
 int16_t
 parse_cmd_eer(char *cmd, char *output, uint16_t len)
@@ -51,8 +51,11 @@ parse_cmd_eer(char *cmd, char *output, uint16_t len)
 
   uint16_t ptr = eeprom_start + addr_offset;
   for (uint16_t i = 0; i < length; i++)
-    sprintf_P(output + (i << 1), PSTR("%02x"),
-              eeprom_read_byte((uint8_t *) (ptr++)));
+  {
+    uint8_t value;
+    eeprom_read_block_hack(&value, (uint8_t *) (ptr++), 1);
+    sprintf_P(output + (i << 1), PSTR("%02x"), value);
+  }
 
   return ECMD_FINAL(length * 2);
 }
@@ -85,7 +88,7 @@ parse_cmd_eew(char *cmd, char *output, uint16_t len)
       return sprintf(output, "%d hexbyte '%x'", i, value);
     cmd += p;
 
-    eeprom_write_byte((uint8_t *) (ptr++), value);
+    eeprom_write_block_hack((uint8_t *) (ptr++), &value, 1);
     i++;
   }
 
@@ -26,6 +26,9 @@
 #define I2C_SLA_24CXX 80
 
 void i2c_24CXX_init(void);
+#ifdef I2C_24CXX_HOST_SUPPORT
+void i2c_24CXX_exit(void);
+#endif
 uint8_t i2c_24CXX_set_addr(uint16_t addr);
 
 uint8_t i2c_24CXX_write_byte(uint16_t addr, uint8_t data);
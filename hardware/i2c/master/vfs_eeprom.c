@@ -21,12 +21,11 @@
  */
 
 #include <avr/io.h>
-#include <util/twi.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "config.h"
 #include "core/debug.h"
-#include "hardware/i2c/master/i2c_master.h"
 #include "hardware/i2c/master/i2c_24CXX.h"
 #include "core/vfs/vfs.h"
 
@@ -42,6 +41,94 @@
 #define vfs_eeprom_write_page(page, data, len) i2c_24CXX_write_block(page * SFS_PAGE_SIZE, data, len)
 #define vfs_eeprom_write_slice(page, offset, data, len) i2c_24CXX_write_block(page * SFS_PAGE_SIZE + offset , data, len)
 
+/* RAM copy of the on-chip file chain, in chain order.  Lookups compare
+ * the name hash first and read the file page only on a match. */
+struct vfs_eeprom_dirent
+{
+  vfs_eeprom_inode_t inode;
+  uint8_t hash;
+};
+
+static struct vfs_eeprom_dirent vfs_eeprom_dir[SFS_MAX_FILES];
+static uint8_t vfs_eeprom_dir_count;
+/* set if the chip holds more files than fit into vfs_eeprom_dir,
+ * lookups walk the chain on the chip then */
+static uint8_t vfs_eeprom_dir_overflow;
+
+/* One bit per page, set if the page is in use. */
+static uint8_t vfs_eeprom_used[(SFS_PAGE_COUNT + 7) / 8];
+
+/* Allocation starts where the last one left off, so rewritten files
+ * move through the whole chip instead of hammering the first pages. */
+static vfs_eeprom_inode_t vfs_eeprom_alloc_next = 1;
+
+#define vfs_eeprom_page_used(p) \
+  (vfs_eeprom_used[(p) >> 3] & _BV((p) & 7))
+#define vfs_eeprom_mark_used(p) \
+  (vfs_eeprom_used[(p) >> 3] |= _BV((p) & 7))
+#define vfs_eeprom_mark_free(p) \
+  (vfs_eeprom_used[(p) >> 3] &= (uint8_t) ~_BV((p) & 7))
+
+static uint8_t
+vfs_eeprom_hash(const char *filename)
+{
+  uint8_t hash = 0;
+  while (*filename)
+    hash = (uint8_t) ((hash << 1) | (hash >> 7)) ^ (uint8_t) * filename++;
+  return hash;
+}
+
+static void
+vfs_eeprom_scan(void)
+{
+  unsigned char buf[SFS_PAGE_SIZE];
+  struct vfs_eeprom_page_file *file = (struct vfs_eeprom_page_file *) buf;
+
+  memset(vfs_eeprom_used, 0, sizeof(vfs_eeprom_used));
+  vfs_eeprom_mark_used(0);
+  vfs_eeprom_alloc_next = 1;
+  for (vfs_eeprom_inode_t page = 1; page < SFS_PAGE_COUNT; page++)
+  {
+    wdt_kick();
+    if (!vfs_eeprom_read_page(page, buf, 1))
+      continue;
+    if (buf[0] == SFS_MAGIC_FILE || buf[0] == SFS_MAGIC_DATA)
+    {
+      vfs_eeprom_mark_used(page);
+      /* continue behind the highest page in use, so the round robin
+       * doesn't restart at the first pages after every reset */
+      vfs_eeprom_alloc_next = page + 1;
+    }
+  }
+  if (vfs_eeprom_alloc_next >= SFS_PAGE_COUNT)
+    vfs_eeprom_alloc_next = 1;
+
+  vfs_eeprom_dir_count = 0;
+  vfs_eeprom_dir_overflow = 0;
+  vfs_eeprom_read_page(0, buf, sizeof(struct vfs_eeprom_page_superblock));
+  vfs_eeprom_inode_t inode =
+    ((struct vfs_eeprom_page_superblock *) buf)->next_file;
+  while (inode)
+  {
+    vfs_eeprom_read_page(inode, buf, SFS_PAGE_SIZE);
+    if (file->magic != SFS_MAGIC_FILE)
+      break;
+    if (vfs_eeprom_dir_count == SFS_MAX_FILES)
+    {
+      vfs_eeprom_debug("directory full, falling back to chain walk\n");
+      vfs_eeprom_dir_overflow = 1;
+      break;
+    }
+    file->filename_0byte = 0;
+    vfs_eeprom_dir[vfs_eeprom_dir_count].inode = inode;
+    vfs_eeprom_dir[vfs_eeprom_dir_count].hash =
+      vfs_eeprom_hash(file->filename);
+    vfs_eeprom_dir_count++;
+    inode = file->next_file;
+  }
+  vfs_eeprom_debug("%d files indexed\n", vfs_eeprom_dir_count);
+}
+
 void
 vfs_eeprom_init(void)
 {
@@ -85,36 +172,39 @@ vfs_eeprom_init(void)
   {
     vfs_eeprom_debug("detected, version %d\n", sb->version);
   }
+
+  vfs_eeprom_scan();
 }
 
+/* Take the next free page in round-robin order and mark it used. */
 static vfs_eeprom_inode_t
-vfs_eeprom_find_free_page(vfs_eeprom_inode_t suggested)
+vfs_eeprom_find_free_page(void)
 {
-  unsigned char buf[1];
-
-  vfs_eeprom_inode_t tmp = suggested;
+  vfs_eeprom_inode_t tmp = vfs_eeprom_alloc_next;
 
-  while (1)
+  do
   {
-    if (!vfs_eeprom_read_page(tmp, buf, 1))
-      return 0;
-    if (buf[0] != SFS_MAGIC_SUPERBLOCK &&
-        buf[0] != SFS_MAGIC_FILE &&
-        buf[0] != SFS_MAGIC_DATA)
+    if (!vfs_eeprom_page_used(tmp))
     {
       vfs_eeprom_debug("found empty page at %d\n", tmp);
-      return tmp;               /* yeah we have found an empty page */
+      vfs_eeprom_mark_used(tmp);
+      vfs_eeprom_alloc_next = tmp + 1;
+      if (vfs_eeprom_alloc_next >= SFS_PAGE_COUNT)
+        vfs_eeprom_alloc_next = 1;
+      return tmp;
     }
     tmp++;
     if (tmp >= SFS_PAGE_COUNT)
-      tmp = 0;
-    if (tmp == suggested)
-      return 0;                 /* 0 is the superblock, always so this indicates an error */
+      tmp = 1;
   }
+  while (tmp != vfs_eeprom_alloc_next);
+
+  return 0;                     /* 0 is the superblock, always so this indicates an error */
 }
 
 static vfs_eeprom_inode_t
-vfs_eeprom_find_file(const char *filename, vfs_eeprom_inode_t * prev_inode)
+vfs_eeprom_find_file_chain(const char *filename,
+                           vfs_eeprom_inode_t * prev_inode)
 {
   unsigned char buf[SFS_PAGE_SIZE];
   struct vfs_eeprom_page_file *file = (struct vfs_eeprom_page_file *) buf;
@@ -158,10 +248,50 @@ vfs_eeprom_find_file(const char *filename, vfs_eeprom_inode_t * prev_inode)
   return 0;
 }
 
+/* Look up filename (or the last file if filename is NULL) and return its
+ * inode, *dirent is set to its directory index if found by name. */
+static vfs_eeprom_inode_t
+vfs_eeprom_find_file(const char *filename, vfs_eeprom_inode_t * prev_inode,
+                     uint8_t * dirent)
+{
+  if (vfs_eeprom_dir_overflow)
+    return vfs_eeprom_find_file_chain(filename, prev_inode);
+
+  if (!filename)
+  {
+    if (!vfs_eeprom_dir_count)
+      return 0;
+    return vfs_eeprom_dir[vfs_eeprom_dir_count - 1].inode;
+  }
+
+  unsigned char buf[SFS_PAGE_SIZE];
+  struct vfs_eeprom_page_file *file = (struct vfs_eeprom_page_file *) buf;
+  uint8_t hash = vfs_eeprom_hash(filename);
+
+  for (uint8_t i = 0; i < vfs_eeprom_dir_count; i++)
+  {
+    if (vfs_eeprom_dir[i].hash != hash)
+      continue;
+    vfs_eeprom_read_page(vfs_eeprom_dir[i].inode, buf, SFS_PAGE_SIZE);
+    if (strncmp(file->filename, filename, sizeof(file->filename)) == 0)
+    {
+      if (prev_inode)
+        *prev_inode = i ? vfs_eeprom_dir[i - 1].inode : 0;
+      if (dirent)
+        *dirent = i;
+      return vfs_eeprom_dir[i].inode;
+    }
+  }
+
+  vfs_eeprom_debug("file %s not found\n", filename);
+  return 0;
+}
+
 struct vfs_file_handle_t *
 vfs_eeprom_create(const char *filename)
 {
-  vfs_eeprom_inode_t inode = vfs_eeprom_find_file(filename, NULL);
+  uint8_t dirent;
+  vfs_eeprom_inode_t inode = vfs_eeprom_find_file(filename, NULL, &dirent);
   vfs_eeprom_inode_t next_file = 0;
 
   unsigned char buf[SFS_PAGE_SIZE];
@@ -170,15 +300,24 @@ vfs_eeprom_create(const char *filename)
 
   if (inode == 0)
   {
-    inode = vfs_eeprom_find_free_page(inode);
+    inode = vfs_eeprom_find_free_page();
     if (inode == 0)
     {
       vfs_eeprom_debug("no space left on device\n");
       return NULL;
     }
-    vfs_eeprom_inode_t last_file = vfs_eeprom_find_file(NULL, NULL);    /* find the last file */
+    vfs_eeprom_inode_t last_file = vfs_eeprom_find_file(NULL, NULL, NULL);     /* find the last file */
     vfs_eeprom_debug("last file in chain is %d\n", last_file);
     vfs_eeprom_write_slice(last_file, 3, (unsigned char *) &inode, 2);
+
+    if (vfs_eeprom_dir_count == SFS_MAX_FILES)
+      vfs_eeprom_dir_overflow = 1;
+    if (!vfs_eeprom_dir_overflow)
+    {
+      vfs_eeprom_dir[vfs_eeprom_dir_count].inode = inode;
+      vfs_eeprom_dir[vfs_eeprom_dir_count].hash = vfs_eeprom_hash(filename);
+      vfs_eeprom_dir_count++;
+    }
   }
   else
   {
@@ -192,8 +331,9 @@ vfs_eeprom_create(const char *filename)
     {
       vfs_eeprom_read_page(next_page, buf, 4);
       vfs_eeprom_inode_t tmp = data->next_page;
-      memset(buf, 0, 4);
-      vfs_eeprom_write_page(next_page, buf, 4);
+      buf[0] = 0;
+      vfs_eeprom_write_page(next_page, buf, 1);
+      vfs_eeprom_mark_free(next_page);
       vfs_eeprom_debug("clear page %d\n", next_page);
       next_page = tmp;
     }
@@ -218,7 +358,7 @@ vfs_eeprom_create(const char *filename)
 struct vfs_file_handle_t *
 vfs_eeprom_open(const char *filename)
 {
-  vfs_eeprom_inode_t inode = vfs_eeprom_find_file(filename, NULL);
+  vfs_eeprom_inode_t inode = vfs_eeprom_find_file(filename, NULL, NULL);
 
   if (inode == 0)
     return NULL;
@@ -304,7 +444,7 @@ vfs_eeprom_read(struct vfs_file_handle_t * handle, void *buffer,
     vfs_eeprom_debug("read; read page: %d\n", next_page);
     vfs_eeprom_read_page(next_page, buf, SFS_PAGE_SIZE);
     if (data_page->magic != SFS_MAGIC_DATA)
-      return 0;
+      return count;
     vfs_eeprom_len_t to_be_copied = sizeof(data_page->data);
     vfs_eeprom_len_t page_offset =
       handle->u.ee.offset % sizeof(data_page->data);
@@ -318,9 +458,10 @@ vfs_eeprom_read(struct vfs_file_handle_t * handle, void *buffer,
     {
       vfs_eeprom_debug("read; offset: %d, to_be_copied: %d\n",
                        page_offset, to_be_copied);
-      if (page_offset == 0)
+      if (data_page->page_len < sizeof(data_page->data))
         eof = 1;                /* We have reached the end of the file */
-      to_be_copied = data_page->page_len - page_offset;
+      to_be_copied = page_offset < data_page->page_len ?
+        data_page->page_len - page_offset : 0;
     }
 
     memcpy(buffer + count, data_page->data + page_offset, to_be_copied);
@@ -432,7 +573,7 @@ vfs_eeprom_write(struct vfs_file_handle_t * handle, void *data,
 
   while (pages_needed--)
   {
-    vfs_eeprom_inode_t new_node = vfs_eeprom_find_free_page(last_page + 1);
+    vfs_eeprom_inode_t new_node = vfs_eeprom_find_free_page();
     if (new_node == 0)
     {
       vfs_eeprom_debug("no space left on device\n");
@@ -469,8 +610,10 @@ vfs_eeprom_write(struct vfs_file_handle_t * handle, void *data,
     vfs_eeprom_debug("%d, %d, %d, %d\n", write_page, 4 + write_offset,
                      data_page->page_len, copy_len);
 
-    vfs_eeprom_write_slice(write_page, 4 + write_offset, data, copy_len);
-    vfs_eeprom_write_slice(write_page, 3, &data_page->page_len, 1);
+    /* header and payload go out in one go, i.e. a single write cycle
+     * as long as the page does not straddle a chip page boundary */
+    memcpy(data_page->data + write_offset, data, copy_len);
+    vfs_eeprom_write_page(write_page, buf, 4 + write_offset + copy_len);
     write_offset = 0;
     write_page = data_page->next_page;
     /* Read the next page */
@@ -492,7 +635,9 @@ vfs_eeprom_unlink(const char *filename)
     (struct vfs_eeprom_page_data *) buf;
 
   vfs_eeprom_inode_t prev_inode;
-  vfs_eeprom_inode_t inode = vfs_eeprom_find_file(filename, &prev_inode);
+  uint8_t dirent;
+  vfs_eeprom_inode_t inode =
+    vfs_eeprom_find_file(filename, &prev_inode, &dirent);
 
   if (inode == 0)
     return 1;                   /* file not found */
@@ -501,19 +646,33 @@ vfs_eeprom_unlink(const char *filename)
   vfs_eeprom_inode_t next_page = file_page->next_page;
   vfs_eeprom_inode_t next_file = file_page->next_file;
 
-  vfs_eeprom_read_page(prev_inode, buf, SFS_PAGE_SIZE);
-  file_page->next_file = next_file;
-  vfs_eeprom_write_page(prev_inode, buf, SFS_PAGE_SIZE);
+  vfs_eeprom_write_slice(prev_inode, 3, (unsigned char *) &next_file, 2);
 
-  memset(buf, 0, SFS_PAGE_SIZE);
-  vfs_eeprom_write_page(inode, buf, SFS_PAGE_SIZE);
+  buf[0] = 0;
+  vfs_eeprom_write_page(inode, buf, 1);
+  vfs_eeprom_mark_free(inode);
 
   while (next_page)
   {
     vfs_eeprom_read_page(next_page, buf, 4);
-    next_page = data_page->next_page;
-    memset(buf, 0, SFS_PAGE_SIZE);
-    vfs_eeprom_write_page(inode, buf, SFS_PAGE_SIZE);
+    vfs_eeprom_inode_t tmp = data_page->next_page;
+    buf[0] = 0;
+    vfs_eeprom_write_page(next_page, buf, 1);
+    vfs_eeprom_mark_free(next_page);
+    next_page = tmp;
+  }
+
+  if (!vfs_eeprom_dir_overflow)
+  {
+    vfs_eeprom_dir_count--;
+    memmove(&vfs_eeprom_dir[dirent], &vfs_eeprom_dir[dirent + 1],
+            (vfs_eeprom_dir_count - dirent) *
+            sizeof(struct vfs_eeprom_dirent));
+  }
+  else
+  {
+    /* there might be room in the directory now */
+    vfs_eeprom_scan();
   }
 
   return 0;
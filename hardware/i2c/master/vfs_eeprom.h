@@ -32,6 +32,9 @@
 #ifndef SFS_PAGE_COUNT
 	#define SFS_PAGE_COUNT 1
 #endif
+#ifndef SFS_MAX_FILES
+	#define SFS_MAX_FILES 1
+#endif
 
 #define SFS_MAGIC_SUPERBLOCK 0x5
 #define SFS_MAGIC_FILE 0x23
@@ -121,10 +121,10 @@ irmp_mqtt_connack_cb(void)
   mqtt_construct_subscribe_packet_P(PSTR(IRMP_MQTT_SUBSCRIBE));
 }
 
-static const char irmp_mqtt_tx_topic[] PROGMEM = IRMP_MQTT_TX_TOPIC;
+static const char irmp_mqtt_tx_topic[] PROGMEM = IRMP_MQTT_SUBSCRIBE;
 
 const mqtt_callback_config_t irmp_mqtt_module_config PROGMEM = {
-  .topic = (const char *const *) irmp_mqtt_tx_topic,
+  .topic = irmp_mqtt_tx_topic,
 #ifdef IRMP_TX_SUPPORT
   .connack_callback = irmp_mqtt_connack_cb,
 #endif
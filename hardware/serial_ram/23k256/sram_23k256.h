@@ -28,6 +28,9 @@
 int16_t sram23k256_init(void);
 void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8);
 void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8);
+#ifdef SER_RAM_23K256_HOST_SUPPORT
+void sram23k256_exit(void);
+#endif
 
 #include "config.h"
 #ifdef DEBUG_SER_RAM_23K256
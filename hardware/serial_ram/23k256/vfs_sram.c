@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* RAM disk on the 23K256 serial RAM.
+ *
+ * The directory and the block bitmap are kept in the MCU's RAM, the
+ * serial RAM only holds file data.  Everything is lost on reset, that's
+ * what scratch space is for. */
+
+#include <string.h>
+
+#include "config.h"
+#include "core/vfs/vfs.h"
+
+static struct vfs_sram_file_t vfs_sram_files[CONF_VFS_SRAM_FILES];
+static uint8_t vfs_sram_used[VFS_SRAM_BLOCKS / 8];
+
+#define BS VFS_SRAM_BLOCK_SIZE
+
+#define vfs_sram_block_used(b) \
+  (vfs_sram_used[(b) / 8] & (1 << ((b) % 8)))
+
+
+static void
+vfs_sram_mark(uint8_t start, uint8_t count, uint8_t used)
+{
+  for (uint16_t b = start; b < start + count; b++)
+  {
+    if (used)
+      vfs_sram_used[b / 8] |= 1 << (b % 8);
+    else
+      vfs_sram_used[b / 8] &= ~(1 << (b % 8));
+  }
+}
+
+/* Return the index of the file named NAME (without prefix), or -1. */
+static int8_t
+vfs_sram_find(const char *name)
+{
+  for (uint8_t i = 0; i < CONF_VFS_SRAM_FILES; i++)
+    if (vfs_sram_files[i].name[0]
+        && strncmp(vfs_sram_files[i].name, name, VFS_SRAM_NAMELEN) == 0)
+      return i;
+
+  return -1;
+}
+
+/* Strip VFS_SRAM_PREFIX from NAME, NULL if it doesn't belong to us. */
+static const char *
+vfs_sram_name(const char *name)
+{
+  uint8_t len = strlen(VFS_SRAM_PREFIX);
+  if (strncmp(name, VFS_SRAM_PREFIX, len) != 0)
+    return NULL;
+
+  name += len;
+  if (*name == 0 || strlen(name) > VFS_SRAM_NAMELEN)
+    return NULL;
+
+  return name;
+}
+
+static uint16_t
+vfs_sram_capacity(struct vfs_sram_file_t *file)
+{
+  uint16_t blocks = 0;
+  for (uint8_t i = 0; i < VFS_SRAM_EXTENTS; i++)
+    blocks += file->extent[i].count;
+  return blocks * BS;
+}
+
+/* Make room for LENGTH bytes in FILE, returns the bytes available. */
+static uint16_t
+vfs_sram_grow(struct vfs_sram_file_t *file, uint16_t length)
+{
+  uint16_t capacity = vfs_sram_capacity(file);
+
+  while (capacity < length)
+  {
+    uint16_t need = (length - capacity + BS - 1) / BS;
+    uint8_t i;
+    for (i = 0; i < VFS_SRAM_EXTENTS && file->extent[i].count; i++);
+
+    /* Extend the last extent in place if possible. */
+    if (i > 0)
+    {
+      struct vfs_sram_extent_t *last = &file->extent[i - 1];
+      uint16_t b = last->start + last->count;
+      if (b < VFS_SRAM_BLOCKS && !vfs_sram_block_used(b)
+          && last->count < 255)
+      {
+        vfs_sram_mark(b, 1, 1);
+        last->count++;
+        capacity += BS;
+        continue;
+      }
+    }
+
+    if (i == VFS_SRAM_EXTENTS)
+      break;                    /* Too fragmented. */
+
+    /* Writers appending in turn would use up the extents quickly, ask
+     * for at least as much as the file has got already.  The excess is
+     * given back on close. */
+    uint16_t min = capacity / BS;
+    if (need < min)
+      need = min;
+    if (need < 2)
+      need = 2;
+    if (need > 255)
+      need = 255;
+
+    /* First fit, or else the largest free run. */
+    uint16_t best_start = 0, best_len = 0;
+    for (uint16_t b = 0; b < VFS_SRAM_BLOCKS && best_len < need;)
+    {
+      if (vfs_sram_block_used(b))
+      {
+        b++;
+        continue;
+      }
+      uint16_t start = b;
+      while (b < VFS_SRAM_BLOCKS && !vfs_sram_block_used(b)
+             && b - start < need)
+        b++;
+      if (b - start > best_len)
+      {
+        best_start = start;
+        best_len = b - start;
+      }
+    }
+
+    if (best_len == 0)
+      break;                    /* SRAM full. */
+
+    file->extent[i].start = best_start;
+    file->extent[i].count = best_len;
+    vfs_sram_mark(best_start, best_len, 1);
+    capacity += best_len * BS;
+  }
+
+  return capacity < length ? capacity : length;
+}
+
+/* Release the blocks behind LENGTH bytes. */
+static void
+vfs_sram_shrink(struct vfs_sram_file_t *file, uint16_t length)
+{
+  uint16_t keep = (length + BS - 1) / BS;
+
+  for (uint8_t i = 0; i < VFS_SRAM_EXTENTS; i++)
+  {
+    struct vfs_sram_extent_t *e = &file->extent[i];
+    if (keep >= e->count)
+    {
+      keep -= e->count;
+      continue;
+    }
+
+    vfs_sram_mark(e->start + keep, e->count - keep, 0);
+    e->count = keep;
+    keep = 0;
+  }
+}
+
+/* Copy LEN bytes at file position POS from or to the serial RAM. */
+static void
+vfs_sram_io(struct vfs_sram_file_t *file, uint16_t pos, uint8_t *buf,
+            uint16_t len, uint8_t write)
+{
+  for (uint8_t i = 0; len && i < VFS_SRAM_EXTENTS; i++)
+  {
+    uint16_t ext_len = file->extent[i].count * BS;
+    if (pos >= ext_len)
+    {
+      pos -= ext_len;
+      continue;
+    }
+
+    while (len && pos < ext_len)
+    {
+      uint16_t n = ext_len - pos;
+      if (n > len)
+        n = len;
+      if (n > 255)
+        n = 255;
+
+      uint16_t addr = file->extent[i].start * BS + pos;
+      if (write)
+        sram23k256_write(addr, buf, n);
+      else
+        sram23k256_read(addr, buf, n);
+
+      buf += n;
+      pos += n;
+      len -= n;
+    }
+    pos = 0;
+  }
+}
+
+
+void
+vfs_sram_init(void)
+{
+  memset(vfs_sram_files, 0, sizeof(vfs_sram_files));
+  memset(vfs_sram_used, 0, sizeof(vfs_sram_used));
+}
+
+struct vfs_file_handle_t *
+vfs_sram_open(const char *filename)
+{
+  const char *name = vfs_sram_name(filename);
+  if (name == NULL)
+    return NULL;
+
+  int8_t file = vfs_sram_find(name);
+  if (file < 0)
+    return NULL;
+
+  struct vfs_file_handle_t *fh = malloc(sizeof(struct vfs_file_handle_t));
+  if (fh == NULL)
+    return NULL;
+
+  fh->fh_type = VFS_SRAM;
+  fh->u.sram.file = file;
+  fh->u.sram.offset = 0;
+  return fh;
+}
+
+void
+vfs_sram_close(struct vfs_file_handle_t *fh)
+{
+  struct vfs_sram_file_t *file = &vfs_sram_files[fh->u.sram.file];
+  vfs_sram_shrink(file, file->size);
+  free(fh);
+}
+
+vfs_size_t
+vfs_sram_read(struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  struct vfs_sram_file_t *file = &vfs_sram_files[fh->u.sram.file];
+
+  if (fh->u.sram.offset >= file->size)
+    return 0;
+  if (length > file->size - fh->u.sram.offset)
+    length = file->size - fh->u.sram.offset;
+
+  vfs_sram_io(file, fh->u.sram.offset, buf, length, 0);
+  fh->u.sram.offset += length;
+  return length;
+}
+
+vfs_size_t
+vfs_sram_write(struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  struct vfs_sram_file_t *file = &vfs_sram_files[fh->u.sram.file];
+
+  if ((uint32_t) fh->u.sram.offset + length > UINT16_MAX)
+    length = UINT16_MAX - fh->u.sram.offset;
+
+  length = vfs_sram_grow(file, fh->u.sram.offset + length)
+    - fh->u.sram.offset;
+
+  vfs_sram_io(file, fh->u.sram.offset, buf, length, 1);
+  fh->u.sram.offset += length;
+  if (fh->u.sram.offset > file->size)
+    file->size = fh->u.sram.offset;
+
+  return length;
+}
+
+uint8_t
+vfs_sram_fseek(struct vfs_file_handle_t *fh, vfs_size_t offset,
+               uint8_t whence)
+{
+  struct vfs_sram_file_t *file = &vfs_sram_files[fh->u.sram.file];
+  vfs_size_t new_pos;
+
+  switch (whence)
+  {
+    case SEEK_SET:
+      new_pos = offset;
+      break;
+
+    case SEEK_CUR:
+      new_pos = fh->u.sram.offset + offset;
+      break;
+
+    case SEEK_END:
+      new_pos = file->size + offset;
+      break;
+
+    default:
+      return -1;                /* Invalid argument. */
+  }
+
+  if (new_pos > file->size)
+    return -1;                  /* Beyond end of file. */
+
+  fh->u.sram.offset = new_pos;
+  return 0;
+}
+
+uint8_t
+vfs_sram_truncate(struct vfs_file_handle_t *fh, vfs_size_t length)
+{
+  struct vfs_sram_file_t *file = &vfs_sram_files[fh->u.sram.file];
+
+  if (length > file->size)
+    return 1;
+
+  vfs_sram_shrink(file, length);
+  file->size = length;
+  if (fh->u.sram.offset > length)
+    fh->u.sram.offset = length;
+
+  return 0;
+}
+
+struct vfs_file_handle_t *
+vfs_sram_create(const char *filename)
+{
+  const char *name = vfs_sram_name(filename);
+  if (name == NULL)
+    return NULL;
+
+  int8_t file = vfs_sram_find(name);
+  if (file < 0)
+  {
+    for (file = 0; file < CONF_VFS_SRAM_FILES; file++)
+      if (vfs_sram_files[file].name[0] == 0)
+        break;
+    if (file == CONF_VFS_SRAM_FILES)
+      return NULL;              /* Directory full. */
+
+    strncpy(vfs_sram_files[file].name, name, VFS_SRAM_NAMELEN);
+  }
+
+  vfs_sram_shrink(&vfs_sram_files[file], 0);
+  vfs_sram_files[file].size = 0;
+
+  return vfs_sram_open(filename);
+}
+
+uint8_t
+vfs_sram_unlink(const char *filename)
+{
+  const char *name = vfs_sram_name(filename);
+  if (name == NULL)
+    return 1;
+
+  int8_t file = vfs_sram_find(name);
+  if (file < 0)
+    return 1;
+
+  vfs_sram_shrink(&vfs_sram_files[file], 0);
+  memset(&vfs_sram_files[file], 0, sizeof(struct vfs_sram_file_t));
+  return 0;
+}
+
+vfs_size_t
+vfs_sram_size(struct vfs_file_handle_t *fh)
+{
+  return vfs_sram_files[fh->u.sram.file].size;
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/serial_ram/23k256/vfs_sram.h)
+  init(vfs_sram_init)
+*/
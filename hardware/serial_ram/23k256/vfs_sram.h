@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef VFS_SRAM_H
+#define VFS_SRAM_H
+
+#include <stdlib.h>
+#include "hardware/serial_ram/23k256/sram_23k256.h"
+
+/* Files of this backend live below "ram/", the backend is tried first
+ * so files with this prefix never end up on a persistent store. */
+#define VFS_SRAM_PREFIX "ram/"
+#define VFS_SRAM_NAMELEN 8
+
+/* The serial RAM is split in 256 blocks, files are made of up to
+ * VFS_SRAM_EXTENTS runs of consecutive blocks. */
+#define VFS_SRAM_BLOCKS 256
+#define VFS_SRAM_BLOCK_SIZE (SRAM23K256_SIZE / VFS_SRAM_BLOCKS)
+#define VFS_SRAM_EXTENTS 8
+
+#ifndef CONF_VFS_SRAM_FILES
+#define CONF_VFS_SRAM_FILES 8
+#endif
+
+struct vfs_sram_extent_t
+{
+  uint8_t start;
+  uint8_t count;                /* 0: unused */
+};
+
+struct vfs_sram_file_t
+{
+  char name[VFS_SRAM_NAMELEN];  /* empty: unused */
+  uint16_t size;
+  struct vfs_sram_extent_t extent[VFS_SRAM_EXTENTS];
+};
+
+typedef struct
+{
+  uint8_t file;
+  uint16_t offset;
+} vfs_file_handle_sram_t;
+
+void vfs_sram_init(void);
+
+struct vfs_file_handle_t *vfs_sram_open(const char *filename);
+void vfs_sram_close(struct vfs_file_handle_t *);
+vfs_size_t vfs_sram_read(struct vfs_file_handle_t *, void *buf,
+                         vfs_size_t length);
+vfs_size_t vfs_sram_write(struct vfs_file_handle_t *, void *buf,
+                          vfs_size_t length);
+uint8_t vfs_sram_fseek(struct vfs_file_handle_t *, vfs_size_t offset,
+                       uint8_t whence);
+uint8_t vfs_sram_truncate(struct vfs_file_handle_t *, vfs_size_t length);
+struct vfs_file_handle_t *vfs_sram_create(const char *name);
+uint8_t vfs_sram_unlink(const char *name);
+vfs_size_t vfs_sram_size(struct vfs_file_handle_t *);
+
+#define VFS_SRAM_FUNCS {			\
+    "ram",					\
+    vfs_sram_open,				\
+    vfs_sram_close,				\
+    vfs_sram_read,				\
+    vfs_sram_write,				\
+    vfs_sram_fseek,				\
+    vfs_sram_truncate,				\
+    vfs_sram_create,				\
+    vfs_sram_unlink,				\
+    vfs_sram_size,				\
+  }
+
+#endif /* VFS_SRAM_H */
@@ -32,10 +32,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "config.h"
 #include "core/bool.h"
 #include "core/bit-macros.h"
+#include "core/param.h"
+#include "core/periodic.h"
 #include "protocols/artnet/artnet.h"
 #include "protocols/uip/uip.h"
 #include "protocols/uip/uip_router.h"
@@ -45,6 +48,24 @@
 
 #define BUF ((struct uip_udpip_hdr *) (uip_appdata - UIP_IPUDPH_LEN))
 
+#if CONF_ARTNET_INUNIVERSES > ARTNET_MAX_PORTS || CONF_ARTNET_OUTUNIVERSES > ARTNET_MAX_PORTS
+#error "Art-Net supports at most 4 input and 4 output universes"
+#endif
+
+/* The port addresses are the subnet and the universe in its low nibble. */
+#if CONF_ARTNET_INUNIVERSE + CONF_ARTNET_INUNIVERSES > 16 || CONF_ARTNET_OUTUNIVERSE + CONF_ARTNET_OUTUNIVERSES > 16
+#error "Art-Net universes must stay within one subnet (0 to 15)"
+#endif
+
+/* An input universe collects CONF_ARTNET_MAX_RATE credits per periodic
+ * millitick and sending a frame costs one second worth of milliticks. */
+#define FRAME_CREDIT		CONF_MTICKS_PER_SEC
+#define KEEPALIVE_TICKS		((uint32_t) CONF_ARTNET_KEEPALIVE * CONF_MTICKS_PER_SEC / 1000)
+
+#if CONF_ARTNET_KEEPALIVE * CONF_MTICKS_PER_SEC / 1000 > 0xFFFF
+#error "Art-Net keep-alive interval too long for the periodic tick rate"
+#endif
+
 /* ----------------------------------------------------------------------------
  *global variables
  */
@@ -66,10 +87,41 @@ volatile uint16_t artnet_dmxChannels = 0;
 volatile uint8_t artnet_dmxTransmitting = FALSE;
 volatile uint8_t artnet_dmxInChanged = FALSE;
 volatile uint8_t artnet_dmxInComplete = FALSE;
-int8_t artnet_conn_id = 0;
-uint8_t artnet_connected = 0;
 uint8_t artnet_dmxDirection = 0;
 
+/* state of the input universes, sent as ArtDmx */
+struct artnet_input_t
+{
+  int8_t conn_id;
+  uint8_t sequence;
+  uint8_t force;
+  uint16_t credit;
+  uint16_t lastSent;            /* periodic milliticks */
+};
+
+struct artnet_input_t artnet_inputs[CONF_ARTNET_INUNIVERSES];
+uint16_t artnet_lastTicks;
+
+/* nodes which announced an output port for one of our input universes */
+struct artnet_subscriber_t
+{
+  uip_ipaddr_t ipaddr;
+  uint8_t universes;            /* bit n is input universe n */
+  uint8_t timeout;              /* seconds left, 0 if unused */
+};
+
+struct artnet_subscriber_t artnet_subscribers[CONF_ARTNET_SUBSCRIBERS];
+
+#ifdef CONF_ARTNET_SYNC
+/* ArtDmx for the output universes is held back until the next ArtSync
+ * while the controller keeps sending ArtSync */
+uip_ipaddr_t artnet_syncSource;
+uint8_t artnet_syncTimeout = 0;
+uint8_t artnet_syncPending = 0;
+uint16_t artnet_syncLength[CONF_ARTNET_OUTUNIVERSES];
+uint8_t artnet_syncData[CONF_ARTNET_OUTUNIVERSES][DMX_STORAGE_CHANNELS];
+#endif
+
 const char artnet_ID[8] PROGMEM = "Art-Net";
 
 /* ----------------------------------------------------------------------------
@@ -109,17 +161,18 @@ artnet_init(void)
   set_CONF_ARTNET_OUTPUT_IP(&artnet_outputTarget);
 
   /* dmx storage connection */
-  artnet_conn_id = dmx_storage_connect(artnet_inputUniverse);
-  if (artnet_conn_id != -1)
+  for (uint8_t i = 0; i < CONF_ARTNET_INUNIVERSES; i++)
   {
-    artnet_connected = TRUE;
-    ARTNET_DEBUG("Connection to dmx-storage established! id:%d\r\n",
-                 artnet_conn_id);
-  }
-  else
-  {
-    artnet_connected = FALSE;
-    ARTNET_DEBUG("Connection to dmx-storage couldn't be established!\r\n");
+    artnet_inputs[i].conn_id =
+      dmx_storage_connect(artnet_inputUniverse + i);
+    artnet_inputs[i].sequence = 1;
+    artnet_inputs[i].force = TRUE;
+    artnet_inputs[i].credit = FRAME_CREDIT;
+    if (artnet_inputs[i].conn_id != -1)
+      ARTNET_DEBUG("Connection to dmx-storage established! id:%d\r\n",
+                   artnet_inputs[i].conn_id);
+    else
+      ARTNET_DEBUG("Connection to dmx-storage couldn't be established!\r\n");
   }
 
   /* net_init */
@@ -186,24 +239,31 @@ artnet_sendPollReply(const uip_ipaddr_t *dest)
           (unsigned int) artnet_pollReplyCounter);
 
   msg->numPortsH = 0;
-  msg->numPorts = 1;
+  msg->numPorts = MAX(CONF_ARTNET_INUNIVERSES, CONF_ARTNET_OUTUNIVERSES);
 
-  if (artnet_dmxDirection == 1)
-    msg->portTypes[0] = PORT_TYPE_DMX_INPUT;
-  else
-    msg->portTypes[0] = PORT_TYPE_DMX_OUTPUT;
-
-  if (artnet_dmxDirection != 1)
-    msg->goodInput[0] = (1 << 3);
-  else if (artnet_dmxChannels > 0)
-    msg->goodInput[0] |= (1 << 7);
-
-  msg->goodOutput[0] = (1 << 1);
-  if (artnet_dmxTransmitting == TRUE)
-    msg->goodOutput[0] |= (1 << 7);
-
-  msg->swin[0] = (artnet_subNet & 15) * 16 | (artnet_inputUniverse & 15);
-  msg->swout[0] = (artnet_subNet & 15) * 16 | (artnet_outputUniverse & 15);
+  for (uint8_t i = 0; i < msg->numPorts; i++)
+  {
+    if (i < CONF_ARTNET_INUNIVERSES)
+    {
+      msg->portTypes[i] |= PORT_TYPE_DMX_INPUT;
+      msg->swin[i] = (artnet_subNet & 15) * 16 |
+        ((artnet_inputUniverse + i) & 15);
+      if (artnet_dmxChannels > 0)
+        msg->goodInput[i] |= (1 << 7);
+    }
+    else
+      msg->goodInput[i] = (1 << 3);
+
+    if (i < CONF_ARTNET_OUTUNIVERSES && artnet_dmxDirection != 1)
+    {
+      msg->portTypes[i] |= PORT_TYPE_DMX_OUTPUT;
+      msg->swout[i] = (artnet_subNet & 15) * 16 |
+        ((artnet_outputUniverse + i) & 15);
+      msg->goodOutput[i] = (1 << 1);
+      if (artnet_dmxTransmitting == TRUE)
+        msg->goodOutput[i] |= (1 << 7);
+    }
+  }
   msg->style = STYLE_NODE;
 
   memcpy(msg->mac, uip_ethaddr.addr, 6);
@@ -213,12 +273,11 @@ artnet_sendPollReply(const uip_ipaddr_t *dest)
 }
 
 /* ----------------------------------------------------------------------------
- * send an ArtDmx packet
+ * send an ArtDmx packet of input universe n
  */
-void
-artnet_sendDmxPacket(void)
+static void
+artnet_sendDmxPacket(uint8_t n, uint8_t sequence, const uip_ipaddr_t *dest)
 {
-  static unsigned char sequence = 1;
   /* prepare artnet Dmx packet */
   struct artnet_dmx *msg =
     (struct artnet_dmx *) &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
@@ -231,19 +290,42 @@ artnet_sendDmxPacket(void)
   msg->versionH = 0;
   msg->version = PROTOCOL_VERSION;
 
-  msg->sequence = sequence++;
-  if (sequence == 0)
-    sequence = 1;
+  msg->sequence = sequence;
 
-  msg->physical = 1;
-  msg->universe = ((artnet_subNet << 4) | artnet_inputUniverse);
+  msg->physical = n;
+  msg->universe = ((artnet_subNet << 4) | (artnet_inputUniverse + n));
   msg->lengthHi = HI8(DMX_STORAGE_CHANNELS);
   msg->length = LO8(DMX_STORAGE_CHANNELS);
-  for (uint8_t i = 0; i < DMX_STORAGE_CHANNELS; i++)
+  for (uint16_t i = 0; i < DMX_STORAGE_CHANNELS; i++)
     msg->dataStart[i] =
-      get_dmx_channel_slot(artnet_inputUniverse, i, artnet_conn_id);
-  /* send packet to artnet_outputTarget */
-  artnet_send(&artnet_outputTarget, sizeof(struct artnet_dmx) + DMX_STORAGE_CHANNELS);
+      get_dmx_channel_slot(artnet_inputUniverse + n, i,
+                           artnet_inputs[n].conn_id);
+  artnet_send(dest, sizeof(struct artnet_dmx) + DMX_STORAGE_CHANNELS);
+}
+
+/* ----------------------------------------------------------------------------
+ * send input universe n to its subscribers or to artnet_outputTarget
+ */
+static void
+artnet_sendUniverse(uint8_t n)
+{
+  uint8_t sequence = artnet_inputs[n].sequence++;
+  if (artnet_inputs[n].sequence == 0)
+    artnet_inputs[n].sequence = 1;
+
+  uint8_t unicast = FALSE;
+  for (uint8_t i = 0; i < CONF_ARTNET_SUBSCRIBERS; i++)
+  {
+    struct artnet_subscriber_t *sub = &artnet_subscribers[i];
+    if (sub->timeout == 0 || !(sub->universes & _BV(n)))
+      continue;
+    /* the packet is built again for each target, router_output
+     * may have replaced it with an ARP request */
+    artnet_sendDmxPacket(n, sequence, &sub->ipaddr);
+    unicast = TRUE;
+  }
+  if (!unicast)
+    artnet_sendDmxPacket(n, sequence, &artnet_outputTarget);
 }
 
 int16_t
@@ -267,20 +349,137 @@ processPollPacket(struct artnet_poll *poll)
     uip_ipaddr_copy(poll_reply_target, all_ones_addr);
   artnet_sendPollReply(&poll_reply_target);
 
-  /* we send a dmx packet on a poll packet, if artnet_sendPollReplyOnChange is active */
+  /* we send the dmx data on a poll packet, if artnet_sendPollReplyOnChange is active */
   if (artnet_sendPollReplyOnChange)
-    artnet_sendDmxPacket();
+    for (uint8_t i = 0; i < CONF_ARTNET_INUNIVERSES; i++)
+      artnet_inputs[i].force = TRUE;
 }
 
+/* ----------------------------------------------------------------------------
+ * learn the input universes a node subscribes to from its ArtPollReply
+ */
+static void
+processPollReplyPacket(struct artnet_pollreply *reply)
+{
+  uint8_t universes = 0;
+
+  /* no slots, the input universes are always broadcasted */
+  if (CONF_ARTNET_SUBSCRIBERS == 0
+      || uip_ipaddr_cmp(BUF->srcipaddr, uip_hostaddr))
+    return;
+
+  if (reply->subSwitchH == 0 && (reply->subSwitch & 15) == artnet_subNet)
+  {
+    for (uint8_t i = 0; i < reply->numPorts && i < ARTNET_MAX_PORTS; i++)
+    {
+      if (!(reply->portTypes[i] & PORT_TYPE_DMX_OUTPUT))
+        continue;
+      uint8_t n = (reply->swout[i] & 15) - artnet_inputUniverse;
+      if (n < CONF_ARTNET_INUNIVERSES)
+        universes |= _BV(n);
+    }
+  }
+
+  /* refresh the known node, otherwise take a free or the oldest entry */
+  struct artnet_subscriber_t *sub = NULL;
+  for (uint8_t i = 0; i < CONF_ARTNET_SUBSCRIBERS; i++)
+  {
+    struct artnet_subscriber_t *s = &artnet_subscribers[i];
+    if (s->timeout && uip_ipaddr_cmp(&s->ipaddr, BUF->srcipaddr))
+    {
+      sub = s;
+      break;
+    }
+    if (sub == NULL || s->timeout < sub->timeout)
+      sub = s;
+  }
+
+  if (universes == 0)
+  {
+    /* not (or no longer) interested in our universes */
+    if (sub->timeout && uip_ipaddr_cmp(&sub->ipaddr, BUF->srcipaddr))
+      sub->timeout = 0;
+    return;
+  }
+
+  ARTNET_DEBUG("subscriber %d.%d.%d.%d universes %02x\r\n",
+               ((uint8_t *) BUF->srcipaddr)[0], ((uint8_t *) BUF->srcipaddr)[1],
+               ((uint8_t *) BUF->srcipaddr)[2], ((uint8_t *) BUF->srcipaddr)[3],
+               universes);
+  uip_ipaddr_copy(&sub->ipaddr, BUF->srcipaddr);
+  sub->universes = universes;
+  sub->timeout = ARTNET_SUBSCRIBER_TIMEOUT;
+}
+
+/* ----------------------------------------------------------------------------
+ * store the data of output universe n
+ */
+static void
+artnet_setOutput(uint8_t n, const uint8_t * data, uint16_t len)
+{
+  set_dmx_channels(data, artnet_outputUniverse + n, 0, len);
+}
+
+#ifdef CONF_ARTNET_SYNC
+static void
+artnet_syncOutputs(void)
+{
+  for (uint8_t n = 0; n < CONF_ARTNET_OUTUNIVERSES; n++)
+    if (artnet_syncPending & _BV(n))
+      artnet_setOutput(n, artnet_syncData[n], artnet_syncLength[n]);
+  artnet_syncPending = 0;
+}
+#endif
+
 void
 artnet_main(void)
 {
-  if (get_dmx_slot_state(artnet_inputUniverse, artnet_conn_id) ==
-      DMX_NEWVALUES && artnet_connected == TRUE)
+  uint16_t now;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
   {
-    ARTNET_DEBUG("Universe has changed, sending artnet data!\r\n");
-    artnet_sendDmxPacket();
+    now = (uint16_t) periodic_mticks_count;
   }
+  uint16_t elapsed = now - artnet_lastTicks;
+  artnet_lastTicks = now;
+
+  for (uint8_t n = 0; n < CONF_ARTNET_INUNIVERSES; n++)
+  {
+    struct artnet_input_t *in = &artnet_inputs[n];
+    if (in->conn_id == -1)
+      continue;
+
+    /* save up at most one frame while idle */
+    uint32_t credit = MIN(in->credit, FRAME_CREDIT) +
+      (uint32_t) elapsed * CONF_ARTNET_MAX_RATE;
+    in->credit = MIN(credit, 2 * FRAME_CREDIT);
+    if (in->credit < FRAME_CREDIT)
+      continue;
+
+    if (in->force ||
+        get_dmx_slot_state(artnet_inputUniverse + n, in->conn_id) ==
+        DMX_NEWVALUES || (uint16_t) (now - in->lastSent) >= KEEPALIVE_TICKS)
+    {
+      ARTNET_DEBUG("sending universe %d\r\n", artnet_inputUniverse + n);
+      in->credit -= FRAME_CREDIT;
+      in->lastSent = now;
+      in->force = FALSE;
+      artnet_sendUniverse(n);
+    }
+  }
+}
+
+void
+artnet_periodic(void)
+{
+  for (uint8_t i = 0; i < CONF_ARTNET_SUBSCRIBERS; i++)
+    if (artnet_subscribers[i].timeout)
+      artnet_subscribers[i].timeout--;
+
+#ifdef CONF_ARTNET_SYNC
+  /* the controller stopped sending ArtSync, back to immediate output */
+  if (artnet_syncTimeout && --artnet_syncTimeout == 0)
+    artnet_syncOutputs();
+#endif
 }
 
 
@@ -312,6 +511,7 @@ artnet_get(void)
       break;
     case OP_POLLREPLY:;
       ARTNET_DEBUG("Received artnet poll reply packet!\r\n");
+      processPollReplyPacket((struct artnet_pollreply *) uip_appdata);
       break;
     case OP_OUTPUT:;
       uip_ipaddr_t artnet_pollReplyTarget;
@@ -321,13 +521,24 @@ artnet_get(void)
       dmx = (struct artnet_dmx *) uip_appdata;
       uip_ipaddr_copy(&artnet_pollReplyTarget, BUF->srcipaddr);
 
-      if (dmx->universe == ((artnet_subNet << 4) | artnet_outputUniverse))
+      uint8_t n = dmx->universe - ((artnet_subNet << 4) | artnet_outputUniverse);
+      if ((dmx->universe >> 8) == 0 && n < CONF_ARTNET_OUTUNIVERSES)
       {
         if (artnet_dmxDirection == 0)
         {
           uint16_t len = ((dmx->lengthHi << 8) + dmx->length);
-          set_dmx_channels((const uint8_t *) &dmx->dataStart,
-                           artnet_outputUniverse, 0, len);
+#ifdef CONF_ARTNET_SYNC
+          uip_ipaddr_copy(&artnet_syncSource, BUF->srcipaddr);
+          if (artnet_syncTimeout)
+          {
+            len = MIN(len, DMX_STORAGE_CHANNELS);
+            memcpy(artnet_syncData[n], dmx->dataStart, len);
+            artnet_syncLength[n] = len;
+            artnet_syncPending |= _BV(n);
+          }
+          else
+#endif
+            artnet_setOutput(n, (const uint8_t *) &dmx->dataStart, len);
           if (artnet_sendPollReplyOnChange == TRUE)
           {
             artnet_pollReplyCounter++;
@@ -336,6 +547,16 @@ artnet_get(void)
         }
       }
       break;
+#ifdef CONF_ARTNET_SYNC
+    case OP_SYNC:;
+      /* only the controller sending our ArtDmx may sync */
+      if (!uip_ipaddr_cmp(&artnet_syncSource, BUF->srcipaddr))
+        break;
+      ARTNET_DEBUG("Received artnet sync packet!\r\n");
+      artnet_syncTimeout = ARTNET_SYNC_TIMEOUT;
+      artnet_syncOutputs();
+      break;
+#endif
     case OP_ADDRESS:;
     case OP_IPPROG:;
       break;
@@ -351,6 +572,7 @@ artnet_get(void)
    header(protocols/artnet/artnet.h)
    net_init(artnet_init)
    mainloop(artnet_main)
+   timer(50, artnet_periodic())
    block(Miscelleanous)
    ecmd_feature(artnet_pollreply, "artnet test",,artnet test)
  */
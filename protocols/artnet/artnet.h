@@ -56,6 +56,7 @@ extern uint16_t artnet_port;
 #define OP_POLL			0x2000
 #define OP_POLLREPLY		0x2100
 #define OP_OUTPUT		0x5000
+#define OP_SYNC			0x5200
 #define OP_ADDRESS		0x6000
 #define OP_IPPROG		0xf800
 #define OP_IPPROGREPLY		0xf900
@@ -87,6 +88,9 @@ extern uint16_t artnet_port;
 #define FIRMWARE_VERSION 	0x0100  /* DMX-Hub firmware version. */
 #define STYLE_NODE 		0       /* Responder is a Node (DMX <-> Ethernet Device) */
 
+#define ARTNET_SUBSCRIBER_TIMEOUT 10   /* seconds without ArtPollReply */
+#define ARTNET_SYNC_TIMEOUT	4       /* seconds without ArtSync */
+
 #define PORT_TYPE_DMX_OUTPUT	0x80
 #define PORT_TYPE_DMX_INPUT 	0x40
 
@@ -212,9 +216,20 @@ struct artnet_dmx
   uint8_t dataStart[];
 };
 
+struct artnet_sync
+{
+  uint8_t id[8];
+  uint16_t opcode;
+  uint8_t versionH;
+  uint8_t version;
+  uint8_t aux1;
+  uint8_t aux2;
+};
+
 void artnet_init(void);
 void artnet_sendPollReply(const uip_ipaddr_t *dest);
 void artnet_main(void);
+void artnet_periodic(void);
 void artnet_get(void);
 
 #endif /* _ARTNET_H */
@@ -231,7 +231,7 @@ bsbport_connack_cb(void)
   mqtt_construct_subscribe_packet(BSBPORT_SUBSCRIBE_QUERY_TOPIC);
 }
 
-static const char bsbport_topic[] PROGMEM = BSBPORT_MQTT_TOPIC;
+static const char bsbport_topic[] PROGMEM = BSBPORT_MQTT_TOPIC "/#";
 
 const mqtt_callback_config_t bspport_mqtt_callback_config PROGMEM = {
   .topic = bsbport_topic,
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "config.h"
+#include "core/bool.h"
+#include "core/param.h"
+#include "protocols/e131/e131.h"
+#include "services/dmx-storage/dmx_storage.h"
+
+#define BUF ((struct uip_udpip_hdr *) (uip_appdata - UIP_IPUDPH_LEN))
+
+#if CONF_E131_DMX_UNIVERSE + CONF_E131_UNIVERSES > DMX_STORAGE_UNIVERSES
+#error "sACN universes exceed the DMX storage universes"
+#endif
+
+/* Missing slots are cleared in place behind the packet data, which only
+   stays within a full sized sACN frame for up to 512 channels. */
+#if DMX_STORAGE_CHANNELS > 512
+#error "sACN needs DMX storage universes of at most 512 channels"
+#endif
+
+struct e131_source_t e131_sources[CONF_E131_SOURCES];
+struct e131_stats_t e131_stats;
+
+static const uint8_t e131_acn_id[12] PROGMEM = "ASC-E1.17\0\0";
+
+/* The last byte of a 32 bit vector, 0 if it doesn't fit in a byte. */
+static uint8_t
+e131_vector(const uint8_t * vector)
+{
+  return (vector[0] | vector[1] | vector[2]) ? 0 : vector[3];
+}
+
+/* Highest priority of the active sources of universe U, -1 if none. */
+static int16_t
+e131_top_priority(uint8_t u)
+{
+  int16_t top = -1;
+  for (uint8_t i = 0; i < CONF_E131_SOURCES; i++)
+  {
+    struct e131_source_t *s = &e131_sources[i];
+    if (s->timeout && s->universe == u && s->priority > top)
+      top = s->priority;
+  }
+  return top;
+}
+
+/* Store the HTP merge of the sources of universe U with priority TOP,
+   channel by channel as there is no packet to merge into. */
+static void
+e131_remerge(uint8_t u, uint8_t top)
+{
+  for (uint16_t c = 0; c < DMX_STORAGE_CHANNELS; c++)
+  {
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < CONF_E131_SOURCES; i++)
+    {
+      struct e131_source_t *s = &e131_sources[i];
+      if (s->timeout && s->universe == u && s->priority == top)
+        value = MAX(value, s->data[c]);
+    }
+    set_dmx_channel(CONF_E131_DMX_UNIVERSE + u, c, value);
+  }
+}
+
+/* The source stopped sending, the remaining ones take over. Without
+   any source left the last values are kept. */
+static void
+e131_drop(struct e131_source_t *s)
+{
+  E131_DEBUG("source of universe %u gone\n", CONF_E131_UNIVERSE + s->universe);
+  s->timeout = 0;
+  int16_t top = e131_top_priority(s->universe);
+  if (top >= 0 && s->priority >= top)
+    e131_remerge(s->universe, top);
+}
+
+static struct e131_source_t *
+e131_find_source(const uint8_t * cid, uint8_t u)
+{
+  struct e131_source_t *free = NULL;
+  for (uint8_t i = 0; i < CONF_E131_SOURCES; i++)
+  {
+    struct e131_source_t *s = &e131_sources[i];
+    if (s->packets && s->universe == u && memcmp(s->cid, cid, 16) == 0)
+      return s;
+    /* prefer never used entries, keep the statistics of gone sources */
+    if (s->timeout == 0 && (free == NULL || free->packets))
+      free = s;
+  }
+  if (free == NULL)
+    return NULL;
+
+  memcpy(free->cid, cid, 16);
+  free->universe = u;
+  free->packets = 0;
+  free->dropped = 0;
+  free->lost = 0;
+  memset(free->data, 0, DMX_STORAGE_CHANNELS);
+  return free;
+}
+
+/* ----------------------------------------------------------------------------
+ * receive an E1.31 packet, the data is merged in place in uip_appdata
+ */
+void
+e131_get(void)
+{
+  struct e131_packet *pkt = (struct e131_packet *) uip_appdata;
+
+  e131_stats.packets++;
+  if (uip_len < sizeof(struct e131_packet)
+      || memcmp_P(pkt->acn_id, e131_acn_id, sizeof(e131_acn_id))
+      || e131_vector(pkt->root_vector) != E131_VECTOR_ROOT_DATA
+      || e131_vector(pkt->frame_vector) != E131_VECTOR_DATA_PACKET
+      || pkt->dmp_vector != E131_VECTOR_DMP_SET)
+  {
+    E131_DEBUG("invalid packet\n");
+    e131_stats.invalid++;
+    return;
+  }
+
+  uint16_t count = ntohs(pkt->value_count);
+  if (count == 0 || sizeof(struct e131_packet) + count - 1 > uip_len)
+  {
+    e131_stats.invalid++;
+    return;
+  }
+
+  uint16_t u = ntohs(pkt->universe) - CONF_E131_UNIVERSE;
+  if (u >= CONF_E131_UNIVERSES || (pkt->options & E131_OPT_PREVIEW))
+    return;
+
+  struct e131_source_t *s = e131_find_source(pkt->cid, u);
+  if (s == NULL)
+  {
+    e131_stats.full++;
+    return;
+  }
+
+  /* sequence numbers within 20 behind the last one are late duplicates */
+  if (s->timeout)
+  {
+    int8_t diff = pkt->sequence - s->sequence;
+    if (diff <= 0 && diff > -20)
+    {
+      s->dropped++;
+      return;
+    }
+    if (diff > 1)
+      s->lost += diff - 1;
+  }
+  s->sequence = pkt->sequence;
+  s->packets++;
+  uip_ipaddr_copy(&s->ipaddr, BUF->srcipaddr);
+
+  if (pkt->options & E131_OPT_TERMINATED)
+  {
+    if (s->timeout)
+      e131_drop(s);
+    return;
+  }
+
+  uint8_t was_top = s->timeout && s->priority >= e131_top_priority(u);
+  s->priority = MIN(pkt->priority, 200);
+  s->timeout = E131_TIMEOUT;
+  if (pkt->start_code != 0)
+    return;                     /* no DMX data */
+
+  uint16_t len = MIN(count - 1, DMX_STORAGE_CHANNELS);
+  memcpy(s->data, pkt->data, len);
+  memset(s->data + len, 0, DMX_STORAGE_CHANNELS - len);
+
+  int16_t top = e131_top_priority(u);
+  if (s->priority < top)
+  {
+    /* lowered its priority below other sources */
+    if (was_top)
+      e131_remerge(u, top);
+    return;
+  }
+
+  /* slots missing in the packet are 0, the buffer is large enough for
+     a full universe */
+  memset(pkt->data + len, 0, DMX_STORAGE_CHANNELS - len);
+
+  /* HTP merge of the other sources with the same priority */
+  for (uint8_t i = 0; i < CONF_E131_SOURCES; i++)
+  {
+    struct e131_source_t *o = &e131_sources[i];
+    if (o == s || !o->timeout || o->universe != u || o->priority != top)
+      continue;
+    for (uint16_t c = 0; c < DMX_STORAGE_CHANNELS; c++)
+      if (o->data[c] > pkt->data[c])
+        pkt->data[c] = o->data[c];
+  }
+
+  set_dmx_channels(pkt->data, CONF_E131_DMX_UNIVERSE + u, 0,
+                   DMX_STORAGE_CHANNELS);
+}
+
+void
+e131_periodic(void)
+{
+  for (uint8_t i = 0; i < CONF_E131_SOURCES; i++)
+  {
+    struct e131_source_t *s = &e131_sources[i];
+    if (s->timeout && --s->timeout == 0)
+      e131_drop(s);
+  }
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/e131/e131.h)
+  timer(5, e131_periodic())
+*/
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef _E131_H
+#define _E131_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+
+#ifdef DEBUG_E131
+#include "core/debug.h"
+#define E131_DEBUG(str...) debug_printf ("e131: " str)
+#else
+#define E131_DEBUG(...)    ((void) 0)
+#endif
+
+#define E131_PORT		5568
+
+#define E131_VECTOR_ROOT_DATA	0x04
+#define E131_VECTOR_DATA_PACKET	0x02
+#define E131_VECTOR_DMP_SET	0x02
+
+#define E131_OPT_PREVIEW	0x80
+#define E131_OPT_TERMINATED	0x40
+
+#define E131_TIMEOUT		25      /* 2.5 seconds in periodic calls */
+
+/* An E1.31 data packet, multi-byte fields are in network byte order. */
+struct __attribute__ ((__packed__)) e131_packet
+{
+  /* root layer */
+  uint16_t preamble_size;
+  uint16_t postamble_size;
+  uint8_t acn_id[12];
+  uint16_t root_flength;
+  uint8_t root_vector[4];
+  uint8_t cid[16];
+  /* framing layer */
+  uint16_t frame_flength;
+  uint8_t frame_vector[4];
+  char source_name[64];
+  uint8_t priority;
+  uint16_t sync_address;
+  uint8_t sequence;
+  uint8_t options;
+  uint16_t universe;
+  /* DMP layer */
+  uint16_t dmp_flength;
+  uint8_t dmp_vector;
+  uint8_t address_type;
+  uint16_t first_address;
+  uint16_t address_increment;
+  uint16_t value_count;         /* start code and slots */
+  uint8_t start_code;
+  uint8_t data[];
+};
+
+/* A sender of one of our universes. */
+struct e131_source_t
+{
+  uint8_t cid[16];
+  uip_ipaddr_t ipaddr;
+  uint8_t universe;             /* index of the configured universes */
+  uint8_t priority;
+  uint8_t sequence;
+  uint8_t timeout;              /* periodic calls left, 0 if unused */
+  uint32_t packets;
+  uint16_t dropped;             /* duplicate or out of order */
+  uint16_t lost;                /* gaps in the sequence */
+  uint8_t data[DMX_STORAGE_CHANNELS];
+};
+
+struct e131_stats_t
+{
+  uint32_t packets;
+  uint32_t invalid;
+  uint32_t full;                /* no free source entry */
+};
+
+extern struct e131_source_t e131_sources[CONF_E131_SOURCES];
+extern struct e131_stats_t e131_stats;
+
+void e131_get(void);
+void e131_periodic(void);
+
+#endif /* _E131_H */
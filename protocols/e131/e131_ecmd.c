@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "protocols/e131/e131.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* Short lines, so that even the largest counters fit the ecmd output
+   buffer. */
+/* Short lines, so that even the largest counters fit the ecmd output
+   buffer. */
+typedef struct
+{
+  uint8_t magic;
+  uint8_t source;
+  uint8_t part;                 /* 0: totals, 1: address, 2: counters */
+} e131_stats_state_t;
+
+int16_t
+parse_cmd_e131_stats(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  e131_stats_state_t *state = (e131_stats_state_t *) cmd;
+  if (state->magic != ECMD_STATE_MAGIC)
+  {
+    state->magic = ECMD_STATE_MAGIC;
+    state->source = 0;
+    state->part = 0;
+    return ECMD_AGAIN(snprintf_P(output, len, PSTR("packets %lu"),
+                                 e131_stats.packets));
+  }
+  if (state->part == 0)
+  {
+    state->part = 1;
+    return ECMD_AGAIN(snprintf_P(output, len, PSTR("invalid %lu full %lu"),
+                                 e131_stats.invalid, e131_stats.full));
+  }
+
+  if (state->part == 1)
+  {
+    while (state->source < CONF_E131_SOURCES &&
+           e131_sources[state->source].packets == 0)
+      state->source++;
+    if (state->source >= CONF_E131_SOURCES)
+      return ECMD_FINAL_OK;
+
+    struct e131_source_t *s = &e131_sources[state->source];
+    const uint8_t *ip = (const uint8_t *) &s->ipaddr;
+    state->part = 2;
+    return ECMD_AGAIN(snprintf_P(output, len,
+                                 PSTR("%u.%u.%u.%u universe %u prio %u"),
+                                 ip[0], ip[1], ip[2], ip[3],
+                                 CONF_E131_UNIVERSE + s->universe,
+                                 s->priority));
+  }
+
+  struct e131_source_t *s = &e131_sources[state->source++];
+  state->part = 1;
+  return ECMD_AGAIN(snprintf_P(output, len,
+                               PSTR("  pkts %lu drop %u lost %u %S"),
+                               s->packets, s->dropped, s->lost,
+                               s->timeout ? PSTR("active") : PSTR("gone")));
+}
+
+/*
+  -- Ethersex META --
+  block([[sACN_E1.31]])
+  ecmd_feature(e131_stats, "e131 stats",, Show the received packets and the statistics of each sACN source.)
+*/
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
+#include "protocols/e131/e131.h"
+#include "protocols/e131/e131_net.h"
+
+#define E131_IGMP_INTERVAL	60      /* seconds between membership reports */
+
+static uint8_t e131_net_countdown;
+
+/* The multicast group of universe U is 239.255.U_hi.U_lo */
+uint8_t
+e131_net_member(const void *ipaddr)
+{
+  const uint8_t *ip = ipaddr;
+  uint16_t u = ((ip[2] << 8) | ip[3]) - CONF_E131_UNIVERSE;
+  return ip[0] == 239 && ip[1] == 255 && u < CONF_E131_UNIVERSES;
+}
+
+/* Report our groups, switches with IGMP snooping forward only the
+   groups somebody joined. */
+static void
+e131_net_join(void)
+{
+  for (uint8_t i = 0; i < CONF_E131_UNIVERSES; i++)
+  {
+    uint16_t u = CONF_E131_UNIVERSE + i;
+    uip_ipaddr_t group;
+    uip_ipaddr(&group, 239, 255, u >> 8, u & 0xff);
+    uip_igmp_report(&group);
+    router_output();
+  }
+  uip_len = 0;
+}
+
+void
+e131_net_init(void)
+{
+  uip_udp_conn_t *conn;
+  uip_ipaddr_t ip;
+  uip_ipaddr_copy(&ip, all_ones_addr);
+  if (!(conn = uip_udp_new(&ip, 0, e131_net_main)))
+    return;                     /* Couldn't bind socket */
+
+  uip_udp_bind(conn, HTONS(E131_PORT));
+  e131_net_join();
+  e131_net_countdown = E131_IGMP_INTERVAL;
+}
+
+void
+e131_net_main(void)
+{
+  if (!uip_newdata())
+    return;
+
+  e131_get();
+}
+
+void
+e131_net_periodic(void)
+{
+  if (--e131_net_countdown)
+    return;
+
+  e131_net_countdown = E131_IGMP_INTERVAL;
+  e131_net_join();
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/e131/e131_net.h)
+  net_init(e131_net_init)
+  timer(50, e131_net_periodic())
+*/
@@ -47,6 +47,28 @@
 #define xstr(s) str(s)
 #define str(s) #s
 
+/* Turn the parse error and "no output" results of a handler into text. */
+static int16_t
+ecmd_result(int16_t ret, char *output)
+{
+  if (output != NULL)
+  {
+    if (ret == -1)
+    {
+      memcpy_P(output, PSTR("parse error"), 11);
+      ret = 11;
+    }
+    else if (ret == 0)
+    {
+      output[0] = 'O';
+      output[1] = 'K';
+      ret = 2;
+    }
+  }
+
+  return ret;
+}
+
 int16_t
 ecmd_parse_command(char *cmd, char *output, uint16_t len)
 {
@@ -152,22 +174,24 @@ ecmd_parse_command(char *cmd, char *output, uint16_t len)
   if (func != NULL)
     ret = func(cmd, output, len);
 
-  if (output != NULL)
-  {
-    if (ret == -1)
-    {
-      memcpy_P(output, PSTR("parse error"), 11);
-      ret = 11;
-    }
-    else if (ret == 0)
-    {
-      output[0] = 'O';
-      output[1] = 'K';
-      ret = 2;
-    }
-  }
+  return ecmd_result(ret, output);
+}
 
-  return ret;
+int16_t
+ecmd_call_P(ecmd_handler_t func, PGM_P args, char *output, uint16_t len)
+{
+  /* the handlers modify their arguments and keep their state in them */
+  char cmd[ECMD_INPUTBUF_LENGTH];
+  strncpy_P(cmd, args, sizeof(cmd) - 1);
+  cmd[sizeof(cmd) - 1] = 0;
+
+#ifdef DEBUG_ECMD
+  debug_printf("called ecmd_call_P %s\n", cmd);
+#endif
+
+  ACTIVITY_LED_ECMD;
+
+  return ecmd_result(func(cmd, output, len), output);
 }
 
 #ifdef FREE_SUPPORT
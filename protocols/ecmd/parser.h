@@ -30,6 +30,14 @@
  *        output bytes: ECMD_AGAIN(ret) */
 int16_t ecmd_parse_command(char *cmd, char *output, uint16_t len);
 
+typedef int16_t (*ecmd_handler_t)(char *, char *, uint16_t);
+
+/* Call the handler FUNC of a command known at build time with ARGS (in
+ * program space, without the command name), skipping the lookup in
+ * ecmd_cmds.  Returns what ecmd_parse_command would return. */
+int16_t ecmd_call_P(ecmd_handler_t func, PGM_P args, char *output,
+                    uint16_t len);
+
 /* struct for storing commands */
 struct ecmd_command_t {
     PGM_P name;
@@ -68,10 +68,18 @@ typedef struct
   struct vfs_file_handle_t *handle;
   uint16_t linenumber;
   vfs_size_t filepointer;
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  uint16_t lines;               /* number of lines in script_index */
+#endif
 } script_t;
 
 script_t current_script;
 
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+/* start of every line, script_index[lines] is the end of the last one */
+static uint16_t script_index[ECMD_SCRIPT_MAXLINES + 1];
+#endif
+
 static int16_t
 to_many_vars_error_message(char *output, uint16_t len)
 {
@@ -99,10 +107,70 @@ vfs_fgets(struct vfs_file_handle_t *handle, char *line, vfs_size_t pos)
   return i;                     // size until linebreak
 }
 
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+// find the start of every line in one pass, so reading a line is a
+// single read and goto needs no search
+static void
+script_build_index(vfs_size_t filesize)
+{
+  char buf[ECMD_INPUTBUF_LENGTH];
+  vfs_size_t pos = 0;
+
+  current_script.lines = 0;
+  if (filesize > UINT16_MAX)
+    return;                     // lines are searched instead
+
+  script_index[0] = 0;
+  vfs_fseek(current_script.handle, 0, SEEK_SET);
+  while (pos < filesize && current_script.lines < ECMD_SCRIPT_MAXLINES)
+  {
+    vfs_size_t n = vfs_read(current_script.handle, buf, sizeof(buf));
+    if (n == 0)
+      break;
+    for (vfs_size_t i = 0;
+         i < n && current_script.lines < ECMD_SCRIPT_MAXLINES; i++)
+      if (buf[i] == 0x0a)
+        script_index[++current_script.lines] = pos + i + 1;
+    pos += n;
+  }
+
+  // last line without line break
+  if (pos > filesize)
+    pos = filesize;
+  if (current_script.lines < ECMD_SCRIPT_MAXLINES &&
+      script_index[current_script.lines] < pos)
+    script_index[++current_script.lines] = pos;
+
+  SCRIPTDEBUG("index: %u lines\n", current_script.lines);
+}
+#endif
+
 // read a line from script
 static uint8_t
 readline(char *buf)
 {
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  if (current_script.linenumber < current_script.lines)
+  {
+    uint16_t start = script_index[current_script.linenumber];
+    uint16_t end = script_index[current_script.linenumber + 1];
+    vfs_size_t len = end - start;
+    if (len > ECMD_INPUTBUF_LENGTH - 1)
+      len = ECMD_INPUTBUF_LENGTH - 1;
+
+    vfs_fseek(current_script.handle, start, SEEK_SET);
+    len = vfs_read(current_script.handle, buf, len);
+    if (len > 0 && buf[len - 1] == 0x0a)
+      len--;
+    buf[len] = 0;
+    SCRIPTDEBUG("readline: %s\n", buf);
+
+    current_script.filepointer = end;
+    current_script.linenumber++;
+    return (uint8_t) len;
+  }
+#endif
+
   vfs_size_t len =
     vfs_fgets(current_script.handle, buf, current_script.filepointer);
   SCRIPTDEBUG("readline: %s\n", buf);
@@ -130,6 +198,15 @@ parse_cmd_goto(char *cmd, char *output, uint16_t len)
   SCRIPTDEBUG("current %u goto line %u\n", current_script.linenumber,
               gotoline);
 
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  if (gotoline <= current_script.lines)
+  {
+    current_script.linenumber = gotoline;
+    current_script.filepointer = script_index[gotoline];
+    return ECMD_FINAL_OK;
+  }
+#endif
+
   if (gotoline < current_script.linenumber)
   {
     SCRIPTDEBUG("seek to 0\n");
@@ -162,6 +239,9 @@ parse_cmd_exit(char *cmd, char *output, uint16_t len)
   current_script.handle = NULL;
   current_script.linenumber = 0;
   current_script.filepointer = 0;
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  current_script.lines = 0;
+#endif
   return ECMD_FINAL_OK;
 }
 
@@ -188,6 +268,9 @@ parse_cmd_call(char *cmd, char *output, uint16_t len)
   SCRIPTDEBUG("start %s from %i bytes\n", filename, filesize);
   current_script.linenumber = 0;
   current_script.filepointer = 0;
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  script_build_index(filesize);
+#endif
 
   // open file as long it is open, we have not reached max lines and 
   // not the end of the file as we know it
@@ -235,6 +318,9 @@ parse_cmd_cat(char *cmd, char *output, uint16_t len)
   SCRIPTDEBUG("cat %s from %i bytes\n", filename, filesize);
   current_script.linenumber = 0;
   current_script.filepointer = 0;
+#ifdef ECMD_SCRIPT_INDEX_SUPPORT
+  script_build_index(filesize);
+#endif
 
   // open file as long it is open, we have not reached max lines and 
   // not the end of the file as we know it
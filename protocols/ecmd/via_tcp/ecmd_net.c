@@ -37,6 +37,7 @@
 
 /* module local prototypes */
 void newdata(void);
+static void parse(struct ecmd_connection_state_t *state, uint8_t skip);
 
 void ecmd_net_init()
 {
@@ -44,6 +45,57 @@ void ecmd_net_init()
     uip_listen(HTONS(ECMD_TCP_PORT), ecmd_net_main);
 }
 
+/* Call the parser and append its output to state->outbuf.  The
+ * following lines of a multi-line answer go into the same segment as
+ * long as there is room for another full line. */
+static void parse(struct ecmd_connection_state_t *state, uint8_t skip)
+{
+    /* The previous answer is not acked yet, keep the command and parse
+     * it from uip_acked().  uIP retransmits the old segment only, and
+     * uip_acked() drops the whole buffer, so nothing may be appended. */
+    if (state->out_len) {
+        state->parse_again = 1;
+        return;
+    }
+
+    do {
+        char *out = state->outbuf + state->out_len;
+
+        /* parse command and write output to out, reserving at least
+         * one byte for the terminating \n */
+        int l = ecmd_parse_command(state->inbuf + skip, out,
+                                   ECMD_OUTPUTBUF_LENGTH-1);
+
+#ifdef DEBUG_ECMD_NET
+        debug_printf("parser returned %d\n", l);
+#endif
+
+        /* check if the parse has to be called again */
+        if (is_ECMD_AGAIN(l)) {
+#ifdef DEBUG_ECMD_NET
+            debug_printf("parser needs to be called again\n");
+#endif
+            state->parse_again = 1;
+            l = ECMD_AGAIN(l);
+        } else
+            state->parse_again = 0;
+
+        if (l > 0) {
+            if (out[l] != ECMD_NO_NEWLINE) out[l++] = '\n';
+            state->out_len += l;
+        }
+    } while (state->parse_again &&
+             ECMD_NET_OUTBUF_LENGTH - state->out_len >= ECMD_OUTPUTBUF_LENGTH);
+
+    if (!state->parse_again) {
+#ifdef DEBUG_ECMD_NET
+        debug_printf("clearing buffer\n");
+#endif
+        memset(state->inbuf, 0, ECMD_INPUTBUF_LENGTH);
+        state->in_len = 0;
+    }
+}
+
 void newdata(void)
 {
     struct ecmd_connection_state_t *state = &uip_conn->appstate.ecmd;
@@ -144,42 +196,7 @@ auth_required:
           return; /* Pam Subsystem promisses to change this state */
 #endif
 
-        /* parse command and write output to state->outbuf, reserving at least
-         * one byte for the terminating \n */
-        l = ecmd_parse_command(state->inbuf + skip,
-                                    state->outbuf,
-                                    ECMD_OUTPUTBUF_LENGTH-1);
-
-#ifdef DEBUG_ECMD_NET
-        debug_printf("parser returned %d\n", l);
-#endif
-
-        /* check if the parse has to be called again */
-        if (is_ECMD_AGAIN(l)) {
-#ifdef DEBUG_ECMD_NET
-            debug_printf("parser needs to be called again\n");
-#endif
-
-            state->parse_again = 1;
-            l = ECMD_AGAIN(l);
-        }
-
-#ifdef DEBUG_ECMD_NET
-        debug_printf("parser really returned %d\n", l);
-#endif
-
-        if (l > 0) {
-            if (state->outbuf[l] != ECMD_NO_NEWLINE) state->outbuf[l++] = '\n';
-            state->out_len = l;
-        }
-
-        if (!state->parse_again) {
-#ifdef DEBUG_ECMD_NET
-            debug_printf("clearing buffer\n");
-#endif
-            memset(state->inbuf, 0, ECMD_INPUTBUF_LENGTH);
-            state->in_len = 0;
-        }
+        parse(state, skip);
     }
 }
 
@@ -205,6 +222,10 @@ void ecmd_net_main(void)
         state->pam_state = PAM_UNKOWN;
 #endif
         memset(state->inbuf, 0, ECMD_INPUTBUF_LENGTH);
+#ifdef UIP_TCP_DELACK_SUPPORT
+        /* the ACK of a command rides on its answer */
+        uip_delack_set(UIP_DELACK_TICKS);
+#endif
     }
 
 #ifdef ECMD_PAM_SUPPORT
@@ -237,26 +258,7 @@ void ecmd_net_main(void)
               state->close_requested = 1;
             }
 
-            /* parse command and write output to state->outbuf, reserving at least
-             * one byte for the terminating \n */
-            int l = ecmd_parse_command(state->inbuf + skip,
-                    state->outbuf,
-                    ECMD_OUTPUTBUF_LENGTH-1);
-
-            /* check if the parse has to be called again */
-            if (is_ECMD_AGAIN(l)) {
-                state->parse_again = 1;
-                l = ECMD_AGAIN(l);
-            } else {
-                state->parse_again = 0;
-                /* We have to clear the input buffer */
-                state->in_len = 0;
-            }
-
-            if (l > 0) {
-                state->outbuf[l++] = '\n';
-                state->out_len = l;
-            }
+            parse(state, skip);
         }
     }
 
@@ -25,10 +25,18 @@
 #define ECMD_INPUTBUF_LENGTH  50
 #define ECMD_OUTPUTBUF_LENGTH 50
 
+/* The lines of a multi-line answer are collected into one segment as
+   long as another full line fits. */
+#ifdef CONF_ECMD_TCP_OUTBUF
+#define ECMD_NET_OUTBUF_LENGTH CONF_ECMD_TCP_OUTBUF
+#else
+#define ECMD_NET_OUTBUF_LENGTH ECMD_OUTPUTBUF_LENGTH
+#endif
+
 struct ecmd_connection_state_t {
     char inbuf[ECMD_INPUTBUF_LENGTH];
     uint8_t in_len;
-    char outbuf[ECMD_OUTPUTBUF_LENGTH];
+    char outbuf[ECMD_NET_OUTBUF_LENGTH];
     uint8_t out_len;
     uint8_t parse_again;
 #ifdef ECMD_PAM_SUPPORT
@@ -28,6 +28,7 @@
 #include "ecmd_usart.h"
 #include "protocols/ecmd/parser.h"
 #include "protocols/ecmd/ecmd-base.h"
+#include "core/prof.h"
 
 #define USE_USART ECMD_SERIAL_USART_USE_USART
 #define BAUD ECMD_SERIAL_BAUDRATE
@@ -99,7 +100,8 @@ ecmd_serial_usart_periodic(void)
   }
 }
 
-ISR(usart(USART,_RX_vect))
+static inline void
+ecmd_serial_usart_rx(void)
 {
   /* Ignore errors */
   if ((usart(UCSR,A) & _BV(usart(DOR))) || (usart(UCSR,A) & _BV(usart(FE)))) {
@@ -130,8 +132,17 @@ ISR(usart(USART,_RX_vect))
   recv_buffer[recv_len++] = data;
 }
 
+ISR(usart(USART,_RX_vect))
+{
+  PROF_ISR_BEGIN();
+  ecmd_serial_usart_rx();
+  PROF_ISR_END(PROF_ISR_ECMD_USART);
+}
+
 ISR(usart(USART,_TX_vect))
 {
+  PROF_ISR_BEGIN();
+
   if (sent < write_len) {
     while (!(usart(UCSR,A) & _BV(usart(UDRE))));
     usart(UDR) = write_buffer[sent++];
@@ -143,6 +154,8 @@ ISR(usart(USART,_TX_vect))
 
     RS485_DISABLE_TX;
   }
+
+  PROF_ISR_END(PROF_ISR_ECMD_USART);
 }
 
 /*
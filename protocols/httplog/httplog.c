@@ -36,8 +36,10 @@
 #ifdef DEBUG_HTTPLOG
 #include "core/debug.h"
 #endif
+#include "core/periodic.h"
 #include "core/queue/queue.h"
 #include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
 #include "protocols/uip/parse.h"
 #include "protocols/dns/resolv.h"
 #ifdef CONF_HTTPLOG_INCLUDE_TIMESTAMP
@@ -52,8 +54,34 @@
 #endif
 
 
+/* The messages are sent as pipelined GET requests over a keep-alive
+ * connection.  A message waits up to CONF_HTTPLOG_WINDOW ms for others to
+ * share its segment, the connection is closed after CONF_HTTPLOG_KEEPALIVE
+ * seconds without messages.  Failed connections are retried with a
+ * doubling interval up to CONF_HTTPLOG_BACKOFF_MAX seconds, meanwhile the
+ * messages stay in the queue. */
+
+#define HTTPLOG_WINDOW     ((uint32_t) CONF_HTTPLOG_WINDOW * HZ / 1000)
+#define HTTPLOG_KEEPALIVE  ((uint16_t) CONF_HTTPLOG_KEEPALIVE * HZ)
+
+#define HTTPLOG_CLOSED     0
+#define HTTPLOG_CONNECTING 1
+#define HTTPLOG_CONNECTED  2
+
 static Queue httplog_queue = {.limit = HTTPLOG_QUEUE_LEN };
-static uint8_t httplog_request_pending;
+static uip_conn_t *httplog_conn;
+static uint8_t httplog_state;
+static uint8_t httplog_inflight;        /* messages in the unacked segment */
+static uint16_t httplog_window;         /* ticks until the batch is sent */
+static uint32_t httplog_retry;          /* ticks until the next connect */
+static uint16_t httplog_backoff = 1;    /* seconds */
+static uint16_t httplog_idle;           /* ticks without messages */
+
+#ifdef CONF_HTTPLOG_INCLUDE_TIMESTAMP
+#define HTTPLOG_TIME_LEN 16     /* "time=4294967295&" */
+#else
+#define HTTPLOG_TIME_LEN 0
+#endif
 
 /* first string is the GET part including the path */
 static const char PROGMEM get_string_head[] = "GET " CONF_HTTPLOG_PATH "?";
@@ -63,8 +91,70 @@ static const char PROGMEM uuid_string[] = "uuid=" CONF_HTTPLOG_UUID "&";
 #endif
 /* and the http footer including the http protocol version and the server name */
 static const char PROGMEM get_string_foot[] =
-  " HTTP/1.1\n" "Host: " CONF_HTTPLOG_SERVICE "\r\n\r\n";
+  " HTTP/1.1\r\n" "Host: " CONF_HTTPLOG_SERVICE "\r\n\r\n";
+
+
+/* Write the request of DATA to P, returns its full length. */
+static size_t
+httplog_request(char *p, size_t avail, const char *data)
+{
+  char *start = p;
+#define BUFFER_AVAIL (avail > (size_t) (p - start) ? avail - (p - start) : 0)
+  p += snprintf_P(p, BUFFER_AVAIL, get_string_head);
+#ifdef CONF_HTTPLOG_INCLUDE_UUID
+  p += snprintf_P(p, BUFFER_AVAIL, uuid_string);
+#endif
+  p += snprintf_P(p, BUFFER_AVAIL, PSTR("%s%S"), data, get_string_foot);
+#undef BUFFER_AVAIL
+  return p - start;
+}
 
+/* Send the requests of the oldest messages, as many as fit into one
+ * segment but at most MAX.  A retransmission passes the number sent
+ * before, as the queue is only popped on ACK that are the same bytes. */
+static uint8_t
+httplog_send(uint8_t max)
+{
+  char *p = uip_sappdata;
+  size_t avail = uip_mss();
+  uint8_t n = 0;
+
+  for (Node * node = httplog_queue.end; node != NULL && n < max;
+       node = node->next)
+  {
+    size_t len = httplog_request(p, avail, node->data);
+    if (len >= avail)
+    {
+      if (n > 0)
+        break;
+      HTTPLOG_DEBUG("Message truncated!\n");
+      len = avail - 1;
+    }
+    p += len;
+    avail -= len;
+    n++;
+  }
+
+  uip_send(uip_sappdata, p - (char *) uip_sappdata);
+  HTTPLOG_DEBUG("Sending %u messages, %d bytes.\n", n,
+                p - (char *) uip_sappdata);
+  return n;
+}
+
+/* Close the connection and connect again after the backoff interval. */
+static void
+httplog_failed(void)
+{
+  httplog_state = HTTPLOG_CLOSED;
+  httplog_conn = NULL;
+  httplog_inflight = 0;
+  httplog_retry = (uint32_t) httplog_backoff * HZ;
+  HTTPLOG_DEBUG("Retry in %u s.\n", httplog_backoff);
+  if (httplog_backoff > CONF_HTTPLOG_BACKOFF_MAX / 2)
+    httplog_backoff = CONF_HTTPLOG_BACKOFF_MAX;
+  else
+    httplog_backoff *= 2;
+}
 
 static void
 httplog_net_main(void)
@@ -75,45 +165,55 @@ httplog_net_main(void)
   {
     HTTPLOG_DEBUG("Connection %S.\n", uip_closed() ?
                   PSTR("closed") : PSTR("aborted"));
-    httplog_request_pending = 0;
+    if (httplog_inflight || !uip_closed())
+      httplog_failed();         /* unacked messages are sent again */
+    else
+    {
+      httplog_state = HTTPLOG_CLOSED;
+      httplog_conn = NULL;
+    }
     return;
   }
 
-  else if (uip_connected() || uip_rexmit())
+  if (uip_connected())
   {
-    HTTPLOG_DEBUG("%S.\n", uip_connected()?
-                  PSTR("Connected") : PSTR("Rexmit"));
+    HTTPLOG_DEBUG("Connected.\n");
+    httplog_state = HTTPLOG_CONNECTED;
+    httplog_backoff = 1;
+    httplog_idle = 0;
+  }
 
-    char *data = queue_peek(&httplog_queue);
-    if (data == NULL)
-    {
-      HTTPLOG_DEBUG("Queue is empty!\n");
-      uip_close();
-    }
-    else
+  if (uip_acked())
+  {
+    HTTPLOG_DEBUG("Acked.\n");
+    while (httplog_inflight)
     {
-#define BUFFER_AVAIL (size_t)(UIP_APPDATA_SIZE-(p-(char*)uip_appdata))
-      char *p = uip_appdata;
-      p += snprintf_P(p, BUFFER_AVAIL, get_string_head);
-#ifdef CONF_HTTPLOG_INCLUDE_UUID
-      p += snprintf_P(p, BUFFER_AVAIL, uuid_string);
-#endif
-#ifdef CONF_HTTPLOG_INCLUDE_TIMESTAMP
-      p += snprintf_P(p, BUFFER_AVAIL, PSTR("time=%lu&"), clock_get_time());
-#endif
-      p += snprintf_P(p, BUFFER_AVAIL, PSTR("%s%S"), data, get_string_foot);
-      if (BUFFER_AVAIL <= 0)
-        HTTPLOG_DEBUG("Message truncated!\n");
-      uip_udp_send(p - (char *) uip_appdata);
-      HTTPLOG_DEBUG("Sending %d bytes.\n", p - (char *) uip_appdata);
+      free(queue_pop(&httplog_queue));  /* delete data only when acked */
+      httplog_inflight--;
     }
   }
 
-  else if (uip_acked())
+  if (uip_rexmit())
   {
-    HTTPLOG_DEBUG("Acked.\n");
+    HTTPLOG_DEBUG("Rexmit.\n");
+    httplog_send(httplog_inflight);
+    return;
+  }
+
+  /* the responses are not evaluated */
+
+  if (httplog_inflight)
+    return;
+
+  if (!queue_is_empty(&httplog_queue) && httplog_window == 0)
+  {
+    httplog_inflight = httplog_send(UINT8_MAX);
+    httplog_idle = 0;
+  }
+  else if (queue_is_empty(&httplog_queue) && httplog_idle >= HTTPLOG_KEEPALIVE)
+  {
+    HTTPLOG_DEBUG("Closing idle connection.\n");
     uip_close();
-    free(queue_pop(&httplog_queue));    /* delete data only when acked */
   }
 }
 
@@ -127,7 +227,7 @@ httplog_connect(char *hostname, uip_ipaddr_t * ipaddr)
     print_ipaddr(ipaddr, buf, sizeof(buf));
     HTTPLOG_DEBUG("Connecting to %s (%s).\n", hostname, buf);
 #endif
-    if (uip_connect(ipaddr, HTONS(80), httplog_net_main) != NULL)
+    if ((httplog_conn = uip_connect(ipaddr, HTONS(80), httplog_net_main)))
       return;
     else
       HTTPLOG_DEBUG("Connect failed.\n");
@@ -135,13 +235,13 @@ httplog_connect(char *hostname, uip_ipaddr_t * ipaddr)
   else
     HTTPLOG_DEBUG("Resolve failed!\n");
 
-  httplog_request_pending = 0;  /* retried later via httplog_flush */
+  httplog_failed();
 }
 
 static void
 httplog_transmit(void)
 {
-  httplog_request_pending = 1;
+  httplog_state = HTTPLOG_CONNECTING;
 
   uip_ipaddr_t *ipaddr;
   if ((ipaddr = resolv_lookup(CONF_HTTPLOG_SERVICE)) == NULL)
@@ -155,12 +255,34 @@ httplog_transmit(void)
   }
 }
 
+/* Allocate a message of LEN characters, returns where they go. */
+static char *
+httplog_alloc(size_t len, char **data)
+{
+  *data = malloc(HTTPLOG_TIME_LEN + len + 1);
+  if (*data == NULL)
+    return NULL;
+#ifdef CONF_HTTPLOG_INCLUDE_TIMESTAMP
+  /* taken now, the message may be sent much later */
+  return *data + snprintf_P(*data, HTTPLOG_TIME_LEN + 1, PSTR("time=%lu&"),
+                            clock_get_time());
+#else
+  return *data;
+#endif
+}
+
 static uint8_t
 httplog_enqueue(char *data)
 {
+  if (queue_is_empty(&httplog_queue))
+    httplog_window = HTTPLOG_WINDOW;
+
   uint8_t result = queue_push(data, &httplog_queue);
   if (!result)
+  {
+    HTTPLOG_DEBUG("Queue full, message dropped.\n");
     free(data);
+  }
   return result;
 }
 
@@ -172,12 +294,13 @@ httplog(const char *message, ...)
   size_t len = (size_t) vsnprintf(NULL, 0, message, va);
   va_end(va);
 
-  char *data = malloc(len);
-  if (data == NULL)
+  char *data;
+  char *p = httplog_alloc(len, &data);
+  if (p == NULL)
     return 0;
 
   va_start(va, message);
-  vsnprintf(data, len, message, va);
+  vsnprintf(p, len + 1, message, va);
   va_end(va);
 
   return httplog_enqueue(data);
@@ -191,12 +314,13 @@ httplog_P(const char *message, ...)
   size_t len = (size_t) vsnprintf_P(NULL, 0, message, va);
   va_end(va);
 
-  char *data = malloc(len);
-  if (data == NULL)
+  char *data;
+  char *p = httplog_alloc(len, &data);
+  if (p == NULL)
     return 0;
 
   va_start(va, message);
-  vsnprintf_P(data, len, message, va);
+  vsnprintf_P(p, len + 1, message, va);
   va_end(va);
 
   return httplog_enqueue(data);
@@ -205,15 +329,40 @@ httplog_P(const char *message, ...)
 void
 httplog_flush(void)
 {
-  if (queue_is_empty(&httplog_queue))
-    return;                     /* nothing to send */
-  if (httplog_request_pending)
-    return;                     /* previous request not finished */
-  httplog_transmit();
+  httplog_window = 0;
+}
+
+void
+httplog_periodic(void)
+{
+  if (httplog_window)
+    httplog_window--;
+  if (httplog_retry)
+    httplog_retry--;
+  if (httplog_idle < UINT16_MAX)
+    httplog_idle++;
+
+  if (httplog_state == HTTPLOG_CLOSED)
+  {
+    if (!queue_is_empty(&httplog_queue) && httplog_window == 0
+        && httplog_retry == 0)
+      httplog_transmit();
+  }
+  else if (httplog_state == HTTPLOG_CONNECTED && !httplog_inflight
+           && ((!queue_is_empty(&httplog_queue) && httplog_window == 0)
+               || httplog_idle == HTTPLOG_KEEPALIVE))
+  {
+    /* send the batch or close the idle connection right away instead of
+     * waiting for the next poll of uIP */
+    uip_stack_set_active(httplog_conn->stack);
+    uip_poll_conn(httplog_conn);
+    if (uip_len > 0)
+      router_output();
+  }
 }
 
 /*
   -- Ethersex META --
   header(protocols/httplog/httplog.h)
-  mainloop(httplog_flush)
+  timer(1, httplog_periodic())
 */
@@ -29,5 +29,6 @@
 uint8_t httplog(const char*, ...);
 uint8_t httplog_P(const char*, ...);
 void httplog_flush(void);
+void httplog_periodic(void);
 
 #endif  /* __HTTPLOG_H */
@@ -40,17 +40,27 @@
  *  - the connack_callback will be fired (if supplied)
  *  - you may subscribe to topics using mqtt_construct_subscribe_packet(.)
  *  - the poll_callback will be fired each uip_poll cycle (if supplied)
+ *    (not on the extra polls when the delayed ACK budget is over)
  *  - the publish_callback will be fired when a publish packet arrives
- *    (if supplied)
+ *    whose topic matches the topic filter (if supplied), the topic is
+ *    split into its levels in mqtt_topic_levels already
  *  - the close_callback will be fired on a connection close/abort
  *    (if supplied)
  *
  * Make sure to only write packets when the connection is established
  * (mqtt_is_connected() returns true), which is guaranteed during the
- * connack, poll, publish callbacks.
+ * connack, poll, publish callbacks.  Publish packets are an exception,
+ * they go to the publish queue and are kept until the connection is up.
  *
- * The MQTT_SENDBUFFER_LENGTH can be configured freely, however do not increase
- * its value above 256. For values >256 the state variables need to be 16 bit.
+ * The publish queue (mqtt_queue) keeps complete publish packets, each
+ * with a state byte in front.  At every flush the new ones are moved to
+ * the send buffer in order, QoS 1/2 packets only as long as less than
+ * CONF_MQTT_INFLIGHT of them wait for their PUBACK/PUBCOMP.  These stay
+ * in the queue and are sent again with the DUP flag after a reconnect.
+ * With MQTT_SPILL_SUPPORT packets that don't fit while offline are
+ * appended to a VFS file, and as long as it isn't empty all new ones
+ * are, too, to keep the order.  The queue is refilled from it once the
+ * connection is up.
  *
  * Maybe an explanation of the buffer layout is in order:
  *
@@ -77,7 +87,7 @@
  *
  *  - Only one simultaneous connection
  *  - Only one topic per subscription message
- *  - QoS level 0 only (for publish and subscription messages)
+ *  - QoS level 0 only for subscriptions
  *
  *  Note:
  *
@@ -103,6 +113,10 @@
 #include "mqtt.h"
 #include "mqtt_state.h"
 
+#ifdef MQTT_SPILL_SUPPORT
+#include "core/vfs/vfs.h"
+#endif
+
 // DEBUG MACROS
 
 #ifdef MQTT_DEBUG
@@ -123,16 +137,42 @@
 // BUFFER VARIABLES
 
 static uint8_t mqtt_send_buffer[MQTT_SENDBUFFER_LENGTH];
-static uint8_t mqtt_send_buffer_last_length;    // length of last packet
+static uint16_t mqtt_send_buffer_last_length;   // length of last packet
                                                 // (for uip-retransmit)
-static uint8_t mqtt_send_buffer_current_head;   // current buffer head
-static uint8_t mqtt_receive_buffer_length;      // length of data for received buffer
+static uint16_t mqtt_send_buffer_current_head;  // current buffer head
+static uint16_t mqtt_receive_buffer_length;     // length of data for received buffer
 static uint16_t mqtt_receive_packet_length;     // length of next expected
                                                 // (not fully received) packet
 
+// PUBLISH QUEUE
+
+// state byte in front of every queued publish packet
+enum
+{
+  MQTT_QUEUE_NEW,               // not sent yet
+  MQTT_QUEUE_PUBACK,            // sent, waiting for PUBACK or PUBREC
+  MQTT_QUEUE_PUBCOMP,           // PUBREL sent, waiting for PUBCOMP
+  MQTT_QUEUE_DONE,              // to be removed
+};
+
+static uint8_t mqtt_queue[CONF_MQTT_QUEUE_LENGTH];
+static uint16_t mqtt_queue_length;      // bytes used
+
+#ifdef MQTT_SPILL_SUPPORT
+static vfs_size_t mqtt_spill_pos;       // next record in the spill file
+static vfs_size_t mqtt_spill_end;       // end of the spill file, 0 if empty
+static struct vfs_file_handle_t *mqtt_spill_fh; // mqtt_queue_put target
+#endif
+
+mqtt_topic_levels_t mqtt_topic_levels;
+
+struct mqtt_stats_t mqtt_stats;
+static uint16_t mqtt_stats_timer;
+static uint32_t mqtt_stats_last_published;
+
 // MQTT PROTOCOL STATE
 
-static uint16_t mqtt_next_msg_id;
+static uint16_t mqtt_next_msg_id = 1;
 static uint16_t mqtt_last_out_activity;
 static uint16_t mqtt_last_in_activity;
 static bool mqtt_ping_outstanding;
@@ -174,6 +214,22 @@ static uint8_t mqtt_buffer_write_length_field(uint8_t * buffer,
                                               uint16_t length);
 static bool mqtt_write_to_receive_buffer(const void *data, uint16_t length);
 
+static uint16_t mqtt_queue_record_size(const uint8_t * record);
+static uint8_t *mqtt_queue_record_msgid(uint8_t * record);
+static void mqtt_queue_put(const void *data, uint16_t length, bool progmem);
+static bool mqtt_queue_publish(char const *topic, bool topic_progmem,
+                               const void *payload, uint16_t payload_length,
+                               bool retain, uint8_t qos);
+static void mqtt_queue_send(void);
+static void mqtt_queue_compact(void);
+static void mqtt_queue_ack(uint8_t msg_type, uint16_t msgid);
+static void mqtt_queue_reset(void);
+static void mqtt_queue_release(void);
+#ifdef MQTT_SPILL_SUPPORT
+static bool mqtt_spill_open(void);
+static void mqtt_spill_load(void);
+#endif
+
 static bool mqtt_construct_connect_packet(void);
 static void mqtt_handle_packet(const void *data, uint8_t llen,
                                uint16_t packet_length);
@@ -181,6 +237,9 @@ static uint8_t mqtt_parse_length_field(uint16_t * length, const void *buffer,
                                        uint16_t max_read);
 static void mqtt_parse(void);
 
+static void mqtt_topic_split(char const *topic, uint16_t topic_length);
+static bool mqtt_topic_match(char const *topic, PGM_P filter);
+
 static void mqtt_fire_connack_callback(void);
 static void mqtt_fire_poll_callback(void);
 static void mqtt_fire_close_callback(void);
@@ -213,9 +272,9 @@ mqtt_abort_connection(void)
 static uint8_t
 MQTT_LF_LENGTH(uint16_t length)
 {
-  if (length < 1 << 8)
+  if (length < 1 << 7)
     return 1;
-  if (length < 1 << 15)
+  if (length < 1 << 14)
     return 2;
   return 3;                     // more isn't possible with uint16_t
 }
@@ -226,7 +285,7 @@ mqtt_reset_state(void)
 {
   mqtt_send_buffer_last_length = mqtt_send_buffer_current_head =
     mqtt_receive_buffer_length = mqtt_receive_packet_length = 0;
-  mqtt_next_msg_id = 0;
+  mqtt_queue_reset();
   mqtt_ping_outstanding = false;
   mqtt_last_in_activity = mqtt_last_out_activity = mqtt_timer_counter;
   STATE->stage = MQTT_STATE_DISCONNECTED;
@@ -303,6 +362,9 @@ mqtt_buffer_free(uint16_t length)
 static void
 mqtt_flush_buffer(void)
 {
+  if (STATE->stage == MQTT_STATE_CONNECTED)
+    mqtt_queue_send();
+
   if (mqtt_send_buffer_last_length == 0 &&      // no data waiting for a uip_ack
       mqtt_send_buffer_current_head > 0)
   {
@@ -380,6 +442,340 @@ mqtt_write_to_receive_buffer(const void *data, uint16_t length)
 }
 
 
+/*********************
+ *                   *
+ *   Publish Queue   *
+ *                   *
+ *********************/
+
+// return the size of the queue record (state byte and packet)
+static uint16_t
+mqtt_queue_record_size(const uint8_t * record)
+{
+  uint16_t length = 0;
+  uint8_t llen = mqtt_parse_length_field(&length, record + 2, 3);
+  return 2 + llen + length;
+}
+
+// return a pointer to the message id of a QoS 1/2 queue record
+static uint8_t *
+mqtt_queue_record_msgid(uint8_t * record)
+{
+  uint16_t length;
+  uint8_t *topic = record + 2;
+  topic += mqtt_parse_length_field(&length, topic, 3);
+  return topic + 2 + (topic[0] << 8 | topic[1]);
+}
+
+// append data to the queue, or to the spill file while it is open
+// (no free space check)
+static void
+mqtt_queue_put(const void *data, uint16_t length, bool progmem)
+{
+#ifdef MQTT_SPILL_SUPPORT
+  if (mqtt_spill_fh)
+  {
+    if (!progmem)
+    {
+      vfs_write(mqtt_spill_fh, (void *) data, length);
+      return;
+    }
+
+    uint8_t buf[16];
+    while (length > 0)
+    {
+      uint8_t n = MIN(length, sizeof(buf));
+      memcpy_P(buf, data, n);
+      vfs_write(mqtt_spill_fh, buf, n);
+      data += n;
+      length -= n;
+    }
+    return;
+  }
+#endif
+
+  if (progmem)
+    memcpy_P(mqtt_queue + mqtt_queue_length, data, length);
+  else
+    memcpy(mqtt_queue + mqtt_queue_length, data, length);
+  mqtt_queue_length += length;
+}
+
+static bool
+mqtt_queue_publish(char const *topic, bool topic_progmem,
+                   const void *payload, uint16_t payload_length,
+                   bool retain, uint8_t qos)
+{
+  uint16_t topic_length = topic_progmem ? strlen_P(topic) : strlen(topic);
+  uint16_t length = 2 + topic_length + payload_length;
+  if (qos > 0)
+    length += 2;                // message id
+
+  // state, header flags, length field, topic length
+  uint8_t head[1 + 1 + 3 + 2];
+  head[0] = MQTT_QUEUE_NEW;
+  head[1] = MQTTPUBLISH | qos << 1;
+  if (retain)
+    head[1] |= 1 << 0;
+  uint8_t head_length = 2 + mqtt_buffer_write_length_field(head + 2, length);
+  head[head_length++] = HI8(topic_length);
+  head[head_length++] = LO8(topic_length);
+
+  uint16_t size = head_length - 2 + length;
+  if (size > CONF_MQTT_QUEUE_LENGTH || size - 1 > MQTT_SENDBUFFER_LENGTH)
+    goto drop;                  // would never be sent
+
+#ifdef MQTT_SPILL_SUPPORT
+  // keep the order, once something is spilled everything is
+  if (mqtt_spill_end > 0 || (!mqtt_is_connected() &&
+                             mqtt_queue_length + size >
+                             CONF_MQTT_QUEUE_LENGTH))
+  {
+    if (!mqtt_spill_open())
+      goto drop;
+    mqtt_queue_put(&size, sizeof(size), false);
+  }
+  else
+#endif
+  if (mqtt_queue_length + size > CONF_MQTT_QUEUE_LENGTH)
+    goto drop;
+
+  mqtt_queue_put(head, head_length, false);
+  mqtt_queue_put(topic, topic_length, topic_progmem);
+  if (qos > 0)
+  {
+    uint8_t msgid[2] = { 0, 0 };        // assigned when sent
+    mqtt_queue_put(msgid, sizeof(msgid), false);
+  }
+  mqtt_queue_put(payload, payload_length, false);
+
+#ifdef MQTT_SPILL_SUPPORT
+  if (mqtt_spill_fh)
+  {
+    bool complete = vfs_size(mqtt_spill_fh) == mqtt_spill_end + 2 + size;
+    vfs_close(mqtt_spill_fh);
+    mqtt_spill_fh = NULL;
+    if (!complete)
+      goto drop;                // overwritten by the next one
+
+    mqtt_spill_end += 2 + size;
+    mqtt_stats.spilled++;
+  }
+#endif
+
+  mqtt_stats.published++;
+  return true;
+
+drop:
+  MQTTDEBUG("publish queue full");
+  mqtt_stats.dropped++;
+  return false;
+}
+
+// move new packets from the queue to the send buffer, in order and as
+// long as the in-flight window and the free buffer space allow
+static void
+mqtt_queue_send(void)
+{
+#ifdef MQTT_SPILL_SUPPORT
+  mqtt_spill_load();
+#endif
+
+  for (uint16_t pos = 0; pos < mqtt_queue_length;
+       pos += mqtt_queue_record_size(mqtt_queue + pos))
+  {
+    uint8_t *record = mqtt_queue + pos;
+    if (record[0] != MQTT_QUEUE_NEW)
+      continue;
+
+    uint8_t qos = (record[1] & 0x06) >> 1;
+    uint16_t length = mqtt_queue_record_size(record) - 1;
+    if ((qos > 0 && mqtt_stats.inflight >= CONF_MQTT_INFLIGHT) ||
+        !mqtt_buffer_free(length))
+      break;
+
+    if (qos > 0)
+    {
+      // a duplicate keeps the id it was sent with before
+      if (!(record[1] & MQTTDUP))
+      {
+        uint8_t *msgid = mqtt_queue_record_msgid(record);
+        msgid[0] = HI8(mqtt_next_msg_id);
+        msgid[1] = LO8(mqtt_next_msg_id);
+        make_new_message_id();
+      }
+      record[0] = MQTT_QUEUE_PUBACK;
+      mqtt_stats.inflight++;
+    }
+    else
+      record[0] = MQTT_QUEUE_DONE;
+
+    mqtt_buffer_write_data(record + 1, length);
+    mqtt_stats.sent++;
+  }
+
+  mqtt_queue_compact();
+}
+
+// remove the packets that are done
+static void
+mqtt_queue_compact(void)
+{
+  uint16_t pos = 0;
+  while (pos < mqtt_queue_length)
+  {
+    uint16_t size = mqtt_queue_record_size(mqtt_queue + pos);
+    if (mqtt_queue[pos] == MQTT_QUEUE_DONE)
+    {
+      mqtt_queue_length -= size;
+      memmove(mqtt_queue + pos, mqtt_queue + pos + size,
+              mqtt_queue_length - pos);
+    }
+    else
+      pos += size;
+  }
+}
+
+// a PUBACK, PUBREC or PUBCOMP arrived for msgid
+static void
+mqtt_queue_ack(uint8_t msg_type, uint16_t msgid)
+{
+  uint8_t state =
+    msg_type == MQTTPUBCOMP ? MQTT_QUEUE_PUBCOMP : MQTT_QUEUE_PUBACK;
+
+  for (uint16_t pos = 0; pos < mqtt_queue_length;
+       pos += mqtt_queue_record_size(mqtt_queue + pos))
+  {
+    uint8_t *record = mqtt_queue + pos;
+    if (record[0] != state)
+      continue;
+
+    uint8_t *id = mqtt_queue_record_msgid(record);
+    if ((id[0] << 8 | id[1]) != msgid)
+      continue;
+
+    // QoS 1 is answered by PUBACK, QoS 2 by PUBREC
+    uint8_t qos = (record[1] & 0x06) >> 1;
+    if (state == MQTT_QUEUE_PUBACK &&
+        (msg_type == MQTTPUBREC) != (qos == 2))
+      continue;
+
+    if (msg_type == MQTTPUBREC)
+    {
+      record[0] = MQTT_QUEUE_PUBCOMP;
+      return;
+    }
+
+    record[0] = MQTT_QUEUE_DONE;
+    mqtt_stats.inflight--;
+    mqtt_stats.acked++;
+    mqtt_queue_compact();
+    return;
+  }
+
+  MQTTDEBUG("ack for unknown message id %u", msgid);
+}
+
+// connection lost, packets not acknowledged are sent again as duplicates
+static void
+mqtt_queue_reset(void)
+{
+  mqtt_stats.inflight = 0;
+
+  for (uint16_t pos = 0; pos < mqtt_queue_length;
+       pos += mqtt_queue_record_size(mqtt_queue + pos))
+  {
+    uint8_t *record = mqtt_queue + pos;
+    if (record[0] == MQTT_QUEUE_PUBACK)
+    {
+      record[0] = MQTT_QUEUE_NEW;
+      record[1] |= MQTTDUP;
+    }
+    else if (record[0] == MQTT_QUEUE_PUBCOMP)
+      mqtt_stats.inflight++;
+  }
+}
+
+// connection established, release the packets that were received
+static void
+mqtt_queue_release(void)
+{
+  for (uint16_t pos = 0; pos < mqtt_queue_length;
+       pos += mqtt_queue_record_size(mqtt_queue + pos))
+  {
+    uint8_t *record = mqtt_queue + pos;
+    if (record[0] == MQTT_QUEUE_PUBCOMP)
+    {
+      uint8_t *id = mqtt_queue_record_msgid(record);
+      mqtt_construct_ack_packet(MQTTPUBREL, id[0] << 8 | id[1]);
+    }
+  }
+}
+
+#ifdef MQTT_SPILL_SUPPORT
+// open the spill file for appending a record
+static bool
+mqtt_spill_open(void)
+{
+  mqtt_spill_fh = vfs_open(CONF_MQTT_SPILL_FILE);
+  if (mqtt_spill_fh == NULL)
+    mqtt_spill_fh = vfs_create(CONF_MQTT_SPILL_FILE);
+  if (mqtt_spill_fh == NULL)
+    return false;
+
+  if (mqtt_spill_end == 0)
+    vfs_truncate(mqtt_spill_fh, 0);     // left over from before a reset
+  vfs_fseek(mqtt_spill_fh, mqtt_spill_end, SEEK_SET);
+  return true;
+}
+
+// refill the queue from the spill file
+static void
+mqtt_spill_load(void)
+{
+  if (mqtt_spill_end == 0)
+    return;
+
+  struct vfs_file_handle_t *fh = vfs_open(CONF_MQTT_SPILL_FILE);
+  if (fh == NULL)
+  {
+    mqtt_spill_pos = mqtt_spill_end = 0;
+    return;
+  }
+
+  while (mqtt_spill_pos < mqtt_spill_end)
+  {
+    uint16_t size;
+    vfs_fseek(fh, mqtt_spill_pos, SEEK_SET);
+    if (vfs_read(fh, &size, sizeof(size)) != sizeof(size) ||
+        size > CONF_MQTT_QUEUE_LENGTH)
+    {
+      mqtt_spill_pos = mqtt_spill_end;  // broken, drop the rest
+      break;
+    }
+
+    if (mqtt_queue_length + size > CONF_MQTT_QUEUE_LENGTH)
+      break;
+
+    if (vfs_read(fh, mqtt_queue + mqtt_queue_length, size) != size)
+    {
+      mqtt_spill_pos = mqtt_spill_end;
+      break;
+    }
+    mqtt_queue_length += size;
+    mqtt_spill_pos += 2 + size;
+  }
+
+  if (mqtt_spill_pos >= mqtt_spill_end)
+  {
+    vfs_truncate(fh, 0);
+    mqtt_spill_pos = mqtt_spill_end = 0;
+  }
+  vfs_close(fh);
+}
+#endif /* MQTT_SPILL_SUPPORT */
+
+
 /*********************
  *                   *
  *  Sending Packets  *
@@ -485,82 +881,32 @@ bool
 mqtt_construct_publish_packet(char const *topic, const void *payload,
                               uint16_t payload_length, bool retain)
 {
-  // maybe make this a parameter (at least qos=1 should already be operational)
-  const uint8_t qos = 0;
-
-  uint16_t length = strlen(topic) + 2 + payload_length;
-  if (qos > 0)
-    length += 2;                // message id
-
-  if (!mqtt_buffer_free(length + MQTT_LF_LENGTH(length) + 1))
-    return false;
-
-  // header flags
-  uint8_t header = MQTTPUBLISH | qos << 1;
-  if (retain)
-    header |= 1 << 0;
-
-  // fixed header
-  mqtt_send_buffer[mqtt_send_buffer_current_head++] = header;
-  mqtt_send_buffer_current_head +=
-    mqtt_buffer_write_length_field(mqtt_send_buffer +
-                                   mqtt_send_buffer_current_head, length);
-
-  // topic
-  mqtt_buffer_write_string(topic);
-
-  // message id
-  if (qos > 0)
-  {
-    mqtt_send_buffer[mqtt_send_buffer_current_head++] = HI8(mqtt_next_msg_id);
-    mqtt_send_buffer[mqtt_send_buffer_current_head++] = LO8(mqtt_next_msg_id);
-    make_new_message_id();
-  }
-
-  mqtt_buffer_write_data(payload, payload_length);
-
-  return true;
+  return mqtt_queue_publish(topic, false, payload, payload_length, retain, 0);
 }
 
 bool
 mqtt_construct_publish_packet_P(PGM_P topic, const void *payload,
                                 uint16_t payload_length, bool retain)
 {
-  // maybe make this a parameter (at least qos=1 should already be operational)
-  const uint8_t qos = 0;
-
-  uint16_t length = strlen_P(topic) + 2 + payload_length;
-  if (qos > 0)
-    length += 2;                // message id
-
-  if (!mqtt_buffer_free(length + MQTT_LF_LENGTH(length) + 1))
-    return false;
-
-  // header flags
-  uint8_t header = MQTTPUBLISH | qos << 1;
-  if (retain)
-    header |= 1 << 0;
-
-  // fixed header
-  mqtt_send_buffer[mqtt_send_buffer_current_head++] = header;
-  mqtt_send_buffer_current_head +=
-    mqtt_buffer_write_length_field(mqtt_send_buffer +
-                                   mqtt_send_buffer_current_head, length);
-
-  // topic
-  mqtt_buffer_write_string_P(topic);
-
-  // message id
-  if (qos > 0)
-  {
-    mqtt_send_buffer[mqtt_send_buffer_current_head++] = HI8(mqtt_next_msg_id);
-    mqtt_send_buffer[mqtt_send_buffer_current_head++] = LO8(mqtt_next_msg_id);
-    make_new_message_id();
-  }
+  return mqtt_queue_publish(topic, true, payload, payload_length, retain, 0);
+}
 
-  mqtt_buffer_write_data(payload, payload_length);
+bool
+mqtt_construct_publish_packet_qos(char const *topic, const void *payload,
+                                  uint16_t payload_length, bool retain,
+                                  uint8_t qos)
+{
+  return mqtt_queue_publish(topic, false, payload, payload_length, retain,
+                            qos);
+}
 
-  return true;
+bool
+mqtt_construct_publish_packet_qos_P(PGM_P topic, const void *payload,
+                                    uint16_t payload_length, bool retain,
+                                    uint8_t qos)
+{
+  return mqtt_queue_publish(topic, true, payload, payload_length, retain,
+                            qos);
 }
 
 
@@ -806,6 +1152,7 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
         mqtt_construct_subscribe_packet(mqtt_con_config->auto_subscribe_topics
                                         [i]);
 
+    mqtt_queue_release();
     mqtt_fire_connack_callback();
   }
 
@@ -880,7 +1227,18 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
 
 
       case MQTTPUBACK:
-        goto unhandled;         // hmm 'kay
+      case MQTTPUBCOMP:
+
+        // assert packet length
+        if (packet_length < 2)
+        {
+          MQTTDEBUG("packet length assert ack, aborting");
+          mqtt_abort_connection();
+          return;
+        }
+
+        mqtt_queue_ack(header & 0xf0, packet[0] << 8 | packet[1]);
+        break;
 
 
       case MQTTPUBREC:
@@ -896,6 +1254,7 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
         {
           uint16_t msgid = packet[0] << 8 | packet[1];
 
+          mqtt_queue_ack(MQTTPUBREC, msgid);
           mqtt_construct_ack_packet(MQTTPUBREL, msgid);
         }
 
@@ -921,10 +1280,6 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
         break;
 
 
-      case MQTTPUBCOMP:
-        goto unhandled;         // hmm 'kay
-
-
       case MQTTSUBACK:
       case MQTTUNSUBACK:
         goto unhandled;         // hmm 'kay
@@ -1164,6 +1519,81 @@ mqtt_parse(void)
 }
 
 
+/********************
+ *                  *
+ *   Topic Filter   *
+ *                  *
+ ********************/
+
+// split the topic into its levels (mqtt_topic_levels)
+static void
+mqtt_topic_split(char const *topic, uint16_t topic_length)
+{
+  uint8_t n = 0;
+  mqtt_topic_levels.merged = 0;
+  mqtt_topic_levels.offset[0] = 0;
+  for (uint16_t i = 0; i < topic_length; i++)
+    if (topic[i] == '/')
+    {
+      if (n + 1 < CONF_MQTT_TOPIC_LEVELS)
+        mqtt_topic_levels.offset[++n] = i + 1;
+      else
+        mqtt_topic_levels.merged = 1;
+    }
+  mqtt_topic_levels.count = n + 1;
+  mqtt_topic_levels.offset[n + 1] = topic_length + 1;
+}
+
+// match the split topic against a topic filter in PROGMEM, level by level
+static bool
+mqtt_topic_match(char const *topic, PGM_P filter)
+{
+  if (filter == NULL)
+    return true;
+
+  // topics starting with '$' are not matched by a wildcard at the first
+  // level
+  bool system = topic[0] == '$';
+
+  for (uint8_t level = 0;; level++)
+  {
+    char c = pgm_read_byte(filter);
+    if (c == '#')
+      return !(level == 0 && system);
+    if (level == mqtt_topic_levels.count)
+      return false;
+
+    uint16_t start = mqtt_topic_levels.offset[level];
+    uint16_t length = mqtt_topic_levels.offset[level + 1] - start - 1;
+    if (c == '+')
+    {
+      // a single level can't stand for the merged ones
+      if ((level == 0 && system)
+          || (mqtt_topic_levels.merged
+              && level + 1 == mqtt_topic_levels.count))
+        return false;
+      filter++;
+    }
+    else
+    {
+      for (uint16_t i = 0; i < length; i++)
+        if (pgm_read_byte(filter++) != topic[start + i])
+          return false;
+    }
+
+    c = pgm_read_byte(filter++);
+    if (c == '\0')
+      return level + 1 == mqtt_topic_levels.count;
+    if (c != '/')
+      return false;
+
+    // "a/#" matches "a", too
+    if (level + 1 == mqtt_topic_levels.count)
+      return pgm_read_byte(filter) == '#';
+  }
+}
+
+
 /********************
  *                  *
  *    Callbacks     *
@@ -1263,6 +1693,8 @@ mqtt_fire_publish_callback(char const *topic, uint16_t topic_length,
                            const void *payload, uint16_t payload_length,
                            bool retained)
 {
+  mqtt_topic_split(topic, topic_length);
+
   for (uint8_t i = 0; i < mqtt_static_callback_slots; i++)
   {
     mqtt_callback_config_t const *config =
@@ -1273,8 +1705,8 @@ mqtt_fire_publish_callback(char const *topic, uint16_t topic_length,
     if (cb == NULL)
       continue;
 
-    const char *modul_topic = (const char *) pgm_read_word(&config->topic);
-    if (modul_topic == NULL || strstr_P(topic, modul_topic) == topic)
+    PGM_P filter = (PGM_P) pgm_read_word(&config->topic);
+    if (mqtt_topic_match(topic, filter))
     {
       cb(topic, topic_length, payload, payload_length, retained);
     }
@@ -1293,8 +1725,8 @@ mqtt_fire_publish_callback(char const *topic, uint16_t topic_length,
     if (cb == NULL)
       continue;
 
-    const char *modul_topic = (const char *) pgm_read_word(&config->topic);
-    if (modul_topic == NULL || strstr_P(topic, modul_topic) == topic)
+    PGM_P filter = (PGM_P) pgm_read_word(&config->topic);
+    if (mqtt_topic_match(topic, filter))
     {
       cb(topic, topic_length, payload, payload_length, retained);
     }
@@ -1364,8 +1796,10 @@ mqtt_main(void)
     mqtt_construct_connect_packet();
 
     // init
-    mqtt_next_msg_id = 1;
     STATE->stage = MQTT_STATE_CONNECT;
+#ifdef UIP_TCP_DELACK_SUPPORT
+    uip_delack_set(UIP_DELACK_TICKS);
+#endif
 
     // send
     mqtt_flush_buffer();
@@ -1389,12 +1823,20 @@ mqtt_main(void)
     mqtt_parse();
   }
 
+#ifdef UIP_TCP_DELACK_SUPPORT
+  // collect answers and queued packets, they go out together with the
+  // held back ACK once the latency budget is over
+  if ((uip_newdata() || uip_acked()) && mqtt_send_buffer_current_head > 0)
+    uip_defer();
+#endif
+
   if (uip_poll())
   {
     if (STATE->stage == MQTT_STATE_CONNECTED)
     {
       //MQTTDEBUG("mqtt main poll");
-      mqtt_poll();
+      if (!uip_deferred())
+        mqtt_poll();
       mqtt_flush_buffer();
     }
     else if (STATE->stage == MQTT_STATE_CONNECT)
@@ -1446,6 +1888,13 @@ mqtt_periodic(void)
 {
   mqtt_timer_counter++;
 
+  if (++mqtt_stats_timer == 60 * TIMER_TICKS_PER_SECOND)
+  {
+    mqtt_stats_timer = 0;
+    mqtt_stats.rate = mqtt_stats.published - mqtt_stats_last_published;
+    mqtt_stats_last_published = mqtt_stats.published;
+  }
+
   if (!mqtt_uip_conn)
     mqtt_init();
 }
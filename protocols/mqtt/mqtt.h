@@ -41,12 +41,28 @@
 
 // SENDBUFFER LENGTH
 
-// don't increase this one over 256 without increasing the state variables in
-// mqtt.c to 16 bit
 #ifndef MQTT_SENDBUFFER_LENGTH
 #define MQTT_SENDBUFFER_LENGTH 256
 #endif
 
+// PUBLISH QUEUE
+
+#ifndef CONF_MQTT_QUEUE_LENGTH
+#define CONF_MQTT_QUEUE_LENGTH 256
+#endif
+
+#ifndef CONF_MQTT_INFLIGHT
+#define CONF_MQTT_INFLIGHT 4
+#endif
+
+// TOPIC LEVELS
+
+// levels beyond this one are kept together in the last one, a '+' of a
+// topic filter doesn't match it
+#ifndef CONF_MQTT_TOPIC_LEVELS
+#define CONF_MQTT_TOPIC_LEVELS 8
+#endif
+
 
 // CONSTANTS
 
@@ -72,6 +88,7 @@
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
+#define MQTTDUP         (1 << 3)
 
 
 // a macro for defining uip_ipaddr_t structures at compile time
@@ -89,8 +106,9 @@ typedef void (*publish_callback)(char const *topic, uint16_t topic_length,
                                  uint16_t payload_length, bool retained);
 typedef struct
 {
-  // see mqtt.c for explanation
-  char const *const *topic;
+  // Topic filter in PROGMEM, '+' and '#' wildcards are allowed (NULL for
+  // all topics).  The publish_callback is fired for the matching topics.
+  PGM_P topic;
   connack_callback connack_callback;
   poll_callback poll_callback;
   close_callback close_callback;
@@ -116,6 +134,36 @@ typedef struct
 } mqtt_connection_config_t;
 
 
+// TOPIC LEVELS OF A RECEIVED PUBLISH PACKET
+// (valid during the publish callbacks)
+typedef struct
+{
+  uint8_t count;
+  // the last level holds several levels of a deeper topic
+  uint8_t merged;
+  // start of each level in the topic, offset[count] is behind the end
+  // (topic_length + 1), so level i is offset[i+1] - offset[i] - 1 long
+  uint16_t offset[CONF_MQTT_TOPIC_LEVELS + 1];
+} mqtt_topic_levels_t;
+
+extern mqtt_topic_levels_t mqtt_topic_levels;
+
+
+// STATISTICS
+struct mqtt_stats_t
+{
+  uint32_t published;           // accepted by the publish queue
+  uint32_t sent;                // moved to the send buffer
+  uint32_t acked;               // PUBACK or PUBCOMP received
+  uint32_t dropped;             // rejected, the queue was full
+  uint32_t spilled;             // written to the spill file
+  uint16_t rate;                // published during the last minute
+  uint8_t inflight;             // QoS 1/2 messages not acknowledged yet
+};
+
+extern struct mqtt_stats_t mqtt_stats;
+
+
 // PUBLIC FUNCTIONS
 void mqtt_set_connection_config(mqtt_connection_config_t const *const config);
 uint8_t mqtt_register_callback(mqtt_callback_config_t const *const callbacks);
@@ -128,6 +176,12 @@ bool mqtt_construct_publish_packet(char const *topic, const void *payload,
                                    uint16_t payload_length, bool retain);
 bool mqtt_construct_publish_packet_P(PGM_P topic, const void *payload,
                                      uint16_t payload_length, bool retain);
+bool mqtt_construct_publish_packet_qos(char const *topic, const void *payload,
+                                       uint16_t payload_length, bool retain,
+                                       uint8_t qos);
+bool mqtt_construct_publish_packet_qos_P(PGM_P topic, const void *payload,
+                                         uint16_t payload_length, bool retain,
+                                         uint8_t qos);
 bool mqtt_construct_subscribe_packet(char const *topic);
 bool mqtt_construct_subscribe_packet_P(PGM_P topic);
 bool mqtt_construct_unsubscribe_packet(char const *topic);
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "mqtt.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+typedef struct
+{
+  uint8_t magic;
+  uint8_t line;
+} mqtt_stats_state_t;
+
+int16_t
+parse_cmd_mqtt_stats(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  mqtt_stats_state_t *state = (mqtt_stats_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->line = 0;
+  }
+
+  switch (state->line++)
+  {
+    case 0:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("published %lu"),
+                                   mqtt_stats.published));
+    case 1:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("sent %lu"),
+                                   mqtt_stats.sent));
+    case 2:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("acked %lu"),
+                                   mqtt_stats.acked));
+    case 3:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("dropped %lu"),
+                                   mqtt_stats.dropped));
+    case 4:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("spilled %lu"),
+                                   mqtt_stats.spilled));
+    case 5:
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("rate %u/min"),
+                                   mqtt_stats.rate));
+    default:
+      return ECMD_FINAL(snprintf_P(output, len, PSTR("inflight %u"),
+                                   mqtt_stats.inflight));
+  }
+}
+
+/*
+  -- Ethersex META --
+  block(MQTT)
+  ecmd_feature(mqtt_stats, "mqtt stats",, Show the publish queue statistics: published, sent, acknowledged, dropped and spilled messages, messages published during the last minute and QoS 1/2 messages in flight.)
+*/
@@ -23,6 +23,7 @@
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "config.h"
@@ -47,6 +48,10 @@
 #include "services/tanklevel/tanklevel.h"
 #endif
 
+#ifdef NETSTAT_SUPPORT
+#include "protocols/uip/netstat.h"
+#endif
+
 #ifdef SNMP_SUPPORT
 
 /**********************************************************
@@ -324,6 +329,100 @@ dht_next(uint8_t * ptr, struct snmp_varbinding * bind)
 }
 #endif
 
+#ifdef NETSTAT_SUPPORT
+static uint32_t
+netstat_count_get(struct netstat_count_t *c, uint8_t column)
+{
+  switch (column)
+  {
+    case 1:
+      return c->rx_packets;
+    case 2:
+      return c->rx_bytes;
+    case 3:
+      return c->tx_packets;
+    case 4:
+      return c->tx_bytes;
+    default:
+      return c->drops;
+  }
+}
+
+uint8_t
+netstat_stack_reaction(uint8_t * ptr, struct snmp_varbinding * bind,
+                       void *userdata)
+{
+  if (bind->len != 1 || bind->data[0] >= STACK_LEN)
+  {
+    return 0;
+  }
+  return encode_long(ptr, SNMP_TYPE_COUNTER,
+                     netstat_count_get(&netstat_stacks[bind->data[0]],
+                                       (uint16_t) (uintptr_t) userdata));
+}
+
+uint8_t
+netstat_stack_next(uint8_t * ptr, struct snmp_varbinding * bind)
+{
+  return onelevel_next(ptr, bind, STACK_LEN);
+}
+
+uint8_t
+netstat_port_reaction(uint8_t * ptr, struct snmp_varbinding * bind,
+                      void *userdata)
+{
+  if (bind->len != 1 || bind->data[0] >= CONF_NETSTAT_PORTS)
+  {
+    return 0;
+  }
+  struct netstat_port_t *p = &netstat_ports[bind->data[0]];
+
+  switch ((uint16_t) (uintptr_t) userdata)
+  {
+    case 0:
+      return encode_short(ptr, SNMP_TYPE_INTEGER, p->proto);
+    case 1:
+      return encode_short(ptr, SNMP_TYPE_INTEGER, HTONS(p->port));
+    case 7:
+      return encode_long(ptr, SNMP_TYPE_COUNTER, p->rexmit);
+#ifdef NETSTAT_TIMING_SUPPORT
+    case 8:
+      return encode_long(ptr, SNMP_TYPE_COUNTER, p->handler_us);
+#endif
+    default:
+      return encode_long(ptr, SNMP_TYPE_COUNTER,
+                         netstat_count_get(&p->c,
+                                           (uint16_t) (uintptr_t) userdata - 1));
+  }
+}
+
+uint8_t
+netstat_port_next(uint8_t * ptr, struct snmp_varbinding * bind)
+{
+  return onelevel_next(ptr, bind, CONF_NETSTAT_PORTS);
+}
+
+#ifdef NETSTAT_TIMING_SUPPORT
+uint8_t
+netstat_histogram_reaction(uint8_t * ptr, struct snmp_varbinding * bind,
+                           void *userdata)
+{
+  if (bind->len != 1 || bind->data[0] >= NETSTAT_BUCKETS)
+  {
+    return 0;
+  }
+  uint16_t *h = userdata;
+  return encode_long(ptr, SNMP_TYPE_COUNTER, h[bind->data[0]]);
+}
+
+uint8_t
+netstat_histogram_next(uint8_t * ptr, struct snmp_varbinding * bind)
+{
+  return onelevel_next(ptr, bind, NETSTAT_BUCKETS);
+}
+#endif
+#endif
+
 uint8_t
 string_pgm_reaction(uint8_t * ptr, struct snmp_varbinding * bind,
                     void *userdata)
@@ -387,6 +486,27 @@ const char dht_temp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x05\x02";
 const char dht_humid_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x05\x03";
 #endif
 
+#ifdef NETSTAT_SUPPORT
+const char netstat_stack_rxp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01\x01";
+const char netstat_stack_rxb_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01\x02";
+const char netstat_stack_txp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01\x03";
+const char netstat_stack_txb_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01\x04";
+const char netstat_stack_drop_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01\x05";
+const char netstat_port_proto_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x01";
+const char netstat_port_port_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x02";
+const char netstat_port_rxp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x03";
+const char netstat_port_rxb_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x04";
+const char netstat_port_txp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x05";
+const char netstat_port_txb_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x06";
+const char netstat_port_drop_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x07";
+const char netstat_port_rexmit_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x08";
+#ifdef NETSTAT_TIMING_SUPPORT
+const char netstat_port_cpu_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02\x09";
+const char netstat_latency_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x03\x01";
+const char netstat_handler_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x03\x02";
+#endif
+#endif
+
 const struct snmp_reaction snmp_reactions[] PROGMEM = {
   {desc_obj_name, string_pgm_reaction, (void *) desc_value, NULL},
 #if defined(WHM_SUPPORT) || defined(UPTIME_SUPPORT)
@@ -417,6 +537,26 @@ const struct snmp_reaction snmp_reactions[] PROGMEM = {
   {dht_polling_delay_obj_name, dht_polling_delay_reaction, NULL, dht_next},
   {dht_temp_obj_name, dht_temp_reaction, NULL, dht_next},
   {dht_humid_obj_name, dht_humid_reaction, NULL, dht_next},
+#endif
+#ifdef NETSTAT_SUPPORT
+  {netstat_stack_rxp_obj_name, netstat_stack_reaction, (void *) 1, netstat_stack_next},
+  {netstat_stack_rxb_obj_name, netstat_stack_reaction, (void *) 2, netstat_stack_next},
+  {netstat_stack_txp_obj_name, netstat_stack_reaction, (void *) 3, netstat_stack_next},
+  {netstat_stack_txb_obj_name, netstat_stack_reaction, (void *) 4, netstat_stack_next},
+  {netstat_stack_drop_obj_name, netstat_stack_reaction, (void *) 5, netstat_stack_next},
+  {netstat_port_proto_obj_name, netstat_port_reaction, (void *) 0, netstat_port_next},
+  {netstat_port_port_obj_name, netstat_port_reaction, (void *) 1, netstat_port_next},
+  {netstat_port_rxp_obj_name, netstat_port_reaction, (void *) 2, netstat_port_next},
+  {netstat_port_rxb_obj_name, netstat_port_reaction, (void *) 3, netstat_port_next},
+  {netstat_port_txp_obj_name, netstat_port_reaction, (void *) 4, netstat_port_next},
+  {netstat_port_txb_obj_name, netstat_port_reaction, (void *) 5, netstat_port_next},
+  {netstat_port_drop_obj_name, netstat_port_reaction, (void *) 6, netstat_port_next},
+  {netstat_port_rexmit_obj_name, netstat_port_reaction, (void *) 7, netstat_port_next},
+#ifdef NETSTAT_TIMING_SUPPORT
+  {netstat_port_cpu_obj_name, netstat_port_reaction, (void *) 8, netstat_port_next},
+  {netstat_latency_obj_name, netstat_histogram_reaction, netstat_latency, netstat_histogram_next},
+  {netstat_handler_obj_name, netstat_histogram_reaction, netstat_handler, netstat_histogram_next},
+#endif
 #endif
   {NULL, NULL, NULL, NULL}
 };
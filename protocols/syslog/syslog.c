@@ -23,16 +23,20 @@
  * http://www.gnu.org/copyleft/gpl.html
  */
 
+/* Messages are kept in a byte ring of CONF_SYSLOG_BUFFER bytes as
+ *   length, severity, text (not terminated)
+ * records.  A record never wraps around the end of the ring, a length of
+ * zero (or no room for a header) there means the next record starts at 0. */
+
 #include <avr/pgmspace.h>
 #include <stdarg.h>
-#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "protocols/uip/uip.h"
 #include "config.h"
 #include "core/debug.h"
 #include "core/param.h"
-#include "core/queue/queue.h"
 #include "protocols/uip/uip_router.h"
 #include "protocols/uip/check_cache.h"
 #include "syslog.h"
@@ -40,40 +44,95 @@
 
 #define UIP_MAX_LENGTH (UIP_BUFSIZE - UIP_IPUDPH_LEN - UIP_LLH_LEN)
 
+/* "<191>" in front of the text */
+#define SYSLOG_PRI_LENGTH 5
+#define SYSLOG_MAX_LENGTH \
+  MIN(255, MIN(UIP_MAX_LENGTH - SYSLOG_PRI_LENGTH, CONF_SYSLOG_BUFFER - 3))
+
 extern uip_udp_conn_t *syslog_conn;
-static Queue syslog_queue = {.limit = SYSLOG_QUEUE_LEN };
 
+static uint8_t syslog_ring[CONF_SYSLOG_BUFFER];
+static uint16_t syslog_head;    /* next record is written here */
+static uint16_t syslog_tail;    /* oldest record */
+static uint8_t syslog_records;
+
+#if CONF_SYSLOG_RATE > 0
+static uint8_t syslog_tokens[SYSLOG_SOURCES] = {
+  [0 ... SYSLOG_SOURCES - 1] = CONF_SYSLOG_BURST
+};
+#endif
+
+struct syslog_stats_t syslog_stats;
 
-static uint8_t
-syslog_enqueue(char *data)
+
+/* Check severity and rate limit of SOURCE and reserve a record for LEN
+ * bytes of text, plus one for the terminating zero of vsnprintf. */
+static char *
+syslog_reserve(uint8_t source, uint8_t severity, uint8_t len)
 {
-  uint8_t result = queue_push(data, &syslog_queue);
-  if (!result)
-    free(data);
-  return result;
+  if (severity > CONF_SYSLOG_SEVERITY)
+  {
+    syslog_stats.filtered++;
+    return NULL;
+  }
+
+#if CONF_SYSLOG_RATE > 0
+  if (syslog_tokens[source] == 0)
+  {
+    syslog_stats.limited++;
+    return NULL;
+  }
+#endif
+
+  uint16_t need = len + 3;
+  uint16_t pos = syslog_head;
+  if (syslog_records == 0 || syslog_head > syslog_tail)
+  {
+    if (CONF_SYSLOG_BUFFER - syslog_head < need)
+    {
+      if (syslog_records && need > syslog_tail)
+        goto full;
+      if (syslog_head < CONF_SYSLOG_BUFFER)
+        syslog_ring[syslog_head] = 0;   /* wrap around */
+      pos = 0;
+    }
+  }
+  else if (syslog_tail - syslog_head < need)
+    goto full;
+
+#if CONF_SYSLOG_RATE > 0
+  syslog_tokens[source]--;
+#endif
+  syslog_ring[pos] = len;
+  syslog_ring[pos + 1] = severity;
+  syslog_head = pos + len + 2;
+  syslog_records++;
+  return (char *) &syslog_ring[pos + 2];
+
+full:
+  syslog_stats.full++;
+  return NULL;
 }
 
 uint8_t
-syslog_send(const char *message)
+syslog_log(uint8_t source, uint8_t severity, const char *message)
 {
   size_t len = strlen(message);
   if (len == 0)
     return 1;                   /* zero sized message -> pretend it was sent */
 
-  len = MIN(len, UIP_MAX_LENGTH);
+  len = MIN(len, SYSLOG_MAX_LENGTH);
 
-  char *data = malloc(len + 1);
+  char *data = syslog_reserve(source, severity, len);
   if (data == NULL)
     return 0;
 
-  strncpy(data, message, len);
-  data[len] = 0;
-
-  return syslog_enqueue(data);
+  memcpy(data, message, len);
+  return 1;
 }
 
 uint8_t
-syslog_sendf_P(const char *message, ...)
+syslog_logf_P(uint8_t source, uint8_t severity, const char *message, ...)
 {
   va_list va;
   va_start(va, message);
@@ -83,16 +142,17 @@ syslog_sendf_P(const char *message, ...)
   if (len == 0)
     return 1;                   /* zero sized message -> pretend it was sent */
 
-  len = MIN(len, UIP_MAX_LENGTH) + 1;
-  char *data = malloc(len);
+  len = MIN(len, SYSLOG_MAX_LENGTH);
+
+  char *data = syslog_reserve(source, severity, len);
   if (data == NULL)
     return 0;
 
   va_start(va, message);
-  vsnprintf_P(data, len, message, va);
+  vsnprintf_P(data, len + 1, message, va);
   va_end(va);
 
-  return syslog_enqueue(data);
+  return 1;
 }
 
 void
@@ -104,20 +164,48 @@ syslog_flush(void)
                                  * here (would flood, wait for poll event). */
 #endif /* ETHERNET_SUPPORT */
 
-  if (queue_is_empty(&syslog_queue))
+  if (syslog_records == 0)
     return;
 
   uip_appdata = uip_sappdata = &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
-  uip_slen = 0;
-
-  char *data = queue_pop(&syslog_queue);
-  size_t len = strlen(data);
+  char *p = uip_appdata;
+
+  /* The length limit in syslog_reserve guarantees that the first message
+   * fits, with coalescing the following ones are taken while they fit, too,
+   * separated by newlines. */
+  do
+  {
+    if (syslog_tail + 2 > CONF_SYSLOG_BUFFER || syslog_ring[syslog_tail] == 0)
+      syslog_tail = 0;
+    uint8_t len = syslog_ring[syslog_tail];
+
+    if (p != uip_appdata)
+    {
+      if (p - (char *) uip_appdata + 1 + SYSLOG_PRI_LENGTH + len >
+          UIP_MAX_LENGTH)
+        break;
+      *p++ = '\n';
+    }
+    p += sprintf_P(p, PSTR("<%u>"),
+                   CONF_SYSLOG_FACILITY * 8 + syslog_ring[syslog_tail + 1]);
+    memcpy(p, &syslog_ring[syslog_tail + 2], len);
+    p += len;
+
+    syslog_tail += len + 2;
+    syslog_records--;
+    syslog_stats.sent++;
+  }
+#ifdef CONF_SYSLOG_COALESCE
+  while (syslog_records);
+#else
+  while (0);
+#endif
+
+  if (syslog_records == 0)
+    syslog_head = syslog_tail = 0;
 
-  /* The string truncation in syslog_send/syslog_send_P guarantees that
-   * memcpy never writes over the end of the destination buffer. */
-  memcpy(uip_appdata, data, len);
-  free(data);
-  uip_udp_send((int) len);
+  uip_slen = 0;
+  uip_udp_send((int) (p - (char *) uip_appdata));
 
   uip_udp_conn = syslog_conn;
   uip_process(UIP_UDP_SEND_CONN);
@@ -126,8 +214,18 @@ syslog_flush(void)
   uip_slen = 0;
 }
 
+void
+syslog_periodic(void)
+{
+#if CONF_SYSLOG_RATE > 0
+  for (uint8_t i = 0; i < SYSLOG_SOURCES; i++)
+    syslog_tokens[i] = MIN(CONF_SYSLOG_BURST, syslog_tokens[i] + CONF_SYSLOG_RATE);
+#endif
+}
+
 /*
   -- Ethersex META --
   header(protocols/syslog/syslog.h)
   mainloop(syslog_flush)
+  timer(50, syslog_periodic())
 */
@@ -28,9 +28,41 @@
 
 #include <stdint.h>
 
-uint8_t syslog_send(const char *message);
-uint8_t syslog_sendf_P(const char *message, ...);
+/* RFC 5424 severities */
+#define SYSLOG_EMERG    0
+#define SYSLOG_ALERT    1
+#define SYSLOG_CRIT     2
+#define SYSLOG_ERR      3
+#define SYSLOG_WARNING  4
+#define SYSLOG_NOTICE   5
+#define SYSLOG_INFO     6
+#define SYSLOG_DEBUG    7
+
+/* Sources with a rate limit of their own */
+#define SYSLOG_SOURCE_APP       0
+#define SYSLOG_SOURCE_DEBUG     1
+#define SYSLOG_SOURCES          2
+
+struct syslog_stats_t
+{
+  uint32_t sent;
+  uint32_t full;                /* dropped, buffer full */
+  uint32_t limited;             /* dropped by the rate limit */
+  uint32_t filtered;            /* dropped by severity */
+};
+
+extern struct syslog_stats_t syslog_stats;
+
+uint8_t syslog_log(uint8_t source, uint8_t severity, const char *message);
+uint8_t syslog_logf_P(uint8_t source, uint8_t severity, const char *message,
+                      ...);
+
+#define syslog_send(message) \
+  syslog_log(SYSLOG_SOURCE_APP, SYSLOG_NOTICE, message)
+#define syslog_sendf_P(message, args...) \
+  syslog_logf_P(SYSLOG_SOURCE_APP, SYSLOG_NOTICE, message, ## args)
 
 void syslog_flush(void);
+void syslog_periodic(void);
 
 #endif /* _SYSLOG_H */
@@ -46,7 +46,7 @@ syslog_debug_put(char d, FILE * stream)
 
   if (d == '\n' || syslog_debug_buf_offset >= MAX_SYSLOG_DEBUG_BUFFER)
   {
-    syslog_send(syslog_debug_buf);
+    syslog_log(SYSLOG_SOURCE_DEBUG, SYSLOG_DEBUG, syslog_debug_buf);
     syslog_debug_buf_offset = 0;
     syslog_debug_buf[syslog_debug_buf_offset] = 0;
   }
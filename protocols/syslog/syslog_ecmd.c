@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "protocols/syslog/syslog.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* Two lines, so that even the largest counters fit the ecmd output
+   buffer. */
+int16_t
+parse_cmd_syslog_stats(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  if (cmd[0] != ECMD_STATE_MAGIC)
+  {
+    cmd[0] = ECMD_STATE_MAGIC;
+    return ECMD_AGAIN(snprintf_P(output, len, PSTR("sent %lu full %lu"),
+                                 syslog_stats.sent, syslog_stats.full));
+  }
+
+  return ECMD_FINAL(snprintf_P(output, len, PSTR("limited %lu filtered %lu"),
+                               syslog_stats.limited, syslog_stats.filtered));
+}
+
+/*
+  -- Ethersex META --
+  block([[Syslog]])
+  ecmd_feature(syslog_stats, "syslog stats",, Show the counters of sent and dropped messages.)
+*/
@@ -102,7 +102,8 @@ ipchair_$1_chair(void)
 define(`__type', _chair_type($1))dnl
 ')
 
-define(`LEG', `if (_ipchair_arg_loop($@)')
+define(`_leg_now', `if (_ipchair_arg_loop($@)')
+define(`LEG', `ifdef(`ipchair_tree', `_tree_leg($@)', `_leg_now($@)')')
 define(`_ipchair_arg_loop', `dnl
 dnl Destination IP Address
 ifelse(`$1', `-d', `ipchair_dst($2) && $0(shift(shift($@)))')dnl
@@ -169,7 +170,7 @@ divert(2){
       return ifelse(__type, `builtin',, 0);
   }')')
 
-define(`POLICY', `
+define(`POLICY', `LEGS_END()
   ifelse(__type, `builtin', `policy:')
   if(1) __target($1)
   ifelse(__type, `user', `/* call failed, continue in parent */ return 1;')
@@ -177,5 +178,67 @@ define(`POLICY', `
 
 define(`SET_STACK', `uip_stack_set_active(STACK_$1); ')
 
+#######
+# Decision tree (m4 -Dipchair_tree)
+#
+# Instead of testing the legs one after another, collect them until
+# LEGS_END (or POLICY) and switch on the protocol and the destination
+# port first.  Every branch gets the legs that may match there, in their
+# original order, so the first matching leg still wins.  Legs are
+# duplicated into several branches, trading flash for speed.
+#
+# Code between the legs is output before the tree, so chairs that mix
+# legs with C code or #ifdef must call LEGS_END() before the code.
+#######
+define(`__nlegs', 0)
+define(`__ntrees', 0)
+
+dnl _leg_opt(OPT, ARGS...) -- the argument following OPT in ARGS
+define(`_leg_opt', `ifelse(`$2', `', `', `$2', `$1', `$3', `$0(`$1', shift(shift($@)))')')
+
+define(`_tree_leg', `define(`__nlegs', incr(__nlegs))dnl
+define(`__leg_'__nlegs, `_leg_now($@)')dnl
+define(`__leg_proto_'__nlegs, translit(_leg_opt(`-p', $@), `a-z', `A-Z'))dnl
+define(`__leg_dport_'__nlegs, _leg_opt(`--dport', $@))')
+
+dnl _tree_legs(PROTO, DPORT) -- the legs that may match PROTO and DPORT,
+dnl an empty PROTO resp. DPORT takes those without.
+define(`_tree_legs', `forloop(`__i', 1, __nlegs, `ifelse(dnl
+indir(`__leg_proto_'__i), `', `_tree_legs_dport(`$2')', dnl
+indir(`__leg_proto_'__i), `$1', `_tree_legs_dport(`$2')')')')
+define(`_tree_legs_dport', `ifelse(indir(`__leg_dport_'__i), `', `
+    indir(`__leg_'__i)', indir(`__leg_dport_'__i), `$1', `
+    indir(`__leg_'__i)')')
+
+define(`_tree_port', `ifelse(indir(`__leg_proto_'__i), `$1',
+`ifelse(indir(`__leg_dport_'__i), `', `',
+`ifdef(`__tree_'__ntrees`_$1_'indir(`__leg_dport_'__i), `',
+`define(`__tree_'__ntrees`_$1_'indir(`__leg_dport_'__i), 1)
+    case HTONS(indir(`__leg_dport_'__i)):_tree_legs(`$1', indir(`__leg_dport_'__i))
+      break;')')')')
+
+define(`_tree_case', `ifelse(indir(`__leg_proto_'__i), `', `',
+`ifdef(`__tree_'__ntrees`_'indir(`__leg_proto_'__i), `',
+`define(`__tree_'__ntrees`_'indir(`__leg_proto_'__i), 1)dnl
+_tree_case_proto(indir(`__leg_proto_'__i))')')')
+define(`_tree_has_ports', `forloop(`__k', 1, __nlegs, `ifelse(dnl
+indir(`__leg_proto_'__k), `$1', `ifelse(indir(`__leg_dport_'__k), `', `', `x')')')')
+define(`_tree_case_proto', `
+  case __paste2(`UIP_PROTO_', `$1'):dnl
+ifelse(_tree_has_ports(`$1'), `', `_tree_legs(`$1', `')', `
+    switch (__paste2(`BUF_', `$1')->destport) {dnl
+forloop(`__i', 1, __nlegs, `_tree_port(`$1')')
+    default:_tree_legs(`$1', `')
+      break;
+    }')
+    break;')
+
+define(`LEGS_END', `ifelse(__nlegs, 0, `', `define(`__ntrees', incr(__ntrees))
+  switch (BUF->proto) {dnl
+forloop(`__j', 1, __nlegs, `pushdef(`__i', __j)_tree_case()popdef(`__i')')
+  default:_tree_legs(`', `')
+    break;
+  }define(`__nlegs', 0)')')
+
 
 divert(0)dnl
@@ -21,88 +21,25 @@ dnl   For more information on the GPL, please go to:
 dnl   http://www.gnu.org/copyleft/gpl.html
 dnl
 
-dnl This packet allows to masquerade packets received via USB to be
-dnl automatically masqueraded, so you're able to use your Ethersex as
-dnl an USB network interface.
+dnl Masquerade connections from hosts on any stack to the uplink (ENC28J60
+dnl resp. TAP on the host), tracking each flow in the NAT table of nat.c.
+dnl Both chairs are meant to be jumped to from PREROUTING, e.g.
+dnl
+dnl   CHAIR(PREROUTING)
+dnl     LEG(-j, MAYBE_DEMASQUERADE)
+dnl     LEG(-j, MASQUERADE)
+dnl   POLICY(ACCEPT)
 
-divert(2)dnl
-static uip_ipaddr_t ipchair_masq_peer_addr;
+divert(1)#include "protocols/uip/ipchair/nat.h"
 divert(0)dnl
 
 CHAIR(MASQUERADE)
-  if (uip_stack_get_active() != STACK_USB)
-    __target(RETURN)
-
-  dnl Keep a copy of the IP address so we're able to route the packets back.
-  uip_ipaddr_copy(ipchair_masq_peer_addr, BUF->srcipaddr);
-
-  dnl Override the source IP address with the one assigned to the Ethersex.
-  REWRITE_SRCADDR(enc_stack_hostaddr)
-  REWRITE_CHKSUM_IP()
+  if (! nat_masquerade())
+    __target(RETURN)  dnl not headed for the uplink
 POLICY(ACCEPT)
 
 
 CHAIR(MAYBE_DEMASQUERADE)
-  if (! uip_ipaddr_cmp(BUF->destipaddr, enc_stack_hostaddr))
-    __target(RETURN)  dnl packet not addressed to us, forget it
-
-  LEG(-p, tcp, -j, MAYBE_DEMASQUERADE_TCP)
-  LEG(-p, udp, -j, MAYBE_DEMASQUERADE_UDP)
-
-#ifdef IPV6_SUPPORT
-  LEG(-p, icmp6, --icmp-type, ECHO_REPLY, -j, DEMASQUERADE)
-#else
-  LEG(-p, icmp, --icmp-type, ECHO_REPLY, -j, DEMASQUERADE)
-#endif
-POLICY(RETURN)
-
-
-CHAIR(MAYBE_DEMASQUERADE_TCP)
-  register uip_conn_t *uip_connr = uip_conn;
-  for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
-      ++uip_connr) {
-    if(uip_connr->tcpstateflags != UIP_CLOSED &&
-       BUF->destport == uip_connr->lport &&
-       BUF->srcport == uip_connr->rport &&
-       uip_ipaddr_cmp(BUF->srcipaddr, uip_connr->ripaddr)) {
-      __target(RETURN)  dnl established connection of uIP
-    }
-  }
-  
-
-  uint8_t c;
-  for(c = 0; c < UIP_LISTENPORTS; ++c) {
-    if(BUF->destport == uip_listenports[c].port)
-      __target(RETURN)  dnl listening socket available ...
-  }
-POLICY(DEMASQUERADE)
-
-
-CHAIR(MAYBE_DEMASQUERADE_UDP)
-  /* Demultiplex this UDP packet between the UDP "connections". */
-  for(uip_udp_conn = &uip_udp_conns[UIP_UDP_CONNS - 1];
-      uip_udp_conn >= &uip_udp_conns[0];
-      --uip_udp_conn) {
-    /* If the local UDP port is non-zero, the connection is considered
-       to be used. If so, the local port number is checked against the
-       destination port number in the received packet. If the two port
-       numbers match, the remote port number is checked if the
-       connection is bound to a remote port. Finally, if the
-       connection is bound to a remote IP address, the source IP
-       address of the packet is checked. */
-    if(uip_udp_conn->lport != 0 &&
-       BUF_UDP->destport == uip_udp_conn->lport &&
-       (uip_udp_conn->rport == 0 ||
-        BUF_UDP->srcport == uip_udp_conn->rport) &&
-       uip_ipaddr_cmp(BUF->srcipaddr, uip_udp_conn->ripaddr)) {
-      __target(RETURN)  dnl connection belongs to uIP
-    }
-  }
-POLICY(DEMASQUERADE)
-
-
-CHAIR(DEMASQUERADE)
-  REWRITE_DESTADDR(ipchair_masq_peer_addr)
-  REWRITE_CHKSUM_IP()
+  if (! nat_demasquerade())
+    __target(RETURN)  dnl not one of our translated flows
 POLICY(ACCEPT)
-
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Connection tracking NAT for ipchair masquerading.
+ *
+ * Every flow from a host behind one of the other stacks to the uplink
+ * gets a slot in nat_table, the slot number doubles as translated port
+ * (resp. ICMP echo id), so replies are mapped back without a search.
+ * Checksums are patched incrementally as described in RFC 1624. */
+
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
+#include "nat.h"
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define BUF_UDP ((struct uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define BUF_ICMP ((struct uip_icmpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define TCP_FIN 0x01
+#define TCP_RST 0x04
+
+#define ICMP_ECHO_REPLY 0
+#define ICMP_ECHO       8
+
+struct nat_entry_t nat_table[CONF_IPCHAIR_NAT_ENTRIES];
+
+
+/* Replace OLD by NEW in the area covered by checksum SUM. */
+static u16_t
+nat_chksum_adjust(u16_t sum, u16_t old, u16_t new)
+{
+  uint32_t s = (u16_t) ~ sum;
+  s += (u16_t) ~ old;
+  s += new;
+  s = (s & 0xffff) + (s >> 16);
+  s = (s & 0xffff) + (s >> 16);
+  return ~s;
+}
+
+/* Set the port (resp. echo id) at PORT to NEWPORT and the address at
+ * ADDR to NEWADDR, fixing the IP and transport checksums. */
+static void
+nat_rewrite(u16_t * addr, u16_t * newaddr, u16_t * port, u16_t newport)
+{
+  u16_t *chksum;
+  uint8_t pseudo = 1;
+
+  switch (BUF->proto)
+  {
+    case UIP_PROTO_TCP:
+      chksum = &BUF->tcpchksum;
+      break;
+    case UIP_PROTO_UDP:
+      chksum = &BUF_UDP->udpchksum;
+      if (*chksum == 0)
+        chksum = NULL;          /* sender didn't compute one */
+      break;
+    default:
+      chksum = &BUF_ICMP->icmpchksum;
+      pseudo = 0;
+  }
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    BUF->ipchksum = nat_chksum_adjust(BUF->ipchksum, addr[i], newaddr[i]);
+    if (chksum && pseudo)
+      *chksum = nat_chksum_adjust(*chksum, addr[i], newaddr[i]);
+    addr[i] = newaddr[i];
+  }
+
+  if (chksum)
+  {
+    *chksum = nat_chksum_adjust(*chksum, *port, newport);
+    if (BUF->proto == UIP_PROTO_UDP && *chksum == 0)
+      *chksum = 0xffff;
+  }
+  *port = newport;
+}
+
+static void
+nat_touch(struct nat_entry_t *e)
+{
+  if (e->proto == UIP_PROTO_TCP)
+  {
+    if (BUF->flags & (TCP_FIN | TCP_RST))
+      e->closing = 1;
+    e->timer = e->closing ? NAT_TIMEOUT_CLOSE : NAT_TIMEOUT_TCP;
+  }
+  else if (e->proto == UIP_PROTO_UDP)
+    e->timer = NAT_TIMEOUT_UDP;
+  else
+    e->timer = NAT_TIMEOUT_ICMP;
+}
+
+/* Find the entry for the outgoing flow in uip_buf, allocate one if there
+ * is none.  Entries are freed by nat_periodic once they expired, live
+ * flows are never evicted: if the table is full CONF_IPCHAIR_NAT_ENTRIES
+ * is returned and the new flow has to be dropped. */
+static uint8_t
+nat_lookup(u16_t port, u16_t rport, uint8_t stack)
+{
+  uint8_t free = CONF_IPCHAIR_NAT_ENTRIES;
+
+  for (uint8_t i = 0; i < CONF_IPCHAIR_NAT_ENTRIES; i++)
+  {
+    struct nat_entry_t *e = &nat_table[i];
+    if (e->proto == 0)
+    {
+      if (free == CONF_IPCHAIR_NAT_ENTRIES)
+        free = i;
+      continue;
+    }
+
+    if (e->proto == BUF->proto && e->port == port && e->rport == rport
+        && e->stack == stack
+        && uip_ipaddr_cmp(e->addr, BUF->srcipaddr)
+        && uip_ipaddr_cmp(e->raddr, BUF->destipaddr))
+      return i;
+  }
+
+  if (free == CONF_IPCHAIR_NAT_ENTRIES)
+    return free;
+
+  struct nat_entry_t *e = &nat_table[free];
+  uip_ipaddr_copy(e->addr, BUF->srcipaddr);
+  uip_ipaddr_copy(e->raddr, BUF->destipaddr);
+  e->port = port;
+  e->rport = rport;
+  e->proto = BUF->proto;
+  e->stack = stack;
+  e->closing = 0;
+  return free;
+}
+
+/* Whether the packet in uip_buf belongs to a connection resp. listener
+ * of uIP itself, which may use ports in the translated range too. */
+static uint8_t
+nat_local(void)
+{
+#if UIP_TCP
+  if (BUF->proto == UIP_PROTO_TCP)
+    return uip_tcp_lookup() || uip_listen_lookup(BUF->destport);
+#endif
+#if UIP_UDP
+  if (BUF->proto == UIP_PROTO_UDP)
+    return uip_udp_lookup() != NULL;
+#endif
+  return 0;
+}
+
+void
+nat_init(void)
+{
+  nat_flush();
+}
+
+void
+nat_flush(void)
+{
+  memset(nat_table, 0, sizeof(nat_table));
+}
+
+void
+nat_periodic(void)
+{
+  for (uint8_t i = 0; i < CONF_IPCHAIR_NAT_ENTRIES; i++)
+    if (nat_table[i].proto && --nat_table[i].timer == 0)
+      nat_table[i].proto = 0;
+}
+
+uint8_t
+nat_masquerade(void)
+{
+  uint8_t origin = uip_stack_get_active();
+  if (origin == NAT_UPLINK)
+    return 0;
+
+  u16_t *port, rport;
+  switch (BUF->proto)
+  {
+    case UIP_PROTO_TCP:
+    case UIP_PROTO_UDP:
+      port = &BUF->srcport;
+      rport = BUF->destport;
+      break;
+    case UIP_PROTO_ICMP:
+      if (BUF_ICMP->type != ICMP_ECHO)
+        return 0;
+      port = &BUF_ICMP->id;
+      rport = 0;
+      break;
+    default:
+      return 0;
+  }
+
+  /* Only masquerade what is going to be forwarded to the uplink. */
+  uint8_t local = router_find_stack(NULL);
+  uint8_t dest = router_find_stack(&BUF->destipaddr);
+  uip_stack_set_active(origin);
+  if (local != 255 || dest != NAT_UPLINK)
+    return 0;
+
+  uint8_t slot = nat_lookup(*port, rport, origin);
+  if (slot == CONF_IPCHAIR_NAT_ENTRIES)
+  {
+    uip_len = 0;                /* table full, drop the new flow */
+    return 1;
+  }
+  nat_touch(&nat_table[slot]);
+
+  nat_rewrite(BUF->srcipaddr, nat_uplink_hostaddr, port,
+              HTONS(CONF_IPCHAIR_NAT_PORT_BASE + slot));
+  return 1;
+}
+
+uint8_t
+nat_demasquerade(void)
+{
+  if (uip_stack_get_active() != NAT_UPLINK
+      || !uip_ipaddr_cmp(BUF->destipaddr, nat_uplink_hostaddr))
+    return 0;
+
+  u16_t *port, rport;
+  switch (BUF->proto)
+  {
+    case UIP_PROTO_TCP:
+    case UIP_PROTO_UDP:
+      port = &BUF->destport;
+      rport = BUF->srcport;
+      break;
+    case UIP_PROTO_ICMP:
+      if (BUF_ICMP->type != ICMP_ECHO_REPLY)
+        return 0;
+      port = &BUF_ICMP->id;
+      rport = 0;
+      break;
+    default:
+      return 0;
+  }
+
+  u16_t slot = HTONS(*port) - CONF_IPCHAIR_NAT_PORT_BASE;
+  if (slot >= CONF_IPCHAIR_NAT_ENTRIES || nat_local())
+    return 0;
+
+  struct nat_entry_t *e = &nat_table[slot];
+  if (e->proto != BUF->proto || e->rport != rport
+      || !uip_ipaddr_cmp(e->raddr, BUF->srcipaddr))
+    return 0;
+
+  nat_touch(e);
+  nat_rewrite(BUF->destipaddr, e->addr, port, e->port);
+  return 1;
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/uip/ipchair/nat.h)
+  init(nat_init)
+  timer(50, nat_periodic())
+*/
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef IPCHAIR_NAT_H
+#define IPCHAIR_NAT_H
+
+#include "protocols/uip/uip.h"
+
+#ifndef CONF_IPCHAIR_NAT_ENTRIES
+#define CONF_IPCHAIR_NAT_ENTRIES 16
+#endif
+
+/* Translated ports are NAT_PORT_BASE + slot, keep them clear of the
+ * ports uIP hands out for its own connections (1024..32000). */
+#ifndef CONF_IPCHAIR_NAT_PORT_BASE
+#define CONF_IPCHAIR_NAT_PORT_BASE 40000
+#endif
+
+/* Timeouts in seconds. */
+#define NAT_TIMEOUT_TCP   300
+#define NAT_TIMEOUT_CLOSE 10
+#define NAT_TIMEOUT_UDP   30
+#define NAT_TIMEOUT_ICMP  10
+
+/* The stack everything is masqueraded to. */
+#ifdef ENC28J60_SUPPORT
+#define NAT_UPLINK STACK_ENC
+#define nat_uplink_hostaddr enc_stack_hostaddr
+#elif defined(TAP_SUPPORT)
+#define NAT_UPLINK STACK_TAP
+#define nat_uplink_hostaddr tap_stack_hostaddr
+#else
+#error "IPCHAIR_MASQ needs an uplink: ENC28J60_SUPPORT (or TAP_SUPPORT on the host)"
+#endif
+
+struct nat_entry_t
+{
+  uip_ipaddr_t addr;            /* inner host */
+  u16_t port;                   /* its port resp. ICMP echo id */
+  uip_ipaddr_t raddr;           /* remote host */
+  u16_t rport;
+  uint8_t proto;                /* 0: unused */
+  uint8_t stack;                /* stack the inner host lives on */
+  uint8_t closing;              /* TCP FIN or RST seen */
+  uint16_t timer;
+};
+
+extern struct nat_entry_t nat_table[CONF_IPCHAIR_NAT_ENTRIES];
+
+void nat_init(void);
+void nat_periodic(void);
+void nat_flush(void);
+
+/* Translate the packet in uip_buf, to be called from a PREROUTING chair.
+ * Return 1 if the packet has been rewritten (or dropped by clearing
+ * uip_len, if the table is full), 0 if it isn't subject to translation. */
+uint8_t nat_masquerade(void);
+uint8_t nat_demasquerade(void);
+
+#endif /* IPCHAIR_NAT_H */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "nat.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* Every entry takes two lines, inner and remote side, so that it fits
+   the ecmd output buffer. */
+typedef struct
+{
+  uint8_t magic;
+  uint8_t slot;
+  uint8_t remote;
+} nat_list_state_t;
+
+int16_t
+parse_cmd_nat(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  nat_list_state_t *state = (nat_list_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->slot = 0;
+    state->remote = 0;
+  }
+
+  /* The entry may have timed out between its two lines, too. */
+  while (state->slot < CONF_IPCHAIR_NAT_ENTRIES
+         && nat_table[state->slot].proto == 0)
+  {
+    state->slot++;
+    state->remote = 0;
+  }
+  if (state->slot == CONF_IPCHAIR_NAT_ENTRIES)
+    return ECMD_FINAL_OK;
+
+  uint8_t i = state->slot;
+  struct nat_entry_t *e = &nat_table[i];
+  if (state->remote)
+  {
+    state->slot++;
+    state->remote = 0;
+    return ECMD_AGAIN(snprintf_P(output, len,
+                                 PSTR("  %d.%d.%d.%d:%u port %u ttl %u"),
+                                 uip_ipaddr1(e->raddr), uip_ipaddr2(e->raddr),
+                                 uip_ipaddr3(e->raddr), uip_ipaddr4(e->raddr),
+                                 HTONS(e->rport),
+                                 CONF_IPCHAIR_NAT_PORT_BASE + i, e->timer));
+  }
+
+  const char *proto = e->proto == UIP_PROTO_TCP ? PSTR("tcp") :
+    e->proto == UIP_PROTO_UDP ? PSTR("udp") : PSTR("icmp");
+  state->remote = 1;
+  return ECMD_AGAIN(snprintf_P(output, len,
+                               PSTR("%S %d.%d.%d.%d:%u stack %u"), proto,
+                               uip_ipaddr1(e->addr), uip_ipaddr2(e->addr),
+                               uip_ipaddr3(e->addr), uip_ipaddr4(e->addr),
+                               HTONS(e->port), e->stack));
+}
+
+int16_t
+parse_cmd_nat_flush(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  nat_flush();
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block(Network configuration)
+  ecmd_feature(nat_flush, "nat flush",, Drop all masquerading connections.)
+  ecmd_feature(nat, "nat",, List the masquerading connections.)
+*/
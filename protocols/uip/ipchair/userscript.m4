@@ -6,6 +6,7 @@ dnl to the ecmd port (2701), i.e. require ecmd to be accessed via the OpenVPN
 dnl connection.
   LEG(--stack, STACK_OPENVPN, -j, ACCEPT)
   LEG(-p, tcp, --dport, 2701, -j, DROP)
+  LEGS_END()
 #endif
 
 POLICY(ACCEPT)
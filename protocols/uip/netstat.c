@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Network statistics of the local stack.
+ *
+ * uip_process reports every packet received, sent and dropped, the
+ * counters are kept per stack and per protocol and local port.  With
+ * NETSTAT_TIMING_SUPPORT the periodic timer API is used to take the
+ * time of the application handlers and from uip_process being called
+ * to the packet being sent. */
+
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "netstat.h"
+
+#ifdef NETSTAT_TIMING_SUPPORT
+#include "core/periodic.h"
+#endif
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#if UIP_MULTI_STACK
+#define NETSTAT_STACK uip_stack_get_active()
+#else
+#define NETSTAT_STACK 0
+#endif
+
+struct netstat_count_t netstat_stacks[STACK_LEN];
+struct netstat_port_t netstat_ports[CONF_NETSTAT_PORTS];
+
+#ifdef NETSTAT_TIMING_SUPPORT
+uint16_t netstat_latency[NETSTAT_BUCKETS];
+uint16_t netstat_handler[NETSTAT_BUCKETS];
+
+static periodic_timestamp_t netstat_start;
+#endif
+
+
+static uint16_t
+netstat_iplen(void)
+{
+  uint16_t len = (BUF->len[0] << 8) + BUF->len[1];
+#if UIP_CONF_IPV6
+  len += UIP_IPH_LEN;
+#endif
+  return len;
+}
+
+static uint32_t
+netstat_packets(struct netstat_port_t *p)
+{
+  return p->c.rx_packets + p->c.tx_packets;
+}
+
+/* Add the counters of entry P to slot 0 and free it. */
+static void
+netstat_evict(struct netstat_port_t *p)
+{
+  struct netstat_port_t *o = &netstat_ports[0];
+
+  o->c.rx_packets += p->c.rx_packets;
+  o->c.rx_bytes += p->c.rx_bytes;
+  o->c.tx_packets += p->c.tx_packets;
+  o->c.tx_bytes += p->c.tx_bytes;
+  o->c.drops += p->c.drops;
+  o->rexmit += p->rexmit;
+#ifdef NETSTAT_TIMING_SUPPORT
+  o->handler_us += p->handler_us;
+  if (p->handler_max_us > o->handler_max_us)
+    o->handler_max_us = p->handler_max_us;
+#endif
+
+  memset(p, 0, sizeof(*p));
+}
+
+/* Find resp. allocate the entry of PROTO and local PORT.  If the table
+   is full the least used entry is moved to slot 0, so a port scan or a
+   run of ephemeral ports only ever churns the least used entry and
+   leaves the busy ports alone. */
+static struct netstat_port_t *
+netstat_port(uint8_t proto, u16_t port)
+{
+  struct netstat_port_t *free = NULL;
+
+  for (uint8_t i = 1; i < CONF_NETSTAT_PORTS; i++)
+  {
+    struct netstat_port_t *p = &netstat_ports[i];
+    if (p->proto == proto && p->port == port)
+      return p;
+    if (free == NULL || (free->proto != 0 &&
+                         (p->proto == 0 ||
+                          netstat_packets(p) < netstat_packets(free))))
+      free = p;
+  }
+
+  if (free == NULL)
+    return &netstat_ports[0];
+
+  if (free->proto != 0)
+    netstat_evict(free);
+
+  free->proto = proto;
+  free->port = port;
+  return free;
+}
+
+/* The entry of the packet in uip_buf, LOCAL is its local port. */
+static struct netstat_port_t *
+netstat_packet_port(u16_t local)
+{
+  if (BUF->proto != UIP_PROTO_TCP && BUF->proto != UIP_PROTO_UDP)
+    local = 0;
+  return netstat_port(BUF->proto, local);
+}
+
+#ifdef NETSTAT_TIMING_SUPPORT
+static void
+netstat_histogram(uint16_t * h, uint32_t us)
+{
+  uint8_t i = 0;
+  for (us >>= 6; us && i < NETSTAT_BUCKETS - 1; us >>= 1)
+    i++;
+
+  if (++h[i] == 0)
+    h[i]--;
+}
+
+static void
+netstat_appcall(uip_conn_callback_t callback, uint8_t proto, u16_t lport)
+{
+  periodic_timestamp_t start;
+  periodic_milliticks(&start);
+  callback();
+  uint32_t us = periodic_micros_elapsed(&start);
+
+  netstat_histogram(netstat_handler, us);
+
+  struct netstat_port_t *p = netstat_port(proto, lport);
+  p->handler_us += us;
+  if (us > p->handler_max_us)
+    p->handler_max_us = us > UINT16_MAX ? UINT16_MAX : us;
+}
+#endif
+
+
+void
+netstat_clear(void)
+{
+  memset(netstat_stacks, 0, sizeof(netstat_stacks));
+  memset(netstat_ports, 0, sizeof(netstat_ports));
+#ifdef NETSTAT_TIMING_SUPPORT
+  memset(netstat_latency, 0, sizeof(netstat_latency));
+  memset(netstat_handler, 0, sizeof(netstat_handler));
+#endif
+}
+
+void
+netstat_begin(void)
+{
+#ifdef NETSTAT_TIMING_SUPPORT
+  periodic_milliticks(&netstat_start);
+#endif
+}
+
+void
+netstat_input(void)
+{
+  uint16_t len = netstat_iplen();
+  struct netstat_count_t *s = &netstat_stacks[NETSTAT_STACK];
+  struct netstat_count_t *p = &netstat_packet_port(BUF->destport)->c;
+
+  s->rx_packets++;
+  s->rx_bytes += len;
+  p->rx_packets++;
+  p->rx_bytes += len;
+}
+
+void
+netstat_output(void)
+{
+  uint16_t len = netstat_iplen();
+  struct netstat_count_t *s = &netstat_stacks[NETSTAT_STACK];
+  struct netstat_count_t *p = &netstat_packet_port(BUF->srcport)->c;
+
+  s->tx_packets++;
+  s->tx_bytes += len;
+  p->tx_packets++;
+  p->tx_bytes += len;
+
+#ifdef NETSTAT_TIMING_SUPPORT
+  netstat_histogram(netstat_latency, periodic_micros_elapsed(&netstat_start));
+#endif
+}
+
+void
+netstat_drop(void)
+{
+  netstat_stacks[NETSTAT_STACK].drops++;
+  netstat_packet_port(BUF->destport)->c.drops++;
+}
+
+void
+netstat_rexmit(u16_t lport)
+{
+  netstat_port(UIP_PROTO_TCP, lport)->rexmit++;
+}
+
+#ifdef NETSTAT_TIMING_SUPPORT
+void
+netstat_tcp_appcall(void)
+{
+  netstat_appcall(uip_conn->callback, UIP_PROTO_TCP, uip_conn->lport);
+}
+
+void
+netstat_udp_appcall(void)
+{
+  netstat_appcall(uip_udp_conn->callback, UIP_PROTO_UDP,
+                  uip_udp_conn->lport);
+}
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef NETSTAT_H
+#define NETSTAT_H
+
+#include <stdint.h>
+
+#include "protocols/uip/uip.h"
+
+#ifndef CONF_NETSTAT_PORTS
+#define CONF_NETSTAT_PORTS 6
+#endif
+
+/* Histogram buckets: below 64us, 128us, ..., 4ms and the rest. */
+#define NETSTAT_BUCKETS 8
+#define NETSTAT_BUCKET_US(i) (64UL << (i))
+
+struct netstat_count_t
+{
+  uint32_t rx_packets;
+  uint32_t rx_bytes;
+  uint32_t tx_packets;
+  uint32_t tx_bytes;
+  uint16_t drops;
+};
+
+/* Traffic of the local stack by protocol and local port (0 for ICMP).
+   Slot 0 takes whatever doesn't fit into the table. */
+struct netstat_port_t
+{
+  uint8_t proto;                /* 0: unused */
+  u16_t port;                   /* network byte order */
+  struct netstat_count_t c;
+  uint16_t rexmit;
+#ifdef NETSTAT_TIMING_SUPPORT
+  uint32_t handler_us;          /* time spent in the application */
+  uint16_t handler_max_us;
+#endif
+};
+
+extern struct netstat_count_t netstat_stacks[STACK_LEN];
+extern struct netstat_port_t netstat_ports[CONF_NETSTAT_PORTS];
+
+#ifdef NETSTAT_TIMING_SUPPORT
+/* Time from uip_process being called (by the mainloop or the periodic
+   timer) to the packet being sent, and time spent in the application
+   handlers. */
+extern uint16_t netstat_latency[NETSTAT_BUCKETS];
+extern uint16_t netstat_handler[NETSTAT_BUCKETS];
+#endif
+
+void netstat_clear(void);
+
+/* Hooks in uip_process, uip_buf holds the packet. */
+void netstat_begin(void);
+void netstat_input(void);
+void netstat_output(void);
+void netstat_drop(void);
+void netstat_rexmit(u16_t lport);
+
+#ifdef NETSTAT_TIMING_SUPPORT
+/* Call the application of uip_conn resp. uip_udp_conn and take the
+   time. */
+void netstat_tcp_appcall(void);
+void netstat_udp_appcall(void);
+#endif
+
+#endif /* NETSTAT_H */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "netstat.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+#ifdef NETSTAT_TIMING_SUPPORT
+#define NETSTAT_LINES (STACK_LEN + CONF_NETSTAT_PORTS + NETSTAT_BUCKETS)
+#else
+#define NETSTAT_LINES (STACK_LEN + CONF_NETSTAT_PORTS)
+#endif
+
+/* Every counter set takes several lines, so that even the largest
+   values fit the ecmd output buffer. */
+typedef struct
+{
+  uint8_t magic;
+  uint8_t line;
+  uint8_t part;
+} netstat_list_state_t;
+
+static int16_t
+netstat_print_tx(char *output, uint16_t len, struct netstat_count_t *c)
+{
+  return snprintf_P(output, len, PSTR("  tx %lu/%lu drop %u"),
+                    c->tx_packets, c->tx_bytes, c->drops);
+}
+
+int16_t
+parse_cmd_netstat(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  netstat_list_state_t *state = (netstat_list_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->line = 0;
+    state->part = 0;
+  }
+
+  /* Skip unused ports. */
+  while (state->line >= STACK_LEN
+         && state->line < STACK_LEN + CONF_NETSTAT_PORTS
+         && state->line != STACK_LEN
+         && netstat_ports[state->line - STACK_LEN].proto == 0)
+    state->line++;
+  if (state->line == NETSTAT_LINES)
+    return ECMD_FINAL_OK;
+
+  uint8_t i = state->line;
+  uint8_t part = state->part++;
+  int16_t n;
+
+  if (i < STACK_LEN)
+  {
+    struct netstat_count_t *c = &netstat_stacks[i];
+    if (part == 0)
+      n = snprintf_P(output, len, PSTR("stack %u rx %lu/%lu"), i,
+                     c->rx_packets, c->rx_bytes);
+    else
+    {
+      n = netstat_print_tx(output, len, c);
+      goto next_line;
+    }
+    return ECMD_AGAIN(n);
+  }
+  i -= STACK_LEN;
+
+  if (i < CONF_NETSTAT_PORTS)
+  {
+    struct netstat_port_t *p = &netstat_ports[i];
+    if (part == 0)
+    {
+      if (i == 0)
+        n = snprintf_P(output, len, PSTR("other rx %lu/%lu"),
+                       p->c.rx_packets, p->c.rx_bytes);
+      else
+      {
+        const char *proto = p->proto == UIP_PROTO_TCP ? PSTR("tcp") :
+          p->proto == UIP_PROTO_UDP ? PSTR("udp") : PSTR("proto");
+        n = snprintf_P(output, len, PSTR("%S %u rx %lu/%lu"), proto,
+                       p->port ? HTONS(p->port) : p->proto,
+                       p->c.rx_packets, p->c.rx_bytes);
+      }
+    }
+    else if (part == 1)
+      n = netstat_print_tx(output, len, &p->c);
+    else
+    {
+#ifdef NETSTAT_TIMING_SUPPORT
+      n = snprintf_P(output, len, PSTR("  rexmit %u cpu %luus max %uus"),
+                     p->rexmit, p->handler_us, p->handler_max_us);
+#else
+      n = snprintf_P(output, len, PSTR("  rexmit %u"), p->rexmit);
+#endif
+      goto next_line;
+    }
+    return ECMD_AGAIN(n);
+  }
+  i -= CONF_NETSTAT_PORTS;
+
+#ifdef NETSTAT_TIMING_SUPPORT
+  if (i < NETSTAT_BUCKETS - 1)
+    n = snprintf_P(output, len, PSTR("<%luus latency %u handler %u"),
+                   NETSTAT_BUCKET_US(i), netstat_latency[i],
+                   netstat_handler[i]);
+  else
+    n = snprintf_P(output, len, PSTR(">=%luus latency %u handler %u"),
+                   NETSTAT_BUCKET_US(i - 1), netstat_latency[i],
+                   netstat_handler[i]);
+#else
+  return ECMD_FINAL_OK;
+#endif
+
+next_line:
+  state->line++;
+  state->part = 0;
+  return ECMD_AGAIN(n);
+}
+
+int16_t
+parse_cmd_netstat_clear(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  netstat_clear();
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block(Network IP Statistics)
+  ecmd_feature(netstat_clear, "netstat clear",, Reset the network statistics.)
+  ecmd_feature(netstat, "netstat",, Show traffic per stack and port and the latency histograms.)
+*/
@@ -114,6 +114,10 @@ uip_ipaddr_t uip_netmask;
 extern const uip_ipaddr_t mdns_address;
 #endif
 
+#ifdef E131_SUPPORT
+#include "protocols/e131/e131_net.h"
+#endif
+
 
 volatile uint8_t _uip_buf_lock;
 
@@ -164,6 +168,18 @@ u8_t uip_flags;              /* The uip_flags variable is used for
 				communication between the TCP/IP stack
 				and the application program. */
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+u16_t uip_ackedlen;          /* The number of bytes acknowledged by the
+				current ACK. */
+static u16_t uip_seqoff;     /* Offset of the segment being sent from
+				the oldest unacknowledged byte. */
+#endif
+
+#ifdef UIP_TCP_DELACK_SUPPORT
+u8_t uip_delack_due;         /* The application is polled because held
+				back ACKs or data are due. */
+#endif
+
 uip_conn_t *uip_conn;	     /* uip_conn always points to the current
 				connection. */
 
@@ -181,6 +197,48 @@ uip_udp_conn_t *uip_udp_conn;
 uip_udp_conn_t uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
+#ifdef UIP_CONN_INDEX_SUPPORT
+/* Connections, listening ports and UDP connections are indexed by a
+   hash of their local port.  Each bucket is a bitmask of the slots
+   whose port hashes to it, so demultiplexing only has to look at
+   those.  The bit of a closed TCP connection stays until the slot is
+   reused, the lookup checks the state anyway. */
+#define UIP_INDEX_BUCKETS 8
+#define uip_index_hash(port) \
+  (((port) ^ ((port) >> 8)) & (UIP_INDEX_BUCKETS - 1))
+
+#if UIP_CONNS <= 8 && UIP_LISTENPORTS <= 8 && UIP_UDP_CONNS <= 8
+typedef u8_t uip_index_t;
+#elif UIP_CONNS <= 16 && UIP_LISTENPORTS <= 16 && UIP_UDP_CONNS <= 16
+typedef u16_t uip_index_t;
+#elif UIP_CONNS <= 32 && UIP_LISTENPORTS <= 32 && UIP_UDP_CONNS <= 32
+typedef uint32_t uip_index_t;
+#else
+#error "The connection index supports up to 32 connections per table."
+#endif
+
+#if UIP_TCP
+static uip_index_t uip_tcp_index[UIP_INDEX_BUCKETS];
+static uip_index_t uip_listen_index[UIP_INDEX_BUCKETS];
+#endif
+#if UIP_UDP
+static uip_index_t uip_udp_index[UIP_INDEX_BUCKETS];
+#endif
+
+/* Move SLOT of INDEX to the bucket of PORT, a port of 0 removes it. */
+static void
+uip_index_set(uip_index_t *index, u8_t slot, u16_t port)
+{
+  uip_index_t bit = (uip_index_t) 1 << slot;
+  for(u8_t b = 0; b < UIP_INDEX_BUCKETS; ++b) {
+    index[b] &= ~bit;
+  }
+  if(port) {
+    index[uip_index_hash(port)] |= bit;
+  }
+}
+#endif /* UIP_CONN_INDEX_SUPPORT */
+
 #if !UIP_CONF_IPV6
 static u16_t ipid;           /* Ths ipid variable is an increasing
 				number that is used for the IP ID
@@ -217,6 +275,8 @@ u16_t lastport;              /* Keeps track of the last port used for
 #define ICMP_ECHO_REPLY 0
 #define ICMP_ECHO       8
 
+#define IGMP_V2_REPORT  0x16
+
 #define ICMP6_ECHO_REPLY             129
 #define ICMP6_ECHO                   128
 #define ICMP6_ROUTER_SOLICITATION    133
@@ -246,6 +306,19 @@ struct uip_stats uip_stat;
 #define UIP_STAT(s)
 #endif /* UIP_STATISTICS == 1 */
 
+#ifdef NETSTAT_SUPPORT
+#include "netstat.h"
+#define NETSTAT(s) s
+#ifdef NETSTAT_TIMING_SUPPORT
+#undef UIP_APPCALL
+#define UIP_APPCALL if (uip_conn->callback != NULL) netstat_tcp_appcall
+#undef UIP_UDP_APPCALL
+#define UIP_UDP_APPCALL if (uip_udp_conn->callback) netstat_udp_appcall
+#endif
+#else
+#define NETSTAT(s)
+#endif /* NETSTAT_SUPPORT */
+
 #ifdef DEBUG_UIP
 # include "core/debug.h"
 # define DEBUG_PRINTF(a...) debug_printf(a)
@@ -421,6 +494,16 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#ifdef UIP_CONN_INDEX_SUPPORT
+#if UIP_TCP
+  memset(uip_tcp_index, 0, sizeof(uip_tcp_index));
+  memset(uip_listen_index, 0, sizeof(uip_listen_index));
+#endif
+#if UIP_UDP
+  memset(uip_udp_index, 0, sizeof(uip_udp_index));
+#endif
+#endif /* UIP_CONN_INDEX_SUPPORT */
+
 
 }
 /*---------------------------------------------------------------------------*/
@@ -504,8 +587,19 @@ uip_connect(const uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callba
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
   conn->wnd = 0; /* unset the personal window size for this connection */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  conn->window = 0;
+  conn->snd_wnd = 0;
+  conn->rtt_end = 0;
+#endif
+#ifdef UIP_TCP_DELACK_SUPPORT
+  conn->delack = conn->dltimer = conn->ackpending = 0;
+#endif
   conn->lport = htons(lastport);
   conn->rport = rport;
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_set(uip_tcp_index, conn - uip_conns, conn->lport);
+#endif
 
 #ifdef UIP_TIMEOUT_SUPPORT
   conn->timeout = UIP_TCP_TIMEOUT;
@@ -567,6 +661,9 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 
   conn->lport = HTONS(lastport);
   conn->rport = rport;
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_set(uip_udp_index, conn - uip_udp_conns, conn->lport);
+#endif
   if(ripaddr == NULL) {
     memset(conn->ripaddr, 0, sizeof(uip_ipaddr_t));
   } else {
@@ -583,6 +680,52 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   return conn;
 }
 #endif /* UIP_ACTIVE_OPEN */
+
+#ifdef UIP_CONN_INDEX_SUPPORT
+void
+uip_udp_index_bind(uip_udp_conn_t *conn, u16_t port)
+{
+  conn->lport = port;
+  uip_index_set(uip_udp_index, conn - uip_udp_conns, port);
+}
+#endif /* UIP_CONN_INDEX_SUPPORT */
+/*---------------------------------------------------------------------------*/
+uip_udp_conn_t *
+uip_udp_lookup(void)
+{
+  /* The connections are searched from the last to the first one. */
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_t m = uip_udp_index[uip_index_hash(UDPBUF->destport)];
+  for(u8_t c = UIP_UDP_CONNS - 1; m; --c) {
+    uip_index_t bit = (uip_index_t) 1 << c;
+    if(!(m & bit)) {
+      continue;
+    }
+    m &= ~bit;
+#else
+  for(u8_t c = UIP_UDP_CONNS; c-- > 0;) {
+#endif
+    uip_udp_conn_t *conn = &uip_udp_conns[c];
+
+    /* If the local UDP port is non-zero, the connection is considered
+       to be used. If so, the local port number is checked against the
+       destination port number in the received packet. If the two port
+       numbers match, the remote port number is checked if the
+       connection is bound to a remote port. Finally, if the
+       connection is bound to a remote IP address, the source IP
+       address of the packet is checked. */
+    if(conn->lport != 0 &&
+       UDPBUF->destport == conn->lport &&
+       (conn->rport == 0 ||
+        UDPBUF->srcport == conn->rport) &&
+       (uip_ipaddr_cmp(conn->ripaddr, all_zeroes_addr) ||
+	uip_ipaddr_cmp(conn->ripaddr, all_ones_addr) ||
+	uip_ipaddr_cmp(BUF->srcipaddr, conn->ripaddr))) {
+      return conn;
+    }
+  }
+  return NULL;
+}
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
@@ -593,6 +736,9 @@ uip_unlisten(u16_t port)
   for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c].port == port) {
       uip_listenports[c].port = 0;
+#ifdef UIP_CONN_INDEX_SUPPORT
+      uip_index_set(uip_listen_index, c, 0);
+#endif
       return;
     }
   }
@@ -606,10 +752,55 @@ uip_listen(u16_t port, uip_conn_callback_t callback)
     if(uip_listenports[c].port == 0) {
       uip_listenports[c].port = port;
       uip_listenports[c].callback = callback;
+#ifdef UIP_CONN_INDEX_SUPPORT
+      uip_index_set(uip_listen_index, c, port);
+#endif
       return;
     }
   }
 }
+/*---------------------------------------------------------------------------*/
+uip_conn_t *
+uip_tcp_lookup(void)
+{
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_t m = uip_tcp_index[uip_index_hash(BUF->destport)];
+  for(u8_t c = 0; m; ++c, m >>= 1) {
+    if(!(m & 1)) {
+      continue;
+    }
+#else
+  for(u8_t c = 0; c < UIP_CONNS; ++c) {
+#endif
+    uip_conn_t *conn = &uip_conns[c];
+    if(conn->tcpstateflags != UIP_CLOSED &&
+       BUF->destport == conn->lport &&
+       BUF->srcport == conn->rport &&
+       uip_ipaddr_cmp(BUF->srcipaddr, conn->ripaddr)) {
+      return conn;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct uip_listen_port *
+uip_listen_lookup(u16_t port)
+{
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_t m = uip_listen_index[uip_index_hash(port)];
+  for(u8_t c = 0; m; ++c, m >>= 1) {
+    if(!(m & 1)) {
+      continue;
+    }
+#else
+  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+#endif
+    if(uip_listenports[c].port == port) {
+      return &uip_listenports[c];
+    }
+  }
+  return NULL;
+}
 #endif /* UIP_TCP */
 
 
@@ -623,6 +814,81 @@ uip_add_rcv_nxt(u16_t n)
   uip_conn->rcv_nxt[2] = uip_acc32[2];
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
+
+/* Update the RTT estimation with the round trip time M, this is taken
+   directly from VJs original code in his paper. */
+static void
+uip_rtt_estimate(uip_conn_t *conn, signed char m)
+{
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+
+#ifdef UIP_TCP_WINDOW_SUPPORT
+/* The number of bytes CONN may send now.  Until the peer has told us
+   its window (or if it is zero) only one segment may be in flight. */
+static u16_t
+uip_window_space(uip_conn_t *conn)
+{
+  u16_t limit = conn->window * conn->mss;
+  if(conn->snd_wnd == 0) {
+    limit = conn->mss;
+  } else if(limit > conn->snd_wnd) {
+    limit = conn->snd_wnd;
+  }
+
+  if(conn->len >= limit) {
+    return 0;
+  }
+  limit -= conn->len;
+  return limit > conn->mss ? conn->mss : limit;
+}
+
+u16_t
+uip_window_room(void)
+{
+  return uip_window_space(uip_conn);
+}
+
+/* Accept an ACK for the first N of the outstanding bytes. */
+static void
+uip_window_ack(uip_conn_t *conn, u16_t n)
+{
+  uip_add32(conn->snd_nxt, n);
+  conn->snd_nxt[0] = uip_acc32[0];
+  conn->snd_nxt[1] = uip_acc32[1];
+  conn->snd_nxt[2] = uip_acc32[2];
+  conn->snd_nxt[3] = uip_acc32[3];
+  conn->len -= n;
+
+  /* Only the segment marked when it was sent is timed, and none that
+     went out again after a timeout (Karn). */
+  if(conn->rtt_end) {
+    if(n >= conn->rtt_end) {
+      conn->rtt_end = 0;
+      uip_rtt_estimate(conn, conn->rtt);
+    } else {
+      conn->rtt_end -= n;
+    }
+  }
+
+  uip_ackedlen = n;
+  uip_flags = UIP_ACKDATA;
+  conn->nrtx = 0;
+  conn->timer = conn->rto;
+}
+
+#define uip_tcp_sendable(conn) \
+  (!uip_outstanding(conn) || ((conn)->window && uip_window_space(conn)))
+#else
+#define uip_tcp_sendable(conn) (!uip_outstanding(conn))
+#endif /* UIP_TCP_WINDOW_SUPPORT */
 #endif
 /*---------------------------------------------------------------------------*/
 
@@ -663,6 +929,8 @@ uip_ipaddr_prefixlencmp(uip_ip6addr_t _a, uip_ip6addr_t _b, u8_t prefix)
 void
 uip_process(u8_t flag)
 {
+  NETSTAT(netstat_begin());
+
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -674,11 +942,41 @@ uip_process(u8_t flag)
 #if UIP_TCP
   register uip_conn_t *uip_connr = uip_conn;
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  uip_seqoff = 0;
+#endif
+
+#ifdef UIP_TCP_DELACK_SUPPORT
+  /* Check if the held back ACK or data of a connection is due. The
+     application gets a last chance to answer, if it does not the ACK
+     goes out on its own. */
+  if(flag == UIP_DELACK) {
+    uip_len = uip_slen = 0;
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+       uip_tcp_sendable(uip_connr)) {
+      uip_flags = UIP_POLL;
+      uip_delack_due = 1;
+      UIP_APPCALL();
+      uip_delack_due = 0;
+      if(uip_slen == 0 && uip_connr->ackpending &&
+	 !(uip_flags & (UIP_CLOSE | UIP_ABORT))) {
+	goto tcp_send_ack;
+      }
+      goto appsend;
+    }
+    if(uip_connr->ackpending) {
+      goto tcp_send_ack;
+    }
+    goto drop;
+  }
+#endif
+
   /* Check if we were invoked because of a poll request for a
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       uip_tcp_sendable(uip_connr)) {
+	uip_slen = 0;
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -729,6 +1027,11 @@ uip_process(u8_t flag)
          BUF->flags = TCP_RST | TCP_ACK;
          goto tcp_send_nodata;
        }
+#endif
+#ifdef UIP_TCP_WINDOW_SUPPORT
+      if(uip_connr->rtt_end && uip_connr->rtt < 255) {
+	++(uip_connr->rtt);
+      }
 #endif
       /* If the connection has outstanding data, we increase the
 	 connection's timer and see if it has reached the RTO value
@@ -765,6 +1068,7 @@ uip_process(u8_t flag)
 	     SYNACK that we sent earlier and in LAST_ACK we have to
 	     retransmit our FINACK. */
 	  UIP_STAT(++uip_stat.tcp.rexmit);
+	  NETSTAT(netstat_rexmit(uip_connr->lport));
 	  switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
 	  case UIP_SYN_RCVD:
 	    /* In the SYN_RCVD state, we should retransmit our
@@ -781,6 +1085,18 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
 	  case UIP_ESTABLISHED:
+#ifdef UIP_TCP_WINDOW_SUPPORT
+	    if(uip_connr->window) {
+	      /* With a window we go back to the oldest unacknowledged
+		 byte, drop everything in flight and let the application
+		 send it again from there. */
+	      uip_connr->len = 0;
+	      uip_connr->rtt_end = 0;
+	      uip_flags = UIP_REXMIT;
+	      UIP_APPCALL();
+	      goto appsend;
+	    }
+#endif
 	    /* In the ESTABLISHED state, we call upon the application
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
@@ -797,7 +1113,9 @@ uip_process(u8_t flag)
 
 	  }
 	}
-      } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      }
+      if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+	 uip_tcp_sendable(uip_connr)) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
 	uip_flags = UIP_POLL;
@@ -825,6 +1143,7 @@ uip_process(u8_t flag)
 
   /* This is where the input processing starts. */
   UIP_STAT(++uip_stat.ip.recv);
+  NETSTAT(netstat_input());
 
   /* Start of IP input header processing code. */
 
@@ -887,6 +1206,12 @@ uip_process(u8_t flag)
   }
 #endif /* UIP_CONF_IPV6 */
 
+#ifdef E131_SUPPORT
+  /* Multicast group joined for sACN, only UDP is taken from there. */
+  if(BUF->proto == UIP_PROTO_UDP && e131_net_member(BUF->destipaddr))
+    goto ip_check_end;
+#endif
+
   {
     /* If IP broadcast support is configured, we check for a broadcast
        UDP packet, which may be destined to us. */
@@ -942,7 +1267,7 @@ uip_process(u8_t flag)
 #endif /* UIP_CONF_IPV6 */
   }
 
-#ifdef MDNS_SD_SUPPORT
+#if defined(MDNS_SD_SUPPORT) || defined(E131_SUPPORT)
 ip_check_end:
 #endif
 
@@ -1109,6 +1434,7 @@ ip_check_end:
   if(UDPBUF->udpchksum != 0 && uip_udpchksum() != 0xffff) {
     UIP_STAT(++uip_stat.udp.drop);
     UIP_STAT(++uip_stat.udp.chkerr);
+    NETSTAT(netstat_drop());
     UIP_LOG("udp: bad checksum.");
     goto drop;
   }
@@ -1117,28 +1443,16 @@ ip_check_end:
 #endif /* UIP_UDP_CHECKSUMS */
 
   /* Demultiplex this UDP packet between the UDP "connections". */
-  for(uip_udp_conn = &uip_udp_conns[UIP_UDP_CONNS - 1];
-      uip_udp_conn >= &uip_udp_conns[0];
-      --uip_udp_conn) {
-    /* If the local UDP port is non-zero, the connection is considered
-       to be used. If so, the local port number is checked against the
-       destination port number in the received packet. If the two port
-       numbers match, the remote port number is checked if the
-       connection is bound to a remote port. Finally, if the
-       connection is bound to a remote IP address, the source IP
-       address of the packet is checked. */
-    if(uip_udp_conn->lport != 0 &&
-       UDPBUF->destport == uip_udp_conn->lport &&
-       (uip_udp_conn->rport == 0 ||
-        UDPBUF->srcport == uip_udp_conn->rport) &&
-       (uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_zeroes_addr) ||
-	uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_ones_addr) ||
-	uip_ipaddr_cmp(BUF->srcipaddr, uip_udp_conn->ripaddr))) {
+  {
+    uip_udp_conn_t *conn = uip_udp_lookup();
+    if(conn != NULL) {
+      uip_udp_conn = conn;
       goto udp_found;
     }
   }
   DEBUG_PRINTF("udp: no matching connection found, sport %hu, dport %hu\n",
                ntohs(UDPBUF->srcport), ntohs(UDPBUF->destport));
+  NETSTAT(netstat_drop());
   goto drop;
 
  udp_found:
@@ -1200,6 +1514,7 @@ ip_check_end:
 				       checksum. */
     UIP_STAT(++uip_stat.tcp.drop);
     UIP_STAT(++uip_stat.tcp.chkerr);
+    NETSTAT(netstat_drop());
     UIP_LOG("tcp: bad checksum.");
     goto drop;
   }
@@ -1207,14 +1522,9 @@ ip_check_end:
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
-  for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
-      ++uip_connr) {
-    if(uip_connr->tcpstateflags != UIP_CLOSED &&
-       BUF->destport == uip_connr->lport &&
-       BUF->srcport == uip_connr->rport &&
-       uip_ipaddr_cmp(BUF->srcipaddr, uip_connr->ripaddr)) {
-      goto found;
-    }
+  uip_connr = uip_tcp_lookup();
+  if(uip_connr != NULL) {
+    goto found;
   }
 
   /* If we didn't find and active connection that expected the packet,
@@ -1227,14 +1537,15 @@ ip_check_end:
 
   u16_t tmp16 = BUF->destport;
   /* Next, check listening connections. */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
-    if(tmp16 == uip_listenports[c].port)
-      goto found_listen;
+  struct uip_listen_port *listenport = uip_listen_lookup(tmp16);
+  if(listenport != NULL) {
+    goto found_listen;
   }
 
   /* No matching connection found, so we send a RST packet. */
   UIP_STAT(++uip_stat.tcp.synrst);
  reset:
+  NETSTAT(netstat_drop());
 
   /* We do not send resets in response to resets. */
   if(BUF->flags & TCP_RST) {
@@ -1317,17 +1628,14 @@ ip_check_end:
        the remote end will retransmit the packet at a time when we
        have more spare connections. */
     UIP_STAT(++uip_stat.tcp.syndrop);
+    NETSTAT(netstat_drop());
     UIP_LOG("tcp: found no unused connections.");
     goto drop;
   }
   uip_conn = uip_connr;
 
   /* Set callback to the given value in uip_listenports */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c)
-    if(tmp16 == uip_listenports[c].port) {
-      uip_conn->callback = uip_listenports[c].callback;
-      break;
-    }
+  uip_conn->callback = listenport->callback;
 
 #if UIP_MULTI_STACK
   uip_conn->stack = uip_stack_get_active();
@@ -1339,8 +1647,19 @@ ip_check_end:
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
   uip_connr->wnd = 0; /* unset the personal window size for this connection */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  uip_connr->window = 0;
+  uip_connr->snd_wnd = 0;
+  uip_connr->rtt_end = 0;
+#endif
+#ifdef UIP_TCP_DELACK_SUPPORT
+  uip_connr->delack = uip_connr->dltimer = uip_connr->ackpending = 0;
+#endif
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
+#ifdef UIP_CONN_INDEX_SUPPORT
+  uip_index_set(uip_tcp_index, uip_connr - uip_conns, uip_connr->lport);
+#endif
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
@@ -1460,6 +1779,21 @@ ip_check_end:
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    /* A windowed connection accepts any ACK that covers part of the
+       outstanding data. */
+    if(uip_connr->window) {
+      uint32_t acked =
+	(((uint32_t)BUF->ackno[0] << 24) | ((uint32_t)BUF->ackno[1] << 16) |
+	 ((u16_t)BUF->ackno[2] << 8) | BUF->ackno[3]) -
+	(((uint32_t)uip_connr->snd_nxt[0] << 24) |
+	 ((uint32_t)uip_connr->snd_nxt[1] << 16) |
+	 ((u16_t)uip_connr->snd_nxt[2] << 8) | uip_connr->snd_nxt[3]);
+      if(acked > 0 && acked <= uip_connr->len) {
+	uip_window_ack(uip_connr, acked);
+      }
+    } else {
+#endif
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
     if(BUF->ackno[0] == uip_acc32[0] &&
@@ -1475,18 +1809,7 @@ ip_check_end:
 
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-	signed char m;
-	m = uip_connr->rto - uip_connr->timer;
-	/* This is taken directly from VJs original code in his paper */
-	m = m - (uip_connr->sa >> 3);
-	uip_connr->sa += m;
-	if(m < 0) {
-	  m = -m;
-	}
-	m = m - (uip_connr->sv >> 2);
-	uip_connr->sv += m;
-	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+	uip_rtt_estimate(uip_connr, uip_connr->rto - uip_connr->timer);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -1496,7 +1819,9 @@ ip_check_end:
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
     }
-
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    }
+#endif
   }
 
   /* Do different things depending on in what state the connection is. */
@@ -1661,6 +1986,9 @@ ip_check_end:
        "persistent timer" and uses the retransmission mechanim.
     */
     tmp16 = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    uip_connr->snd_wnd = tmp16;
+#endif
     if(tmp16 > uip_connr->initialmss ||
        tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
@@ -1717,6 +2045,27 @@ ip_check_end:
 	goto tcp_send_nodata;
       }
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+      if(uip_connr->window) {
+	/* New data goes out behind the data already in flight, as far
+	   as the window allows.  Everything we send carries the next
+	   sequence number so that the peer accepts our ACKs. */
+	uip_seqoff = uip_connr->len;
+	tmp16 = uip_window_space(uip_connr);
+	if(uip_slen > tmp16) {
+	  uip_slen = tmp16;
+	}
+	if(uip_slen > 0) {
+	  uip_connr->len += uip_slen;
+	  if(uip_connr->rtt_end == 0 && uip_connr->nrtx == 0) {
+	    uip_connr->rtt_end = uip_connr->len;
+	    uip_connr->rtt = 0;
+	  }
+	}
+	goto apprexmit;
+      }
+#endif
+
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
 
@@ -1758,6 +2107,11 @@ ip_check_end:
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#ifdef UIP_TCP_WINDOW_SUPPORT
+	if(uip_connr->window) {
+	  uip_len = uip_slen + UIP_TCPIP_HLEN;
+	}
+#endif
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
 	/* Send the packet. */
@@ -1766,6 +2120,19 @@ ip_check_end:
       /* If there is no data to send, just send out a pure ACK if
 	 there is newdata. */
       if(uip_flags & UIP_NEWDATA) {
+#ifdef UIP_TCP_DELACK_SUPPORT
+	/* Connections with delayed ACKs hold it back for a while, in
+	   the hope that it can ride on the answer, but acknowledge
+	   every second segment at once. */
+	if(uip_connr->delack && !uip_connr->ackpending &&
+	   !(uip_connr->tcpstateflags & UIP_STOPPED)) {
+	  uip_connr->ackpending = 1;
+	  if(!uip_connr->dltimer) {
+	    uip_connr->dltimer = uip_connr->delack;
+	  }
+	  goto drop;
+	}
+#endif
         uip_len = UIP_TCPIP_HLEN;
         BUF->flags = TCP_ACK;
         goto tcp_send_noopts;
@@ -1859,11 +2226,26 @@ ip_check_end:
   BUF->ackno[1] = uip_connr->rcv_nxt[1];
   BUF->ackno[2] = uip_connr->rcv_nxt[2];
   BUF->ackno[3] = uip_connr->rcv_nxt[3];
+#ifdef UIP_TCP_DELACK_SUPPORT
+  /* Whatever we send acknowledges everything received so far. */
+  uip_connr->ackpending = 0;
+#endif
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  if(uip_seqoff) {
+    uip_add32(uip_connr->snd_nxt, uip_seqoff);
+    BUF->seqno[0] = uip_acc32[0];
+    BUF->seqno[1] = uip_acc32[1];
+    BUF->seqno[2] = uip_acc32[2];
+    BUF->seqno[3] = uip_acc32[3];
+  } else
+#endif
+  {
   BUF->seqno[0] = uip_connr->snd_nxt[0];
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+  }
 
   BUF->proto = UIP_PROTO_TCP;
 
@@ -1934,6 +2316,7 @@ ip_check_end:
 	       (BUF->len[0] << 8) | BUF->len[1]);
 
   UIP_STAT(++uip_stat.ip.sent);
+  NETSTAT(netstat_output());
   /* Return and let the caller do the actual transmission. */
   uip_flags = 0;
   return;
@@ -1954,6 +2337,98 @@ uip_send(const void *data, int len)
   }
 }
 
+#if defined(IP_FORWARDING_SUPPORT) && !UIP_CONF_IPV6
+/* Replace the IP packet in uip_buf (uip_len including the LLH) by an
+   ICMP error message about it, sent from the active stack back to its
+   source.  Returns 0 if no message must be sent, i.e. the packet is an
+   ICMP error itself, a fragment other than the first one or was sent to
+   a broadcast address. */
+u8_t
+uip_icmp_error(u8_t type, u8_t code)
+{
+  if(BUF->proto == UIP_PROTO_ICMP && ICMPBUF->type != ICMP_ECHO
+     && ICMPBUF->type != ICMP_ECHO_REPLY) {
+    return 0;
+  }
+  if(uip_ipaddr_cmp(BUF->destipaddr, all_ones_addr)
+     || ((const u8_t *)BUF->destipaddr)[0] >= 224) {
+    return 0;
+  }
+  if((BUF->ipoffset[0] & 0x1f) != 0 || BUF->ipoffset[1] != 0) {
+    return 0;
+  }
+
+  /* Quote the IP header and the first 8 bytes of payload. */
+  u16_t len = (BUF->vhl & 0x0f) * 4 + 8;
+  if(len > uip_len - UIP_LLH_LEN) {
+    len = uip_len - UIP_LLH_LEN;
+  }
+  memmove(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + 8], &uip_buf[UIP_LLH_LEN],
+	  len);
+
+  uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
+  uip_ipaddr_copy(BUF->srcipaddr, uip_hostaddr);
+
+  len += 8;
+  ICMPBUF->type = type;
+  ICMPBUF->icode = code;
+  memset(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + 2], 0, 6);
+  ICMPBUF->icmpchksum = ~htons(chksum(0, &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN],
+				      len));
+
+  uip_len = UIP_IPH_LEN + len;
+  BUF->len[0] = uip_len >> 8;
+  BUF->len[1] = uip_len & 0xff;
+  BUF->ttl = UIP_TTL;
+  BUF->proto = UIP_PROTO_ICMP;
+  BUF->vhl = 0x45;
+  BUF->tos = 0;
+  BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
+  ++ipid;
+  BUF->ipid[0] = ipid >> 8;
+  BUF->ipid[1] = ipid & 0xff;
+  BUF->ipchksum = 0;
+  BUF->ipchksum = ~(uip_ipchksum());
+
+  UIP_STAT(++uip_stat.icmp.sent);
+  return 1;
+}
+#endif
+
+#if defined(E131_SUPPORT) && !UIP_CONF_IPV6
+/* Put an IGMPv2 membership report for GROUP into uip_buf, so switches
+   with IGMP snooping forward the multicast group to us. */
+void
+uip_igmp_report(const uip_ipaddr_t *group)
+{
+  u8_t *igmp = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN];
+  u16_t sum;
+
+  igmp[0] = IGMP_V2_REPORT;
+  igmp[1] = 0;
+  igmp[2] = igmp[3] = 0;
+  memcpy(&igmp[4], group, 4);
+  sum = ~htons(chksum(0, igmp, 8));
+  memcpy(&igmp[2], &sum, 2);
+
+  uip_len = UIP_IPH_LEN + 8;
+  BUF->len[0] = 0;
+  BUF->len[1] = uip_len;
+  BUF->ttl = 1;
+  BUF->proto = UIP_PROTO_IGMP;
+  BUF->vhl = 0x45;
+  BUF->tos = 0;
+  BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
+  ++ipid;
+  BUF->ipid[0] = ipid >> 8;
+  BUF->ipid[1] = ipid & 0xff;
+  uip_ipaddr_copy(BUF->srcipaddr, uip_hostaddr);
+  uip_ipaddr_copy(BUF->destipaddr, group);
+  BUF->ipchksum = 0;
+  BUF->ipchksum = ~(uip_ipchksum());
+}
+#endif
+
 #if UIP_TCP == 1
 void
 uip_tcp_timer(void)
@@ -1975,6 +2450,59 @@ uip_tcp_timer(void)
 
   return;
 }
+
+#ifdef UIP_TCP_WINDOW_SUPPORT
+/* uIP answers every event with a single segment, windowed connections
+   with data in flight are polled from the mainloop to fill up their
+   window. */
+void
+uip_tcp_window_fill(void)
+{
+#if UIP_CONNS <= 255
+  uint8_t i;
+#else
+  uint16_t i;
+#endif
+
+  for (i = 0; i < UIP_CONNS; i++) {
+    if (!uip_conns[i].window || !uip_outstanding(&uip_conns[i]))
+      continue;
+
+    uip_stack_set_active(uip_conns[i].stack);
+    uip_poll_conn(&uip_conns[i]);
+
+    if (uip_len > 0)
+      router_output();
+  }
+}
+#endif
+
+#ifdef UIP_TCP_DELACK_SUPPORT
+/* Count down the latency budget of connections with held back ACKs or
+   data, send them when it is over. */
+void
+uip_tcp_delack_timer(void)
+{
+#if UIP_CONNS <= 255
+  uint8_t i;
+#else
+  uint16_t i;
+#endif
+
+  for (i = 0; i < UIP_CONNS; i++) {
+    if (!uip_conns[i].dltimer || --uip_conns[i].dltimer)
+      continue;
+    if (uip_conns[i].tcpstateflags == UIP_CLOSED)
+      continue;
+
+    uip_stack_set_active(uip_conns[i].stack);
+    uip_delack_conn(&uip_conns[i]);
+
+    if (uip_len > 0)
+      router_output();
+  }
+}
+#endif
 #endif // UIP_TCP == 1
 
 #if UIP_UDP == 1
@@ -2008,5 +2536,7 @@ uip_udp_timer(void)
   header(protocols/uip/uip.h)
   header(protocols/uip/uip_router.h)
   ifdef(`conf_TCP', `timer(10, `uip_tcp_timer()')')
+  ifdef(`conf_UIP_TCP_WINDOW', `mainloop(uip_tcp_window_fill)')
+  ifdef(`conf_UIP_TCP_DELACK', `timer(1, `uip_tcp_delack_timer()')')
   ifdef(`conf_UDP', `timer(10, `uip_udp_timer()')')
 */
@@ -362,6 +362,19 @@ void uip_setipid(u16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn; \
                                  uip_process(UIP_POLL_REQUEST); } while (0)
 
+#ifdef UIP_TCP_DELACK_SUPPORT
+/**
+ * Send what has been held back on a connection with delayed ACKs.
+ *
+ * The application is polled, if it does not send anything a pending
+ * ACK goes out on its own.
+ *
+ * \hideinitializer
+ */
+#define uip_delack_conn(conn) do { uip_conn = conn; \
+                                   uip_process(UIP_DELACK); } while (0)
+#endif
+
 
 #if UIP_UDP
 /**
@@ -540,6 +553,106 @@ uip_conn_t *uip_connect(const uip_ipaddr_t *ripaddr, u16_t port, uip_conn_callba
  */
 #define uip_outstanding(conn) ((conn)->len)
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+/**
+ * Allow several segments in flight on the current connection.
+ *
+ * By default a connection sends one segment and waits for its
+ * acknowledgement, which limits throughput to one MSS per round trip.
+ * After calling this the application is polled for new data while
+ * earlier segments are still unacknowledged, until \a n segments (or
+ * the peer's window) are in flight.
+ *
+ * A windowed application must be able to produce its data from any
+ * offset: new data starts uip_unacked() bytes behind the last
+ * acknowledged byte and uip_acked_len() tells how many bytes an ACK
+ * covered.  On uip_rexmit() everything in flight has been dropped and
+ * the data has to be sent again starting at the last acknowledged
+ * byte (go-back-N).  uip_close() may only be called with nothing
+ * unacknowledged.
+ *
+ * \param n The number of segments, 0 disables the window.
+ *
+ * \hideinitializer
+ */
+#define uip_window_set(n) (uip_conn->window = (n))
+
+/**
+ * The number of bytes sent on the current connection, but not yet
+ * acknowledged.
+ *
+ * \hideinitializer
+ */
+#define uip_unacked()    (uip_conn->len)
+
+/**
+ * The number of bytes acknowledged by the current ACK.
+ *
+ * Only valid if uip_acked() is true.
+ *
+ * \hideinitializer
+ */
+#define uip_acked_len()  (uip_ackedlen)
+extern u16_t uip_ackedlen;
+
+/**
+ * The number of bytes the current connection may send right now.
+ *
+ * This is at most uip_mss() and 0 if the window is full.
+ */
+u16_t uip_window_room(void);
+
+void uip_tcp_window_fill(void);
+#endif /* UIP_TCP_WINDOW_SUPPORT */
+
+#ifdef UIP_TCP_DELACK_SUPPORT
+/**
+ * Latency budget for delayed ACKs, in ticks of uip_tcp_delack_timer().
+ */
+#define UIP_DELACK_TICKS (CONF_UIP_TCP_DELACK_MS / 20)
+
+/**
+ * Opt the current connection in to delayed ACKs.
+ *
+ * The ACK for incoming data is held back for up to n ticks so that it
+ * can ride on the answer of the application, every second segment is
+ * acknowledged at once.  The application is polled when the time is
+ * over, see uip_deferred().
+ *
+ * \param n The latency budget in ticks, 0 disables delayed ACKs.
+ *
+ * \hideinitializer
+ */
+#define uip_delack_set(n) (uip_conn->delack = (n))
+
+/**
+ * Hold back small writes on the current connection.
+ *
+ * The application is polled once the latency budget is over, so it can
+ * collect several writes into one segment until then.
+ *
+ * \hideinitializer
+ */
+#define uip_defer() do { if(!uip_conn->dltimer) {                \
+      uip_conn->dltimer = uip_conn->delack ? uip_conn->delack : 1; \
+    } } while(0)
+
+/**
+ * Is the application polled because the latency budget of a held back
+ * ACK or of data held back with uip_defer() is over?
+ *
+ * Only valid if uip_poll() is true.
+ *
+ * \hideinitializer
+ */
+#define uip_deferred()   (uip_delack_due)
+extern u8_t uip_delack_due;
+
+void uip_tcp_delack_timer(void);
+#else
+#define uip_deferred()   0
+#endif /* UIP_TCP_DELACK_SUPPORT */
+
 /**
  * Send data on the current connection.
  *
@@ -567,6 +680,13 @@ uip_conn_t *uip_connect(const uip_ipaddr_t *ripaddr, u16_t port, uip_conn_callba
  */
 void uip_send(const void *data, int len);
 
+/* Turn the packet in uip_buf into an ICMP error message for its sender,
+   used by the router. */
+u8_t uip_icmp_error(u8_t type, u8_t code);
+
+/* Put an IGMPv2 membership report for a multicast group into uip_buf. */
+void uip_igmp_report(const uip_ipaddr_t *group);
+
 /**
  * The length of any incoming data that is currently avaliable (if avaliable)
  * in the uip_appdata buffer.
@@ -802,7 +922,11 @@ uip_udp_conn_t *uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callbac
  *
  * \hideinitializer
  */
+#ifdef UIP_CONN_INDEX_SUPPORT
+#define uip_udp_remove(conn) uip_udp_index_bind((conn), 0)
+#else
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif
 
 /**
  * Bind a UDP connection to a local port.
@@ -814,7 +938,12 @@ uip_udp_conn_t *uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callbac
  *
  * \hideinitializer
  */
+#ifdef UIP_CONN_INDEX_SUPPORT
+#define uip_udp_bind(conn, port) uip_udp_index_bind((conn), (port))
+void uip_udp_index_bind(uip_udp_conn_t *conn, u16_t port);
+#else
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1229,7 +1358,8 @@ struct __uip_conn {
 			 receive next. */
   u8_t snd_nxt[4];    /**< The sequence number that was last sent by
                          us. */
-  u16_t len;          /**< Length of the data that was previously sent. */
+  u16_t len;          /**< Length of the data that was previously sent
+			 (and is not acknowledged yet). */
   u16_t wnd;          /**< window size for this connection */
   u16_t mss;          /**< Current maximum segment size for the
 			 connection. */
@@ -1244,6 +1374,22 @@ struct __uip_conn {
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  u8_t window;        /**< Number of segments that may be in flight,
+			 0 for the classic one segment behaviour. */
+  u16_t snd_wnd;      /**< Receive window advertised by the peer. */
+  u8_t rtt;           /**< Ticks since the timed segment was sent. */
+  u16_t rtt_end;      /**< Bytes to be acked until the timed segment
+			 is, 0 if none is timed. */
+#endif
+
+#ifdef UIP_TCP_DELACK_SUPPORT
+  u8_t delack;        /**< Latency budget for held back ACKs and data
+			 in ticks, 0 if delayed ACKs are disabled. */
+  u8_t dltimer;       /**< Ticks until held back ACKs and data are
+			 due, 0 if there are none. */
+  u8_t ackpending;    /**< An ACK for received data is held back. */
+#endif
 
 #ifdef UIP_TIMEOUT_SUPPORT
   u16_t timeout;       /** < The connection timeout timer */
@@ -1302,6 +1448,14 @@ struct __uip_udp_conn {
  */
 extern uip_udp_conn_t *uip_udp_conn;
 extern uip_udp_conn_t uip_udp_conns[UIP_UDP_CONNS];
+
+/**
+ * \internal
+ *
+ * Find the UDP connection an incoming datagram belongs to, NULL if
+ * there is none.
+ */
+uip_udp_conn_t *uip_udp_lookup(void);
 #endif /* UIP_UDP */
 
 /**
@@ -1448,6 +1602,8 @@ void uip_process(u8_t flag);
 #if UIP_UDP
 #define UIP_UDP_TIMER     5
 #endif /* UIP_UDP */
+#define UIP_DELACK        6     /* Tells uIP that the held back ACK or
+				   data of a connection is due. */
 
 /* The TCP states used in the uip_conn->tcpstateflags. */
 #define UIP_CLOSED      0
@@ -1587,10 +1743,13 @@ struct uip_udpip_hdr {
 #define UIP_APPDATA_SIZE (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 
 #define UIP_PROTO_ICMP  1
+#define UIP_PROTO_IGMP  2
 #define UIP_PROTO_TCP   6
 #define UIP_PROTO_UDP   17
 #define UIP_PROTO_ICMP6 58
 
+#define ICMP_TIME_EXCEEDED 11
+
 /* Header sizes. */
 #if UIP_CONF_IPV6
 #define UIP_IPH_LEN    40
@@ -1624,6 +1783,16 @@ extern const uip_ipaddr_t all_zeroes_addr;
 
 extern struct uip_listen_port uip_listenports[UIP_LISTENPORTS];
 
+/**
+ * \internal
+ *
+ * Find the connection (or listening port) an incoming TCP segment
+ * belongs to, NULL if there is none.  Used by uIP itself and the
+ * ipchair masquerading, which needs to tell uIP's own packets apart.
+ */
+uip_conn_t *uip_tcp_lookup(void);
+struct uip_listen_port *uip_listen_lookup(u16_t port);
+
 /**
  * Representation of a 48-bit Ethernet address.
  */
@@ -67,6 +67,10 @@
 #include "uip_arp.h"
 #include "config.h"
 
+#ifdef UIP_ROUTE_SUPPORT
+#include "uip_route.h"
+#endif
+
 #include <string.h>
 
 #define flip(t,a,b)  do { t __j = a; a = b; b = __j; } while(0)
@@ -424,6 +428,16 @@ uip_arp_out(void)
 	 use the default router's IP address instead of the destination
 	 address when determining the MAC address. */
       uip_ipaddr_copy(ipaddr, uip_draddr);
+#ifdef UIP_ROUTE_SUPPORT
+      /* ... unless a static route out of this stack names another
+	 gateway. */
+      uip_ipaddr_t nexthop;
+      uint8_t stack = uip_stack_get_active();
+      if(route_lookup(&IPBUF->destipaddr, &nexthop) == stack
+	 && !uip_ipaddr_cmp(nexthop, all_zeroes_addr))
+	uip_ipaddr_copy(ipaddr, nexthop);
+      uip_stack_set_active(stack);
+#endif
     } else {
       /* Else, we use the destination IP address. */
       uip_ipaddr_copy(ipaddr, IPBUF->destipaddr);
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Packet capture for the router.
+ *
+ * Every packet the router receives resp. sends is offered to
+ * capture_packet, which keeps the first CONF_CAPTURE_SNAPLEN bytes of
+ * the IP packet in a ring of CONF_CAPTURE_PACKETS slots, the oldest
+ * packet is overwritten.  The ring is read as pcap file, see
+ * vfs_capture.c. */
+
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "uip_capture.h"
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* Bytes of the IP header plus source and destination port. */
+#define CAPTURE_PORTS_LEN (UIP_IPH_LEN + 4)
+
+struct capture_state_t capture_state;
+uint32_t capture_ticks;
+
+static struct capture_packet_t capture_ring[CONF_CAPTURE_PACKETS];
+
+
+static uint8_t
+capture_match(uint16_t len)
+{
+  if (capture_state.proto && BUF->proto != capture_state.proto)
+    return 0;
+
+  if (capture_state.port == 0)
+    return 1;
+
+  if ((BUF->proto != UIP_PROTO_TCP && BUF->proto != UIP_PROTO_UDP)
+      || len < CAPTURE_PORTS_LEN)
+    return 0;
+
+  return BUF->srcport == capture_state.port
+    || BUF->destport == capture_state.port;
+}
+
+
+void
+capture_init(void)
+{
+  capture_clear();
+  capture_state.running = 1;
+}
+
+void
+capture_clear(void)
+{
+  capture_state.head = 0;
+  capture_state.count = 0;
+  capture_state.missed = 0;
+}
+
+/* Timestamps are in periodic timer ticks (1/HZ s). */
+void
+capture_periodic(void)
+{
+  capture_ticks++;
+}
+
+void
+capture_packet(uint16_t len)
+{
+  if (!capture_state.running || !capture_match(len))
+    return;
+
+  if (capture_state.readers)
+  {
+    capture_state.missed++;
+    return;
+  }
+
+  struct capture_packet_t *p = &capture_ring[capture_state.head];
+  p->time = capture_ticks;
+  p->len = len;
+  p->caplen = len < CONF_CAPTURE_SNAPLEN ? len : CONF_CAPTURE_SNAPLEN;
+  memcpy(p->data, BUF, p->caplen);
+
+  if (++capture_state.head == CONF_CAPTURE_PACKETS)
+    capture_state.head = 0;
+  if (capture_state.count < CONF_CAPTURE_PACKETS)
+    capture_state.count++;
+}
+
+struct capture_packet_t *
+capture_get(uint8_t i)
+{
+  if (i >= capture_state.count)
+    return NULL;
+
+  i += capture_state.head + CONF_CAPTURE_PACKETS - capture_state.count;
+  if (i >= CONF_CAPTURE_PACKETS)
+    i -= CONF_CAPTURE_PACKETS;
+  return &capture_ring[i];
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/uip/uip_capture.h)
+  init(capture_init)
+  timer(1, capture_periodic())
+*/
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef UIP_CAPTURE_H
+#define UIP_CAPTURE_H
+
+#include <stdint.h>
+
+#ifndef CONF_CAPTURE_PACKETS
+#define CONF_CAPTURE_PACKETS 8
+#endif
+
+#ifndef CONF_CAPTURE_SNAPLEN
+#define CONF_CAPTURE_SNAPLEN 64
+#endif
+
+struct capture_packet_t
+{
+  uint32_t time;                /* capture_ticks at arrival */
+  uint16_t len;                 /* length on the wire, without LLH */
+  uint16_t caplen;              /* bytes kept in data */
+  uint8_t data[CONF_CAPTURE_SNAPLEN];
+};
+
+struct capture_state_t
+{
+  uint8_t running;
+  uint8_t readers;              /* open pcap files, capture is held */
+  uint8_t head;                 /* next slot to be written */
+  uint8_t count;
+  uint8_t proto;                /* 0: any */
+  uint16_t port;                /* 0: any, network byte order */
+  uint32_t missed;              /* not stored while held */
+};
+
+extern struct capture_state_t capture_state;
+extern uint32_t capture_ticks;
+
+void capture_init(void);
+void capture_clear(void);
+void capture_periodic(void);
+
+/* Store the IP packet of LEN bytes in uip_buf (behind the LLH) if it
+   matches the filter. */
+void capture_packet(uint16_t len);
+
+/* Return the I-th stored packet, oldest first. */
+struct capture_packet_t *capture_get(uint8_t i);
+
+#endif /* UIP_CAPTURE_H */
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "uip_capture.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+#if UIP_CONF_IPV6
+#define CAPTURE_PROTO_ICMP UIP_PROTO_ICMP6
+#else
+#define CAPTURE_PROTO_ICMP UIP_PROTO_ICMP
+#endif
+
+/* Two lines, so that even the largest counters fit the ecmd output
+   buffer. */
+int16_t
+parse_cmd_capture(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  if (cmd[0] != ECMD_STATE_MAGIC)
+  {
+    char *p = cmd;
+    while (*p == ' ')
+      p++;
+    if (*p)
+      return ECMD_ERR_PARSE_ERROR;
+
+    cmd[0] = ECMD_STATE_MAGIC;
+    return ECMD_AGAIN(snprintf_P(output, len,
+                                 PSTR("%S %u/%u proto %u port %u"),
+                                 capture_state.running ? PSTR("on") :
+                                 PSTR("off"), capture_state.count,
+                                 CONF_CAPTURE_PACKETS, capture_state.proto,
+                                 HTONS(capture_state.port)));
+  }
+
+  return ECMD_FINAL(snprintf_P(output, len, PSTR("missed %lu"),
+                               capture_state.missed));
+}
+
+int16_t
+parse_cmd_capture_start(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  capture_state.running = 1;
+  return ECMD_FINAL_OK;
+}
+
+int16_t
+parse_cmd_capture_stop(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  capture_state.running = 0;
+  return ECMD_FINAL_OK;
+}
+
+int16_t
+parse_cmd_capture_clear(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  if (capture_state.readers)
+    return ECMD_ERR_WRITE_ERROR;
+
+  capture_clear();
+  return ECMD_FINAL_OK;
+}
+
+int16_t
+parse_cmd_capture_filter(char *cmd, char *output, uint16_t len)
+{
+  (void) output;
+  (void) len;
+
+  uint8_t proto = 0;
+  uint16_t port = 0;
+
+  while (*cmd == ' ')
+    cmd++;
+
+  if (strncmp_P(cmd, PSTR("any"), 3) == 0)
+    proto = 0;
+  else if (strncmp_P(cmd, PSTR("tcp"), 3) == 0)
+    proto = UIP_PROTO_TCP;
+  else if (strncmp_P(cmd, PSTR("udp"), 3) == 0)
+    proto = UIP_PROTO_UDP;
+  else if (strncmp_P(cmd, PSTR("icmp"), 4) == 0)
+    proto = CAPTURE_PROTO_ICMP;
+  else if (*cmd)
+  {
+    unsigned long p = strtoul(cmd, NULL, 10);
+    if (*cmd < '0' || *cmd > '9' || p > 255)
+      return ECMD_ERR_PARSE_ERROR;
+    proto = p;
+  }
+
+  while (*cmd && *cmd != ' ')
+    cmd++;
+  while (*cmd == ' ')
+    cmd++;
+
+  if (*cmd)
+  {
+    char *end;
+    unsigned long p = strtoul(cmd, &end, 10);
+    if (end == cmd || *end || p == 0 || p > 65535
+        || (proto != UIP_PROTO_TCP && proto != UIP_PROTO_UDP))
+      return ECMD_ERR_PARSE_ERROR;
+    port = HTONS((uint16_t) p);
+  }
+
+  capture_state.proto = proto;
+  capture_state.port = port;
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block(Network configuration)
+  ecmd_feature(capture_start, "capture start",, Start capturing packets.)
+  ecmd_feature(capture_stop, "capture stop",, Stop capturing packets.)
+  ecmd_feature(capture_clear, "capture clear",, Drop the captured packets.)
+  ecmd_feature(capture_filter, "capture filter ", PROTO [PORT], Capture only PROTO (tcp, udp, icmp or number) packets from or to PORT. PROTO any captures everything.)
+  ecmd_feature(capture, "capture",, Show the capture state.)
+*/
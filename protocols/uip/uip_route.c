@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Static routes for the IPv4 router.
+ *
+ * The networks the stacks are attached to are implicit routes, the
+ * static ones add networks behind other nodes.  The most specific match
+ * wins, attached networks before static routes of the same length.  If
+ * nothing matches, the packet goes to the default router.
+ *
+ * Most packets of a burst go to the same destination, so the result of
+ * the last lookup is kept. */
+
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "core/eeprom.h"
+#include "uip_route.h"
+
+struct route_entry_t route_table[CONF_UIP_ROUTES];
+
+static struct
+{
+  uip_ipaddr_t addr;
+  uip_ipaddr_t nexthop;
+  uint8_t stack;                /* ROUTE_UNUSED: nothing cached */
+} route_cache;
+
+
+static uint32_t
+route_addr(u16_t * addr)
+{
+  return ((uint32_t) HTONS(addr[0]) << 16) | HTONS(addr[1]);
+}
+
+static uint32_t
+route_mask(uint8_t len)
+{
+  return len ? 0xffffffffUL << (32 - len) : 0;
+}
+
+static uint8_t
+route_masklen(uint32_t mask)
+{
+  uint8_t len = 0;
+  while (len < 32 && (mask & (0x80000000UL >> len)))
+    len++;
+  return len;
+}
+
+static uint8_t
+route_match(uint32_t addr, uip_ipaddr_t * nexthop)
+{
+  uint8_t stack = ROUTE_UNUSED;
+  int8_t best = -1;
+
+  for (uint8_t i = 0; i < STACK_LEN; i++)
+  {
+    uip_stack_set_active(i);
+    uint32_t mask = route_addr(uip_netmask);
+    if ((addr ^ route_addr(uip_hostaddr)) & mask)
+      continue;
+
+    int8_t len = route_masklen(mask);
+    if (len > best)
+    {
+      best = len;
+      stack = i;
+    }
+  }
+
+  for (uint8_t i = 0; i < CONF_UIP_ROUTES; i++)
+  {
+    struct route_entry_t *r = &route_table[i];
+    if (r->stack == ROUTE_UNUSED || (int8_t) r->len <= best
+        || ((addr ^ route_addr(r->prefix)) & route_mask(r->len)))
+      continue;
+
+    best = r->len;
+    stack = r->stack;
+    uip_ipaddr_copy(*nexthop, r->nexthop);
+  }
+
+  return stack;
+}
+
+static void
+route_save(void)
+{
+#ifdef EEPROM_SUPPORT
+  eeprom_save(route_table, route_table, sizeof(route_table));
+  eeprom_update_chksum();
+#endif
+  route_flush_cache();
+}
+
+
+void
+route_init(void)
+{
+  memset(route_table, ROUTE_UNUSED, sizeof(route_table));
+#ifdef EEPROM_SUPPORT
+  eeprom_restore(route_table, route_table, sizeof(route_table));
+#endif
+
+  for (uint8_t i = 0; i < CONF_UIP_ROUTES; i++)
+    if (route_table[i].stack >= STACK_LEN || route_table[i].len > 32)
+      route_table[i].stack = ROUTE_UNUSED;
+
+  route_flush_cache();
+}
+
+/* Addresses of the stacks may change under us (BOOTP, DHCP, ecmd), so
+   the cache is dropped from time to time, too. */
+void
+route_flush_cache(void)
+{
+  route_cache.stack = ROUTE_UNUSED;
+}
+
+uint8_t
+route_lookup(uip_ipaddr_t * addr, uip_ipaddr_t * nexthop)
+{
+  if (route_cache.stack == ROUTE_UNUSED
+      || !uip_ipaddr_cmp(route_cache.addr, *addr))
+  {
+    uip_ipaddr(route_cache.nexthop, 0, 0, 0, 0);
+    uint8_t stack = route_match(route_addr(*addr), &route_cache.nexthop);
+    if (stack == ROUTE_UNUSED)
+      stack = route_match(route_addr(uip_draddr), &route_cache.nexthop);
+    if (stack == ROUTE_UNUSED)
+      return 255;
+
+    uip_ipaddr_copy(route_cache.addr, *addr);
+    route_cache.stack = stack;
+  }
+
+  if (nexthop)
+    uip_ipaddr_copy(*nexthop, route_cache.nexthop);
+  uip_stack_set_active(route_cache.stack);
+  return route_cache.stack;
+}
+
+uint8_t
+route_add(uip_ipaddr_t * prefix, uint8_t len, uint8_t stack,
+          uip_ipaddr_t * nexthop)
+{
+  if (len > 32 || stack >= STACK_LEN)
+    return 1;
+
+  uint32_t p = route_addr(*prefix) & route_mask(len);
+  struct route_entry_t *r = NULL;
+  for (uint8_t i = 0; i < CONF_UIP_ROUTES; i++)
+  {
+    struct route_entry_t *e = &route_table[i];
+    if (e->stack == ROUTE_UNUSED)
+    {
+      if (r == NULL)
+        r = e;
+    }
+    else if (e->len == len && route_addr(e->prefix) == p)
+    {
+      r = e;
+      break;
+    }
+  }
+  if (r == NULL)
+    return 1;                   /* Table full. */
+
+  r->prefix[0] = HTONS((u16_t) (p >> 16));
+  r->prefix[1] = HTONS((u16_t) p);
+  uip_ipaddr_copy(r->nexthop, *nexthop);
+  r->len = len;
+  r->stack = stack;
+  route_save();
+  return 0;
+}
+
+uint8_t
+route_del(uip_ipaddr_t * prefix, uint8_t len)
+{
+  uint32_t p = route_addr(*prefix) & route_mask(len);
+  for (uint8_t i = 0; i < CONF_UIP_ROUTES; i++)
+  {
+    struct route_entry_t *e = &route_table[i];
+    if (e->stack != ROUTE_UNUSED && e->len == len
+        && route_addr(e->prefix) == p)
+    {
+      e->stack = ROUTE_UNUSED;
+      route_save();
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/uip/uip_route.h)
+  init(route_init)
+  timer(500, route_flush_cache())
+*/
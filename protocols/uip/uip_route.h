@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef UIP_ROUTE_H
+#define UIP_ROUTE_H
+
+#include "protocols/uip/uip.h"
+
+#ifndef CONF_UIP_ROUTES
+#define CONF_UIP_ROUTES 4
+#endif
+
+#define ROUTE_UNUSED 0xff
+
+struct route_entry_t
+{
+  uip_ipaddr_t prefix;
+  uip_ipaddr_t nexthop;         /* 0.0.0.0: destination is on the link */
+  uint8_t len;
+  uint8_t stack;                /* ROUTE_UNUSED: free slot */
+};
+
+extern struct route_entry_t route_table[CONF_UIP_ROUTES];
+
+void route_init(void);
+void route_flush_cache(void);
+
+/* Find the stack to send a packet to ADDR on by longest prefix match
+   over the attached networks and the static routes and make it the
+   active one.  Unless NULL, NEXTHOP is set to the gateway of the route,
+   0.0.0.0 if the packet is to be sent to its destination (resp. the
+   default router) directly.  Returns 255 if there is no route. */
+uint8_t route_lookup(uip_ipaddr_t * addr, uip_ipaddr_t * nexthop);
+
+/* Add (or replace) resp. delete the route to PREFIX/LEN, returns 0 on
+   success. */
+uint8_t route_add(uip_ipaddr_t * prefix, uint8_t len, uint8_t stack,
+                  uip_ipaddr_t * nexthop);
+uint8_t route_del(uip_ipaddr_t * prefix, uint8_t len);
+
+#endif /* UIP_ROUTE_H */
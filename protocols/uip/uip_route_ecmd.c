@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip.h"
+#include "protocols/uip/parse.h"
+#include "uip_route.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+/* Names of the stacks, in the order of the enum in uip-conf.h */
+static const char route_stack_names[] PROGMEM =
+#if defined(RFM12_IP_SUPPORT)
+  "rfm12 "
+#endif
+#if defined(ZBUS_SUPPORT)
+  "zbus "
+#endif
+#if defined(OPENVPN_SUPPORT)
+  "openvpn "
+#endif
+#if defined(USB_NET_SUPPORT)
+  "usb "
+#endif
+#if defined(ENC28J60_SUPPORT)
+  "enc "
+#endif
+#if defined(TAP_SUPPORT)
+  "tap "
+#endif
+  ;
+
+/* Copy the name of STACK to BUF. */
+static void
+route_stack_name(uint8_t stack, char *buf)
+{
+  const char *p = route_stack_names;
+  while (stack--)
+    while (pgm_read_byte(p++) != ' ');
+
+  char c;
+  while ((c = pgm_read_byte(p++)) != ' ')
+    *buf++ = c;
+  *buf = 0;
+}
+
+/* Parse a stack name at CMD, returns STACK_LEN if there is none. */
+static uint8_t
+route_parse_stack(char *cmd)
+{
+  const char *p = route_stack_names;
+  for (uint8_t i = 0; i < STACK_LEN; i++)
+  {
+    uint8_t n = 0;
+    while (pgm_read_byte(p + n) != ' ')
+      n++;
+    if (strncmp_P(cmd, p, n) == 0 && (cmd[n] == ' ' || cmd[n] == 0))
+      return i;
+    p += n + 1;
+  }
+  return STACK_LEN;
+}
+
+/* Parse "PREFIX/LEN" at CMD, returns the position behind it. */
+static char *
+route_parse_prefix(char *cmd, uip_ipaddr_t * prefix, uint8_t * len)
+{
+  while (*cmd == ' ')
+    cmd++;
+
+  char *p = strchr(cmd, '/');
+  if (p == NULL)
+    return NULL;
+
+  *p = 0;
+  if (parse_ip(cmd, prefix))
+    return NULL;
+
+  char *end;
+  unsigned long l = strtoul(p + 1, &end, 10);
+  if (end == p + 1 || l > 32)
+    return NULL;
+  *len = l;
+
+  while (*end == ' ')
+    end++;
+  return end;
+}
+
+typedef struct
+{
+  uint8_t magic;
+  uint8_t slot;
+} route_list_state_t;
+
+int16_t
+parse_cmd_route(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  route_list_state_t *state = (route_list_state_t *) cmd;
+  if (state->magic != 23)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = 23;
+    state->slot = 0;
+  }
+
+  while (state->slot < CONF_UIP_ROUTES
+         && route_table[state->slot].stack == ROUTE_UNUSED)
+    state->slot++;
+  if (state->slot == CONF_UIP_ROUTES)
+    return ECMD_FINAL_OK;
+
+  struct route_entry_t *r = &route_table[state->slot++];
+  char name[8];
+  route_stack_name(r->stack, name);
+
+  return ECMD_AGAIN(snprintf_P(output, len,
+                               PSTR("%d.%d.%d.%d/%u %s %d.%d.%d.%d"),
+                               uip_ipaddr1(r->prefix), uip_ipaddr2(r->prefix),
+                               uip_ipaddr3(r->prefix), uip_ipaddr4(r->prefix),
+                               r->len, name,
+                               uip_ipaddr1(r->nexthop),
+                               uip_ipaddr2(r->nexthop),
+                               uip_ipaddr3(r->nexthop),
+                               uip_ipaddr4(r->nexthop)));
+}
+
+int16_t
+parse_cmd_route_add(char *cmd, char *output, uint16_t len)
+{
+  (void) output;
+  (void) len;
+
+  uip_ipaddr_t prefix, nexthop;
+  uint8_t plen;
+
+  cmd = route_parse_prefix(cmd, &prefix, &plen);
+  if (cmd == NULL)
+    return ECMD_ERR_PARSE_ERROR;
+
+  uint8_t stack = route_parse_stack(cmd);
+  if (stack == STACK_LEN)
+    return ECMD_ERR_PARSE_ERROR;
+
+  while (*cmd && *cmd != ' ')
+    cmd++;
+  while (*cmd == ' ')
+    cmd++;
+
+  if (*cmd == 0)
+    uip_ipaddr(nexthop, 0, 0, 0, 0);
+  else if (parse_ip(cmd, &nexthop))
+    return ECMD_ERR_PARSE_ERROR;
+
+  if (route_add(&prefix, plen, stack, &nexthop))
+    return ECMD_ERR_WRITE_ERROR;
+
+  return ECMD_FINAL_OK;
+}
+
+int16_t
+parse_cmd_route_del(char *cmd, char *output, uint16_t len)
+{
+  (void) output;
+  (void) len;
+
+  uip_ipaddr_t prefix;
+  uint8_t plen;
+
+  cmd = route_parse_prefix(cmd, &prefix, &plen);
+  if (cmd == NULL || *cmd)
+    return ECMD_ERR_PARSE_ERROR;
+
+  if (route_del(&prefix, plen))
+    return ECMD_ERR_PARSE_ERROR;
+
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block(Network configuration)
+  ecmd_feature(route_add, "route add ", PREFIX/LEN STACK [GATEWAY], Add a static route via STACK (enc, tap, rfm12, zbus, usb, openvpn).)
+  ecmd_feature(route_del, "route del ", PREFIX/LEN, Delete a static route.)
+  ecmd_feature(route, "route",, List the static routes.)
+*/
@@ -40,6 +40,14 @@
 #include "ipchair/ipchair.h"
 #endif
 
+#ifdef UIP_ROUTE_SUPPORT
+#include "uip_route.h"
+#endif
+
+#ifdef CAPTURE_SUPPORT
+#include "uip_capture.h"
+#endif
+
 #ifdef DEBUG_ROUTER
 # include "core/debug.h"
 # define printf  debug_printf
@@ -52,6 +60,11 @@
 uint8_t
 router_find_stack(uip_ipaddr_t *forwardip)
 {
+#ifdef UIP_ROUTE_SUPPORT
+  if (forwardip)
+    return route_lookup(forwardip, NULL);
+#endif
+
   uint8_t i;
 routing_input:
   for (i = 0; i < STACK_LEN; i++) {
@@ -84,7 +97,13 @@ routing_input:
 void
 router_input(uint8_t origin)
 {
+#ifdef CAPTURE_SUPPORT
+  if (uip_len > UIP_LLH_LEN)
+    capture_packet(uip_len - UIP_LLH_LEN);
+#endif
 #ifdef IPCHAIR_HAVE_PREROUTING
+  /* Let the chairs see which stack the packet came from. */
+  uip_stack_set_active(origin);
   ipchair_PREROUTING_chair();
   if(!uip_len) return;
 #endif
@@ -125,12 +144,22 @@ router_input(uint8_t origin)
       if (origin == dest)
 	goto drop;
 
-      if (-- BUF->ttl == 0)
+      /* The ICMP error quotes the header as received, so the TTL is
+	 only decremented if the packet is forwarded. */
+      if (BUF->ttl <= 1)
 	{
+#if !UIP_CONF_IPV6
+	  printf ("ttl exceeded, sending ICMP message.\n");
+	  uip_stack_set_active (origin);
+	  if (uip_icmp_error (ICMP_TIME_EXCEEDED, 0))
+	    router_output ();
+#else
 	  /* TODO send ICMP message */
 	  printf ("ttl exceeded, should send ICMP message.\n");
+#endif
 	  goto drop;
 	}
+      -- BUF->ttl;
 
 #ifdef IPCHAIR_HAVE_FORWARD
       ipchair_FORWARD_chair();
@@ -194,6 +223,9 @@ router_output_to (uint8_t dest)
   ipchair_POSTROUTING_chair();
   if(!uip_len) return 0;
 #endif
+#ifdef CAPTURE_SUPPORT
+  capture_packet(uip_len);
+#endif
 
   switch (dest)
     {
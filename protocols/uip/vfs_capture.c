@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* The capture ring as pcap file.
+ *
+ * The file is generated while it is read: the pcap header followed by
+ * a record header and the data of every stored packet.  Byte order is
+ * the one of the MCU, readers tell by the magic number.  Packets start
+ * with the IP header (link type "raw IP").  Capturing is held while
+ * the file is open, so httpd and TFTP may seek back for retransmits. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "core/periodic.h"
+#include "core/vfs/vfs.h"
+#include "uip_capture.h"
+
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_LINKTYPE_RAW 101
+
+struct pcap_header_t
+{
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct pcap_record_t
+{
+  uint32_t ts_sec;
+  uint32_t ts_usec;
+  uint32_t caplen;
+  uint32_t len;
+};
+
+union pcap_buf_t
+{
+  struct pcap_header_t file;
+  struct pcap_record_t record;
+};
+
+
+/* Find the part of the file at POS, set *DATA to it and return the
+ * number of bytes left in that part (0 at end of file).  Headers are
+ * built in HDR. */
+static uint16_t
+vfs_capture_part(vfs_size_t pos, union pcap_buf_t *hdr, const uint8_t ** data)
+{
+  if (pos < sizeof(struct pcap_header_t))
+  {
+    hdr->file.magic = PCAP_MAGIC;
+    hdr->file.version_major = 2;
+    hdr->file.version_minor = 4;
+    hdr->file.thiszone = 0;
+    hdr->file.sigfigs = 0;
+    hdr->file.snaplen = CONF_CAPTURE_SNAPLEN;
+    hdr->file.linktype = PCAP_LINKTYPE_RAW;
+    *data = (const uint8_t *) hdr + pos;
+    return sizeof(struct pcap_header_t) - pos;
+  }
+  pos -= sizeof(struct pcap_header_t);
+
+  struct capture_packet_t *p;
+  for (uint8_t i = 0; (p = capture_get(i)) != NULL; i++)
+  {
+    if (pos < sizeof(struct pcap_record_t))
+    {
+      hdr->record.ts_sec = p->time / HZ;
+      hdr->record.ts_usec = (p->time % HZ) * (1000000UL / HZ);
+      hdr->record.caplen = p->caplen;
+      hdr->record.len = p->len;
+      *data = (const uint8_t *) hdr + pos;
+      return sizeof(struct pcap_record_t) - pos;
+    }
+    pos -= sizeof(struct pcap_record_t);
+
+    if (pos < p->caplen)
+    {
+      *data = p->data + pos;
+      return p->caplen - pos;
+    }
+    pos -= p->caplen;
+  }
+
+  return 0;
+}
+
+
+struct vfs_file_handle_t *
+vfs_capture_open(const char *filename)
+{
+  if (strcmp_P(filename, PSTR(VFS_CAPTURE_NAME)))
+    return NULL;
+
+  struct vfs_file_handle_t *fh = malloc(sizeof(struct vfs_file_handle_t));
+  if (fh == NULL)
+    return NULL;
+
+  fh->fh_type = VFS_CAPTURE;
+  fh->u.capture.offset = 0;
+  capture_state.readers++;
+  return fh;
+}
+
+void
+vfs_capture_close(struct vfs_file_handle_t *fh)
+{
+  capture_state.readers--;
+  free(fh);
+}
+
+vfs_size_t
+vfs_capture_read(struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  vfs_size_t done = 0;
+
+  while (done < length)
+  {
+    union pcap_buf_t hdr;
+    const uint8_t *data;
+    uint16_t n = vfs_capture_part(fh->u.capture.offset, &hdr, &data);
+    if (n == 0)
+      break;                    /* End of file. */
+
+    if (n > length - done)
+      n = length - done;
+    memcpy((uint8_t *) buf + done, data, n);
+    fh->u.capture.offset += n;
+    done += n;
+  }
+
+  return done;
+}
+
+uint8_t
+vfs_capture_fseek(struct vfs_file_handle_t *fh, vfs_size_t offset,
+                  uint8_t whence)
+{
+  vfs_size_t size = vfs_capture_size(fh);
+  vfs_size_t new_pos;
+
+  switch (whence)
+  {
+    case SEEK_SET:
+      new_pos = offset;
+      break;
+
+    case SEEK_CUR:
+      new_pos = fh->u.capture.offset + offset;
+      break;
+
+    case SEEK_END:
+      new_pos = size + offset;
+      break;
+
+    default:
+      return -1;                /* Invalid argument. */
+  }
+
+  if (new_pos > size)
+    return -1;                  /* Beyond end of file. */
+
+  fh->u.capture.offset = new_pos;
+  return 0;
+}
+
+vfs_size_t
+vfs_capture_size(struct vfs_file_handle_t *fh)
+{
+  (void) fh;
+
+  vfs_size_t size = sizeof(struct pcap_header_t);
+  struct capture_packet_t *p;
+  for (uint8_t i = 0; (p = capture_get(i)) != NULL; i++)
+    size += sizeof(struct pcap_record_t) + p->caplen;
+  return size;
+}
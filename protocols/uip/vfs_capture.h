@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef VFS_CAPTURE_H
+#define VFS_CAPTURE_H
+
+/* The capture ring is read as this file. */
+#define VFS_CAPTURE_NAME "capture.pcap"
+
+typedef struct
+{
+  vfs_size_t offset;
+} vfs_file_handle_capture_t;
+
+struct vfs_file_handle_t *vfs_capture_open(const char *filename);
+void vfs_capture_close(struct vfs_file_handle_t *);
+vfs_size_t vfs_capture_read(struct vfs_file_handle_t *, void *buf,
+                            vfs_size_t length);
+uint8_t vfs_capture_fseek(struct vfs_file_handle_t *, vfs_size_t offset,
+                          uint8_t whence);
+vfs_size_t vfs_capture_size(struct vfs_file_handle_t *);
+
+#define VFS_CAPTURE_FUNCS {			\
+    "capture",					\
+    vfs_capture_open,				\
+    vfs_capture_close,				\
+    vfs_capture_read,				\
+    NULL,					\
+    vfs_capture_fseek,				\
+    NULL,					\
+    NULL,					\
+    NULL,					\
+    vfs_capture_size,				\
+  }
+
+#endif /* VFS_CAPTURE_H */
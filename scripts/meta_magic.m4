@@ -41,6 +41,7 @@ divert(0)dnl
 
 #include <stdint.h>
 #include "core/debug.h"
+#include "core/prof.h"
 #include "services/freqcount/freqcount.h"
 
 #if ARCH == ARCH_HOST
@@ -154,9 +155,32 @@ divert(-1)');
 define(`state_udp',`') dnl udp and tcp state is handled by meta_header_magic.m4
 define(`state_tcp', `')
 
+dnl
+dnl Profiling, see core/prof.c
+dnl
+dnl prof_wrap(func, call) - account the time spent in call to a slot
+dnl named func if PROF_SUPPORT is enabled
+define(`_prof_count', 0)
+define(`_prof_list', `')
+ifdef(`conf_PROF', `
+define(`prof_wrap', `pushdef(`_prof_divert', divnum)divert(prototypes)dnl
+static const char prof_name_`'_prof_count[] PROGMEM = "$1";
+divert(_prof_divert)popdef(`_prof_divert')dnl
+define(`_prof_list', defn(`_prof_list')`prof_name_'_prof_count`, ')dnl
+PROF_CALL(PROF_FIRST + _prof_count, $2)`'dnl
+define(`_prof_count', incr(_prof_count))')
+m4wrap(`divert(prototypes)
+PGM_P const prof_names[] PROGMEM = { _prof_list`'NULL };
+const uint8_t prof_generated = _prof_count;
+struct prof_entry_t prof_entries[PROF_FIRST + _prof_count];
+divert(-1)')
+', `
+define(`prof_wrap', `$2')
+')
+
 define(`mainloop',`dnl
 dnl divert(prototypes)void $1 (void);
-divert(mainloop_divert)    $1 (); wdt_kick ();
+divert(mainloop_divert)    prof_wrap(`$1', `$1 ()'); wdt_kick ();
 divert(-1)');
 
 dnl 
@@ -177,8 +201,9 @@ if (counter % $1 == 0) {
 timer_divert_end($1, `}
 ')dnl
 ')')
-define(`timer', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
+define(`_timer', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
 ')popdivert()')
+define(`timer', `_timer(`$1', `prof_wrap(patsubst(`$2', `(.*'), `$2')')')
 divert(timer_divert_base)
 void periodic_process(void)
 {
@@ -263,4 +288,4 @@ divert(eval(timer_divert_base`+'timer_divert_last` * 2 + 2'))
   }
 }
 divert(-1)
-timer(timer_divert_last, `counter = 0')
+_timer(timer_divert_last, `counter = 0')
@@ -165,7 +165,8 @@ define(`bsortkey', `millitimer_ival($2)')dnl
 dnl print_millitimer(func, startval, ival)
 dnl return a formatted static timer C array entry
 define(`print_millitimer',
-`pushdivert()divert(timer_divert_static_start)dnl
+`prof_name(`$1')dnl
+pushdivert()divert(timer_divert_static_start)dnl
 format(`    { %s, %d }, /* static timer */
 ', `$1', `$3')popdivert()dnl
 pushdivert()divert(timer_divert_static_control_start)dnl
@@ -238,6 +239,7 @@ dnl *** Start of meta.c contents ***
 
 #include <stdint.h>
 #include "core/debug.h"
+#include "core/prof.h"
 
 #if ARCH == ARCH_HOST
 #include <sys/time.h>
@@ -384,9 +386,37 @@ divert(-1)');
 define(`state_udp',`') dnl udp and tcp state is handled by meta_header_magic.m4
 define(`state_tcp', `')
 
+dnl
+dnl Profiling, see core/prof.c
+dnl
+dnl prof_name(func) - allocate the next slot, named func
+dnl prof_wrap(func, call) - account the time spent in call to a new slot
+dnl prof_table() - emit the slot names, the static timers follow the
+dnl mainloop functions in the order of scheduler_static_timers
+define(`_prof_count', 0)
+define(`_prof_list', `')
+ifdef(`conf_PROF', `
+define(`prof_name', `pushdef(`_prof_divert', divnum)divert(prototypes)dnl
+static const char prof_name_`'_prof_count[] PROGMEM = "$1";
+divert(_prof_divert)popdef(`_prof_divert')dnl
+define(`_prof_list', defn(`_prof_list')`prof_name_'_prof_count`, ')dnl
+define(`_prof_count', incr(_prof_count))')
+define(`prof_wrap', `PROF_CALL(PROF_FIRST + _prof_count, $2)prof_name(`$1')')
+define(`prof_table', `divert(prototypes)
+PGM_P const prof_names[] PROGMEM = { _prof_list`'NULL };
+const uint8_t prof_generated = _prof_count;
+const uint8_t prof_timer_base = PROF_FIRST + eval(_prof_count - array_get(`millitimer_array', size));
+struct prof_entry_t prof_entries[PROF_FIRST + _prof_count];
+divert(-1)')
+', `
+define(`prof_name', `')
+define(`prof_wrap', `$2')
+define(`prof_table', `')
+')
+
 define(`mainloop',`dnl
 dnl divert(prototypes)void $1 (void);
-divert(mainloop_divert)    $1 (); wdt_kick ();
+divert(mainloop_divert)    prof_wrap(`$1', `$1 ()'); wdt_kick ();
 divert(-1)');
 
 dnl last divert
@@ -479,5 +509,5 @@ divert(-1)dnl
 
 dnl
 dnl postprocess static timers after all files have been read
-m4wrap(`statictimer')
+m4wrap(`statictimer`'prof_table')
 
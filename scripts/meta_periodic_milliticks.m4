@@ -48,6 +48,7 @@ divert(preamble_divert)dnl
 #include "config.h"
 
 #include "core/periodic.h"
+#include "core/prof.h"
 
 #ifdef CLOCK_PERIODIC_SUPPORT
 #include "services/clock/clock.h"
@@ -73,6 +74,7 @@ static volatile uint8_t periodic_hz_tick;
 ISR(PERIODIC_VECTOR_OVERFLOW)
 {
   periodic_mticks_count++;
+  PROF_ISR_BEGIN();
   
 #if (CONF_MTICKS_PER_SEC > HZ)
   periodic_hz_tick++;
@@ -131,5 +133,6 @@ ISR(PERIODIC_VECTOR_OVERFLOW)
 divert(milliticks_isr_divert)dnl
 divert(postamble_divert)dnl
 
+  PROF_ISR_END(PROF_ISR_PERIODIC);
 }
 divert(-1)dnl
@@ -42,6 +42,7 @@
 #endif
 #include "core/debug.h"
 #include "core/periodic.h"
+#include "core/prof.h"
 #include "clock.h"
 
 #ifdef DEBUG_CLOCK
@@ -94,6 +95,8 @@ clock_init(void)
 #if defined(CLOCK_CRYSTAL_SUPPORT)
 ISR(TIMER_8_AS_1_VECTOR_OVERFLOW)
 {
+  PROF_ISR_BEGIN();
+
 #ifdef DCF77_SUPPORT
   dcf77_tick();
 #endif
@@ -110,6 +113,8 @@ ISR(TIMER_8_AS_1_VECTOR_OVERFLOW)
 
   if (sync_timestamp)
     sync_timestamp++;
+
+  PROF_ISR_END(PROF_ISR_CLOCK);
 }
 #endif
 
@@ -67,6 +67,15 @@ mcuf_modul(void)
 #define USE_UTC 1
 #define USE_LOCAL 0
 
+/* ECMD commands are bound with CRON_STATIC_ECMD, e.g.
+ *
+ *   CRON_STATIC_ECMD(light_on, io_set_port, "1 0x01")
+ *
+ * and the table entry
+ *
+ *   {{{{0, 7, -1, -1}}, -1}, cron_static_ecmd_light_on, USE_LOCAL},
+ */
+
 const struct cron_static_event_t events[] PROGMEM = {
 #ifdef MCUF_CLOCK_SUPPORT
   {{{{-1, -1, -1, -1}}, -1}, mcuf_clock, USE_LOCAL},    /* every minute  */
@@ -34,6 +34,24 @@ struct cron_static_event_t
   uint8_t use_utc;
 };
 
+#ifdef ECMD_PARSER_SUPPORT
+#include "protocols/ecmd/parser.h"
+#include "protocols/ecmd/via_tcp/ecmd_state.h"
+
+/* Define the handler cron_static_ecmd_ID calling the ECMD command NAME (the
+ * first argument of its ecmd_feature) with the string ARGS.  The handler is
+ * bound at build time, so neither the command table nor the command name
+ * have to be parsed when the job runs. */
+#define CRON_STATIC_ECMD(id, name, args)                                \
+  int16_t parse_cmd_##name(char *cmd, char *output, uint16_t len);      \
+  static void                                                           \
+  cron_static_ecmd_##id(void)                                           \
+  {                                                                     \
+    char output[ECMD_OUTPUTBUF_LENGTH];                                 \
+    ecmd_call_P(parse_cmd_##name, PSTR(args), output, sizeof(output));  \
+  }
+#endif /* ECMD_PARSER_SUPPORT */
+
 /* constants and global variables */
 
 /* prototypes */
@@ -53,7 +53,10 @@ httpd_handle_vfs_send_header (void)
 #ifndef VFS_TEENSY
     } else
 	goto no_gzip;
+#endif	/* not VFS_TEENSY */
 
+#if !defined(VFS_TEENSY) || defined(VFS_INLINE_PACKED_SUPPORT)
+    /* Packed inline images hold stored and LZ compressed files too. */
     if (buf[0] == 0x1f && buf[1] == 0x8b)
 #endif	/* not VFS_TEENSY, inlined files are always gzip'd */
 	PASTE_P (httpd_header_gzip);
@@ -84,6 +87,21 @@ no_gzip:
 static void
 httpd_handle_vfs_send_body (void)
 {
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    /* Continue behind the segments still in flight. */
+    uint16_t room = uip_window_room ();
+    if (room == 0)
+	return;
+
+    vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked + uip_unacked (),
+	       SEEK_SET);
+    vfs_size_t len = vfs_read (STATE->u.vfs.fd, uip_appdata, room);
+
+    if (len < room)		/* Short read -> EOF */
+	STATE->eof = 1;
+    if (len > 0)
+	uip_send (uip_appdata, len);
+#else	/* not UIP_TCP_WINDOW_SUPPORT */
     vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked, SEEK_SET);
     vfs_size_t len = vfs_read (STATE->u.vfs.fd, uip_appdata, uip_mss ());
 
@@ -98,11 +116,42 @@ httpd_handle_vfs_send_body (void)
 
     STATE->u.vfs.sent = STATE->u.vfs.acked + len;
     uip_send (uip_appdata, len);
+#endif	/* not UIP_TCP_WINDOW_SUPPORT */
 }
 
 void
 httpd_handle_vfs (void)
 {
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    uip_window_set (CONF_UIP_TCP_WINDOW_SEGMENTS);
+
+    /* uIP dropped everything in flight, start again at acked. */
+    if (uip_rexmit ())
+	STATE->eof = 0;
+
+    if (uip_acked ()) {
+	if (STATE->header_acked)
+	    STATE->u.vfs.acked += uip_acked_len ();
+	else if (!uip_unacked ()) {
+	    STATE->header_acked = 1;
+	    STATE->u.vfs.acked = 0;
+	}
+    }
+
+    /* The header goes out alone, the body follows once it is acked. */
+    if (!STATE->header_acked) {
+	if (!uip_unacked ())
+	    httpd_handle_vfs_send_header ();
+    }
+
+    else if (STATE->eof) {
+	if (!uip_unacked ())
+	    uip_close ();
+    }
+
+    else
+	httpd_handle_vfs_send_body ();
+#else	/* not UIP_TCP_WINDOW_SUPPORT */
     if (uip_acked ()) {
 	if (STATE->header_acked)
 	    STATE->u.vfs.acked = STATE->u.vfs.sent;
@@ -120,4 +169,5 @@ httpd_handle_vfs (void)
 
     else
 	httpd_handle_vfs_send_body ();
+#endif	/* not UIP_TCP_WINDOW_SUPPORT */
 }
@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Time series log of sensor values.
+ *
+ * The log file is a ring of CONF_SENSORLOG_BLOCKS blocks of
+ * CONF_SENSORLOG_BLOCK_SIZE bytes, each a header followed by records of
+ *   varint((seconds since the previous record) << 4 | source)
+ *   varint(zigzag(value - previous value of the source in this block))
+ * so every block can be decoded on its own.  The newest block is kept in
+ * RAM and only written when it is full or every CONF_SENSORLOG_SYNC
+ * minutes, the start times of all blocks are kept in RAM to find the
+ * blocks of a time range without reading the file. */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "config.h"
+#include "core/debug.h"
+#include "core/vfs/vfs.h"
+#include "services/clock/clock.h"
+#include "sensorlog.h"
+
+#ifdef SENSORLOG_DHT_SUPPORT
+#include "hardware/dht/dht.h"
+#endif
+#ifdef SENSORLOG_ONEWIRE_SUPPORT
+#include "hardware/onewire/onewire.h"
+#endif
+#ifdef SENSORLOG_ADC_SUPPORT
+#include "hardware/adc/adc.h"
+#endif
+#ifdef SENSORLOG_BMP280_SUPPORT
+#include "hardware/i2c/master/i2c_bmp280.h"
+#endif
+
+#if CONF_SENSORLOG_SOURCES > 16
+#error "sensorlog: at most 16 sources, the number is stored in four bits"
+#endif
+
+/* varint of the time delta and source (5 bytes) and of the value (3) */
+#define SENSORLOG_RECORD_MAX 8
+
+struct sensorlog_header_t
+{
+  uint32_t seq;
+  uint32_t start;               /* time of the first record */
+  uint16_t len;                 /* record bytes */
+};
+
+static struct
+{
+  struct sensorlog_header_t h;
+  uint8_t data[CONF_SENSORLOG_BLOCK_SIZE - sizeof(struct sensorlog_header_t)];
+} sensorlog_block;
+
+static uint32_t sensorlog_index[CONF_SENSORLOG_BLOCKS];
+static uint8_t sensorlog_cur;   /* block in sensorlog_block */
+static uint8_t sensorlog_used = 1;      /* blocks, including the current */
+static uint8_t sensorlog_dirty;
+static uint32_t sensorlog_time; /* of the last record */
+static int16_t sensorlog_last[CONF_SENSORLOG_SOURCES];
+#if CONF_SENSORLOG_SYNC > 0
+static uint16_t sensorlog_sync_countdown = CONF_SENSORLOG_SYNC * 60;
+#endif
+
+struct sensorlog_source_t sensorlog_sources[CONF_SENSORLOG_SOURCES];
+uint8_t sensorlog_source_count;
+struct sensorlog_query_t sensorlog_query;
+
+
+static uint8_t
+sensorlog_put_varint(uint8_t * p, uint32_t v)
+{
+  uint8_t n = 0;
+  while (v >= 0x80)
+  {
+    p[n++] = v | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+static uint8_t
+sensorlog_get_varint(const uint8_t * p, uint32_t * v)
+{
+  uint8_t n = 0;
+  *v = 0;
+  do
+    *v |= (uint32_t) (p[n] & 0x7f) << (7 * n);
+  while (p[n++] & 0x80 && n < 5);
+  return n;
+}
+
+/* Decode the record at P, update TIME and LAST, returns its length or 0
+   if it is broken. */
+static uint8_t
+sensorlog_decode(const uint8_t * p, uint32_t * time, int16_t * last,
+                 uint8_t * source)
+{
+  uint32_t v;
+  uint8_t n = sensorlog_get_varint(p, &v);
+  *time += v >> 4;
+  *source = v & 15;
+  if (*source >= CONF_SENSORLOG_SOURCES)
+    return 0;
+  n += sensorlog_get_varint(p + n, &v);
+  last[*source] += (int16_t) ((v >> 1) ^ -(v & 1));
+  return n;
+}
+
+static uint8_t
+sensorlog_read(uint8_t block, uint16_t offset, void *buf, uint16_t len)
+{
+  struct vfs_file_handle_t *fh = vfs_open(CONF_SENSORLOG_FILE);
+  if (fh == NULL)
+    return 0;
+  uint8_t ok = vfs_fseek(fh, (vfs_size_t) block * CONF_SENSORLOG_BLOCK_SIZE
+                         + offset, SEEK_SET) == 0
+    && vfs_read(fh, buf, len) > 0;
+  vfs_close(fh);
+  return ok;
+}
+
+void
+sensorlog_sync(void)
+{
+  if (!sensorlog_dirty)
+    return;
+
+  struct vfs_file_handle_t *fh = vfs_open(CONF_SENSORLOG_FILE);
+  if (fh == NULL)
+    fh = vfs_create(CONF_SENSORLOG_FILE);
+  if (fh == NULL)
+    return;
+
+  if (vfs_fseek(fh, (vfs_size_t) sensorlog_cur * CONF_SENSORLOG_BLOCK_SIZE,
+                SEEK_SET) == 0
+      && vfs_write(fh, &sensorlog_block, sizeof(sensorlog_block))
+      == sizeof(sensorlog_block))
+    sensorlog_dirty = 0;
+  else
+    debug_printf("sensorlog: writing block %u failed\n", sensorlog_cur);
+
+  vfs_close(fh);
+}
+
+static void
+sensorlog_begin_block(uint32_t time)
+{
+  if (sensorlog_block.h.len)
+  {
+    sensorlog_sync();
+    sensorlog_cur = (sensorlog_cur + 1) % CONF_SENSORLOG_BLOCKS;
+    if (sensorlog_used < CONF_SENSORLOG_BLOCKS)
+      sensorlog_used++;
+    sensorlog_block.h.seq++;
+    sensorlog_block.h.len = 0;
+    memset(sensorlog_block.data, 0, sizeof(sensorlog_block.data));
+  }
+
+  sensorlog_block.h.start = sensorlog_time = sensorlog_index[sensorlog_cur] =
+    time;
+  memset(sensorlog_last, 0, sizeof(sensorlog_last));
+}
+
+void
+sensorlog_append(uint8_t source, uint32_t time, int16_t value)
+{
+  /* a new block on a full one and when the clock went back */
+  if (sensorlog_block.h.len == 0 || time < sensorlog_time
+      || time - sensorlog_time > 0x0fffffffUL
+      || sensorlog_block.h.len + SENSORLOG_RECORD_MAX >
+      sizeof(sensorlog_block.data))
+    sensorlog_begin_block(time);
+
+  int32_t d = (int32_t) value - sensorlog_last[source];
+  uint8_t *p = sensorlog_block.data + sensorlog_block.h.len;
+  p += sensorlog_put_varint(p, (time - sensorlog_time) << 4 | source);
+  p += sensorlog_put_varint(p, ((uint32_t) d << 1) ^ (uint32_t) (d >> 31));
+
+  sensorlog_block.h.len = p - sensorlog_block.data;
+  sensorlog_time = time;
+  sensorlog_last[source] = value;
+  sensorlog_dirty = 1;
+}
+
+void
+sensorlog_clear(void)
+{
+  vfs_unlink(CONF_SENSORLOG_FILE);
+  sensorlog_cur = 0;
+  sensorlog_used = 1;
+  sensorlog_dirty = 0;
+  sensorlog_block.h.seq = 0;
+  sensorlog_block.h.len = 0;
+  sensorlog_query.ticket++;     /* end a running query */
+}
+
+uint8_t
+sensorlog_query_start(uint32_t from, uint32_t to)
+{
+  struct sensorlog_query_t *q = &sensorlog_query;
+  uint8_t oldest = sensorlog_used < CONF_SENSORLOG_BLOCKS ? 0 :
+    (sensorlog_cur + 1) % CONF_SENSORLOG_BLOCKS;
+
+  q->from = from;
+  q->to = to;
+  q->block = (oldest + CONF_SENSORLOG_BLOCKS - 1) % CONF_SENSORLOG_BLOCKS;
+  q->blocks = sensorlog_used;
+  q->offset = q->len = 0;
+  return ++q->ticket;
+}
+
+/* Enter the next block, returns 0 if it is to be skipped. */
+static uint8_t
+sensorlog_query_enter(struct sensorlog_query_t *q)
+{
+  q->blocks--;
+  q->block = (q->block + 1) % CONF_SENSORLOG_BLOCKS;
+
+  /* skip blocks starting after TO and those the next block starts after
+     before FROM */
+  uint32_t start = sensorlog_index[q->block];
+  uint32_t next = sensorlog_index[(q->block + 1) % CONF_SENSORLOG_BLOCKS];
+  if (start > q->to || (q->blocks && next >= start && next < q->from))
+    return 0;
+
+  if (q->block == sensorlog_cur)
+  {
+    q->time = sensorlog_block.h.start;
+    q->len = sensorlog_block.h.len;
+  }
+  else
+  {
+    struct sensorlog_header_t h;
+    if (!sensorlog_read(q->block, 0, &h, sizeof(h))
+        || h.len > sizeof(sensorlog_block.data))
+      return 0;
+    q->time = h.start;
+    q->len = h.len;
+  }
+  q->offset = 0;
+  q->buf_offset = UINT16_MAX;
+  memset(q->last, 0, sizeof(q->last));
+  return 1;
+}
+
+int8_t
+sensorlog_query_next(uint8_t ticket, uint32_t * time, uint8_t * source,
+                     int16_t * value)
+{
+  struct sensorlog_query_t *q = &sensorlog_query;
+  if (ticket != q->ticket)
+    return -1;
+
+  for (;;)
+  {
+    if (q->offset >= q->len)
+    {
+      if (q->blocks == 0)
+        return 0;
+      if (!sensorlog_query_enter(q))
+        q->len = 0;
+      continue;
+    }
+
+    const uint8_t *p;
+    if (q->block == sensorlog_cur)
+      p = sensorlog_block.data + q->offset;
+    else
+    {
+      if (q->buf_offset == UINT16_MAX || q->offset < q->buf_offset
+          || q->offset + SENSORLOG_RECORD_MAX > q->buf_offset + sizeof(q->buf))
+      {
+        q->buf_offset = q->offset;
+        if (!sensorlog_read(q->block, sizeof(struct sensorlog_header_t)
+                            + q->offset, q->buf, sizeof(q->buf)))
+        {
+          q->len = 0;
+          continue;
+        }
+      }
+      p = q->buf + (q->offset - q->buf_offset);
+    }
+
+    uint8_t n = sensorlog_decode(p, &q->time, q->last, source);
+    if (n == 0)
+    {
+      q->len = 0;               /* broken, skip the rest of the block */
+      continue;
+    }
+    q->offset += n;
+
+    if (q->time < q->from)
+      continue;
+    if (q->time > q->to)
+    {
+      q->len = 0;
+      continue;
+    }
+
+    *time = q->time;
+    *value = q->last[*source];
+    return 1;
+  }
+}
+
+int8_t
+sensorlog_register(PGM_P name, sensorlog_read_t read, uint8_t arg,
+                   uint16_t interval)
+{
+  if (sensorlog_source_count >= CONF_SENSORLOG_SOURCES || interval == 0)
+    return -1;
+
+  struct sensorlog_source_t *s = &sensorlog_sources[sensorlog_source_count];
+  s->name = name;
+  s->read = read;
+  s->arg = arg;
+  s->interval = s->countdown = interval;
+  return sensorlog_source_count++;
+}
+
+
+#ifdef SENSORLOG_DHT_SUPPORT
+static const char PROGMEM sensorlog_name_dht_temp[] = "dht_temp";
+static const char PROGMEM sensorlog_name_dht_humid[] = "dht_humid";
+
+static int8_t
+sensorlog_read_dht_temp(uint8_t arg, int16_t * value)
+{
+  *value = dht_sensors[arg].temp;
+  return 0;
+}
+
+static int8_t
+sensorlog_read_dht_humid(uint8_t arg, int16_t * value)
+{
+  *value = dht_sensors[arg].humid;
+  return 0;
+}
+#endif /* SENSORLOG_DHT_SUPPORT */
+
+#ifdef SENSORLOG_ONEWIRE_SUPPORT
+static const char PROGMEM sensorlog_name_ow[] = "ow";
+
+static int8_t
+sensorlog_read_ow(uint8_t arg, int16_t * value)
+{
+  if (!ow_sensors[arg].present || ow_sensors[arg].conv_error)
+    return -1;
+  /* The driver keeps centidegrees for precise sensors, log decidegrees */
+  ow_temp_t temp = ow_sensors[arg].temp;
+  *value = temp.twodigits ? temp.val / 10 : temp.val;
+  return 0;
+}
+#endif /* SENSORLOG_ONEWIRE_SUPPORT */
+
+#ifdef SENSORLOG_ADC_SUPPORT
+static const char PROGMEM sensorlog_name_adc[] = "adc";
+
+static int8_t
+sensorlog_read_adc(uint8_t arg, int16_t * value)
+{
+  *value = adc_get(arg);
+  return 0;
+}
+#endif /* SENSORLOG_ADC_SUPPORT */
+
+#ifdef SENSORLOG_BMP280_SUPPORT
+static const char PROGMEM sensorlog_name_bmp280_temp[] = "bmp280_temp";
+static const char PROGMEM sensorlog_name_bmp280_press[] = "bmp280_press";
+
+static int8_t
+sensorlog_read_bmp280_temp(uint8_t arg, int16_t * value)
+{
+  return i2c_bmp280_get_temp(value) < 0 ? -1 : 0;
+}
+
+static int8_t
+sensorlog_read_bmp280_press(uint8_t arg, int16_t * value)
+{
+  return i2c_bmp280_get_press((uint16_t *) value) < 0 ? -1 : 0;
+}
+#endif /* SENSORLOG_BMP280_SUPPORT */
+
+
+void
+sensorlog_init(void)
+{
+#ifdef SENSORLOG_DHT_SUPPORT
+  for (uint8_t i = 0; i < dht_sensors_count; i++)
+  {
+    sensorlog_register(sensorlog_name_dht_temp, sensorlog_read_dht_temp, i,
+                       CONF_SENSORLOG_INTERVAL);
+    sensorlog_register(sensorlog_name_dht_humid, sensorlog_read_dht_humid, i,
+                       CONF_SENSORLOG_INTERVAL);
+  }
+#endif
+#ifdef SENSORLOG_ONEWIRE_SUPPORT
+  for (uint8_t i = 0; i < CONF_SENSORLOG_ONEWIRE_COUNT && i < OW_SENSORS_COUNT;
+       i++)
+    sensorlog_register(sensorlog_name_ow, sensorlog_read_ow, i,
+                       CONF_SENSORLOG_INTERVAL);
+#endif
+#ifdef SENSORLOG_ADC_SUPPORT
+  for (uint8_t i = 0; i < CONF_SENSORLOG_ADC_CHANNELS; i++)
+    sensorlog_register(sensorlog_name_adc, sensorlog_read_adc, i,
+                       CONF_SENSORLOG_INTERVAL);
+#endif
+#ifdef SENSORLOG_BMP280_SUPPORT
+  sensorlog_register(sensorlog_name_bmp280_temp, sensorlog_read_bmp280_temp,
+                     0, CONF_SENSORLOG_INTERVAL);
+  sensorlog_register(sensorlog_name_bmp280_press, sensorlog_read_bmp280_press,
+                     0, CONF_SENSORLOG_INTERVAL);
+#endif
+
+  /* rebuild the index from the block headers and continue the newest */
+  struct vfs_file_handle_t *fh = vfs_open(CONF_SENSORLOG_FILE);
+  if (fh == NULL)
+    return;
+
+  vfs_size_t blocks = vfs_size(fh) / CONF_SENSORLOG_BLOCK_SIZE;
+  if (blocks > CONF_SENSORLOG_BLOCKS)
+    blocks = CONF_SENSORLOG_BLOCKS;
+
+  uint8_t found = 0;
+  for (uint8_t i = 0; i < blocks; i++)
+  {
+    struct sensorlog_header_t h;
+    if (vfs_fseek(fh, (vfs_size_t) i * CONF_SENSORLOG_BLOCK_SIZE,
+                  SEEK_SET) != 0 || vfs_read(fh, &h, sizeof(h)) != sizeof(h))
+      break;
+    sensorlog_index[i] = h.start;
+    if (!found || h.seq > sensorlog_block.h.seq)
+    {
+      sensorlog_block.h.seq = h.seq;
+      sensorlog_cur = i;
+      found = 1;
+    }
+  }
+
+  if (found
+      && vfs_fseek(fh, (vfs_size_t) sensorlog_cur * CONF_SENSORLOG_BLOCK_SIZE,
+                   SEEK_SET) == 0
+      && vfs_read(fh, &sensorlog_block, sizeof(sensorlog_block))
+      == sizeof(sensorlog_block)
+      && sensorlog_block.h.len <= sizeof(sensorlog_block.data))
+  {
+    sensorlog_used = blocks;
+
+    /* last time and values to append to */
+    uint32_t time = sensorlog_block.h.start;
+    uint16_t offset = 0;
+    while (offset < sensorlog_block.h.len)
+    {
+      uint8_t source;
+      uint8_t n = sensorlog_decode(sensorlog_block.data + offset, &time,
+                                   sensorlog_last, &source);
+      if (n == 0)
+        break;
+      offset += n;
+    }
+    sensorlog_block.h.len = offset;
+    sensorlog_time = time;
+    debug_printf("sensorlog: %u blocks, continuing block %u\n",
+                 (uint8_t) blocks, sensorlog_cur);
+  }
+  else
+    sensorlog_block.h.len = 0;
+
+  vfs_close(fh);
+}
+
+void
+sensorlog_periodic(void)
+{
+  uint32_t now = clock_get_time();
+
+  for (uint8_t i = 0; i < sensorlog_source_count; i++)
+  {
+    struct sensorlog_source_t *s = &sensorlog_sources[i];
+    if (--s->countdown)
+      continue;
+    s->countdown = s->interval;
+
+    int16_t value;
+    if (s->read(s->arg, &value) == 0)
+      sensorlog_append(i, now, value);
+  }
+
+#if CONF_SENSORLOG_SYNC > 0
+  if (--sensorlog_sync_countdown == 0)
+  {
+    sensorlog_sync_countdown = CONF_SENSORLOG_SYNC * 60;
+    sensorlog_sync();
+  }
+#endif
+}
+
+/*
+  -- Ethersex META --
+  header(services/sensorlog/sensorlog.h)
+  init(sensorlog_init)
+  timer(50, sensorlog_periodic())
+*/
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef SENSORLOG_H
+#define SENSORLOG_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "config.h"
+
+/* Read the value of the source ARG to VALUE, returns 0 on success. */
+typedef int8_t (*sensorlog_read_t) (uint8_t arg, int16_t * value);
+
+struct sensorlog_source_t
+{
+  PGM_P name;
+  sensorlog_read_t read;
+  uint8_t arg;
+  uint16_t interval;            /* in seconds */
+  uint16_t countdown;
+};
+
+extern struct sensorlog_source_t sensorlog_sources[];
+extern uint8_t sensorlog_source_count;
+
+/* State of a time range query, only one can be active at a time. */
+struct sensorlog_query_t
+{
+  uint8_t ticket;
+  uint8_t block;
+  uint8_t blocks;               /* blocks left after this one */
+  uint16_t offset;              /* next record in the block */
+  uint16_t len;                 /* record bytes in the block */
+  uint32_t time;
+  uint32_t from, to;
+  int16_t last[CONF_SENSORLOG_SOURCES];
+  uint16_t buf_offset;          /* block offset of buf, UINT16_MAX if empty */
+  uint8_t buf[32];
+};
+
+extern struct sensorlog_query_t sensorlog_query;
+
+/* Add a source sampled every INTERVAL seconds, returns its number or -1
+   if there are CONF_SENSORLOG_SOURCES already or INTERVAL is 0.  The number is stored in
+   the log, so sources have to be registered in the same order on each
+   start. */
+int8_t sensorlog_register(PGM_P name, sensorlog_read_t read, uint8_t arg,
+                          uint16_t interval);
+
+/* Append a sample of SOURCE taken at TIME. */
+void sensorlog_append(uint8_t source, uint32_t time, int16_t value);
+
+/* Write the current block to the log file. */
+void sensorlog_sync(void);
+
+/* Remove the log file and start over. */
+void sensorlog_clear(void);
+
+/* Start a query of the samples from FROM to TO (inclusive), returns the
+   ticket of the query. */
+uint8_t sensorlog_query_start(uint32_t from, uint32_t to);
+
+/* Return the next sample of the query TICKET, 1 if there is one, 0 at
+   the end and -1 if another query took over. */
+int8_t sensorlog_query_next(uint8_t ticket, uint32_t * time,
+                            uint8_t * source, int16_t * value);
+
+void sensorlog_init(void);
+void sensorlog_periodic(void);
+
+#endif /* SENSORLOG_H */
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2017 by the Ethersex developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "sensorlog.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+typedef struct
+{
+  uint8_t magic;
+  uint8_t ticket;
+  uint8_t json;
+  uint8_t first;
+} sensorlog_get_state_t;
+
+typedef struct
+{
+  uint8_t magic;
+  uint8_t slot;
+} sensorlog_sources_state_t;
+
+int16_t
+parse_cmd_sensorlog_get(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  sensorlog_get_state_t *state = (sensorlog_get_state_t *) cmd;
+  if (state->magic != ECMD_STATE_MAGIC)
+  {
+    uint32_t from = 0, to = UINT32_MAX;
+    uint8_t json = 0;
+
+    char *p = cmd;
+    while (*p == ' ')
+      p++;
+    if (*p >= '0' && *p <= '9')
+    {
+      from = strtoul(p, &p, 10);
+      while (*p == ' ')
+        p++;
+      if (*p >= '0' && *p <= '9')
+        to = strtoul(p, &p, 10);
+      while (*p == ' ')
+        p++;
+    }
+    if (strncmp_P(p, PSTR("json"), 4) == 0)
+    {
+      json = 1;
+      p += 4;
+    }
+    if (*p)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = ECMD_STATE_MAGIC;
+    state->ticket = sensorlog_query_start(from, to);
+    state->json = json;
+    state->first = 1;
+  }
+
+  uint32_t time;
+  uint8_t source;
+  int16_t value;
+  int8_t ret = sensorlog_query_next(state->ticket, &time, &source, &value);
+  if (ret < 0)
+    return ECMD_ERR_READ_ERROR; /* another query took over */
+
+  if (ret == 0)
+  {
+    if (!state->json)
+      return ECMD_FINAL_OK;
+    return ECMD_FINAL(snprintf_P(output, len, state->first ?
+                                 PSTR("[]") : PSTR("]")));
+  }
+
+  PGM_P name = sensorlog_sources[source].name;
+  uint8_t arg = sensorlog_sources[source].arg;
+  len = state->json ?
+    snprintf_P(output, len, PSTR("%c{\"t\":%lu,\"s\":\"%S%u\",\"v\":%d}"),
+               state->first ? '[' : ',', time, name, arg, value) :
+    snprintf_P(output, len, PSTR("%lu,%S%u,%d"), time, name, arg, value);
+  state->first = 0;
+  return ECMD_AGAIN(len);
+}
+
+int16_t
+parse_cmd_sensorlog_sources(char *cmd, char *output, uint16_t len)
+{
+  /* use bytes on cmd as "connection specific static variables" */
+  sensorlog_sources_state_t *state = (sensorlog_sources_state_t *) cmd;
+  if (state->magic != ECMD_STATE_MAGIC)
+  {
+    while (*cmd == ' ')
+      cmd++;
+    if (*cmd)
+      return ECMD_ERR_PARSE_ERROR;
+
+    state->magic = ECMD_STATE_MAGIC;
+    state->slot = 0;
+  }
+
+  if (state->slot >= sensorlog_source_count)
+    return ECMD_FINAL_OK;
+
+  struct sensorlog_source_t *s = &sensorlog_sources[state->slot++];
+  return ECMD_AGAIN(snprintf_P(output, len, PSTR("%S%u %u"), s->name,
+                               s->arg, s->interval));
+}
+
+int16_t
+parse_cmd_sensorlog_sync(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  sensorlog_sync();
+  return ECMD_FINAL_OK;
+}
+
+int16_t
+parse_cmd_sensorlog_clear(char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+  (void) output;
+  (void) len;
+
+  sensorlog_clear();
+  return ECMD_FINAL_OK;
+}
+
+/*
+  -- Ethersex META --
+  block([[Sensor_Log]])
+  ecmd_feature(sensorlog_get, "sensorlog get", [FROM [TO]] [json], Samples from FROM to TO (unix time) as time,source,value lines or as JSON array.)
+  ecmd_feature(sensorlog_sources, "sensorlog sources",, List the logged sources and their interval in seconds.)
+  ecmd_feature(sensorlog_sync, "sensorlog sync",, Write the current block to the log file.)
+  ecmd_feature(sensorlog_clear, "sensorlog clear",, Delete the log.)
+*/
@@ -247,6 +247,10 @@ stella_getFadestep(void)
 void
 stella_loadFromEEROMFading(void)
 {
+#ifdef EEPROM_WEAR_SUPPORT
+  if (eeprom_wear_restore(stella_channel_values, stella_fade, STELLA_CHANNELS))
+    return;
+#endif
   eeprom_restore(stella_channel_values, stella_fade, STELLA_CHANNELS);
 }
 #endif
@@ -255,7 +259,7 @@ stella_loadFromEEROMFading(void)
 void
 stella_loadFromEEROM(void)
 {
-  eeprom_restore(stella_channel_values, stella_fade, STELLA_CHANNELS);
+  stella_loadFromEEROMFading();
   memcpy(stella_brightness, stella_fade, STELLA_CHANNELS);
   stella_sync = UPDATE_VALUES;
 }
@@ -265,8 +269,12 @@ stella_loadFromEEROM(void)
 void
 stella_storeToEEROM(void)
 {
+#ifdef EEPROM_WEAR_SUPPORT
+  eeprom_wear_save(stella_channel_values, stella_brightness, STELLA_CHANNELS);
+#else
   eeprom_save(stella_channel_values, stella_brightness, STELLA_CHANNELS);
   eeprom_update_chksum();
+#endif
 }
 #endif
 
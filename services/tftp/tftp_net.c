@@ -75,7 +75,7 @@ tftp_net_main(void)
         if (req_conn->rport != HTONS(TFTP_PORT))
           continue;
 
-        req_conn->lport = 0;    /* clear connection */
+        uip_udp_remove(req_conn);    /* clear connection */
         break;
       }
     }
@@ -61,6 +61,9 @@ static uint8_t wa_bufpin; // pin of bufferposition to send
 #else // def CONF_WATCHASYNC_SUMMARIZE
 static uint8_t wa_buffer_left = 0; 	// last position sent
 static uint8_t wa_buffer_right = 0; 	// last position set
+#ifdef CONF_WATCHASYNC_BATCH
+static uint8_t wa_buffer_sent = 0; 	// last position of the request in flight
+#endif // def CONF_WATCHASYNC_BATCH
 #endif // def CONF_WATCHASYNC_SUMMARIZE
 
 static uint8_t wa_sendstate = 0; 		// 0: Idle, 1: Message being sent, 2: Sending message failed
@@ -87,23 +90,42 @@ void addToRingbuffer(int pin)
         wa_buffer[tempright].pin[pin] ++;
     }
 #else // def CONF_WATCHASYNC_SUMMARIZE
-    tempright = ((wa_buffer_right + 1) % CONF_WATCHASYNC_BUFFERSIZE);  // calculate next position in ringbuffer
-    if (tempright != wa_buffer_left)  // if ringbuffer not full
-    {
-        wa_buffer_right = tempright;  // select next space in ringbuffer
-        wa_buffer[wa_buffer_right].pin = pin;  // set pin in ringbuffer
 #ifdef CONF_WATCHASYNC_TIMESTAMP
 #if CONF_WATCHASYNC_RESOLUTION > 1
-//        wa_buffer[wa_buffer_right].timestamp = ( clock_get_time() / CONF_WATCHASYNC_RESOLUTION ) * CONF_WATCHASYNC_RESOLUTION;  // add timestamp in ringbuffer
 #ifdef CONF_WATCHASYNC_SENDEND
-	wa_buffer[wa_buffer_right].timestamp = clock_get_time() & ( (uint32_t) (-1 * CONF_WATCHASYNC_RESOLUTION )) + CONF_WATCHASYNC_RESOLUTION; // add timestamp in ringbuffer
+    uint32_t timestamp = clock_get_time() & ( (uint32_t) (-1 * CONF_WATCHASYNC_RESOLUTION )) + CONF_WATCHASYNC_RESOLUTION;
 #else // def CONF_WATCHASYNC_SENDEND
-	wa_buffer[wa_buffer_right].timestamp = clock_get_time() & ( (uint32_t) (-1 * CONF_WATCHASYNC_RESOLUTION )); // add timestamp in ringbuffer
+    uint32_t timestamp = clock_get_time() & ( (uint32_t) (-1 * CONF_WATCHASYNC_RESOLUTION ));
 #endif // def CONF_WATCHASYNC_SENDEND
 #else // CONF_WATCHASYNC_RESOLUTION > 1
-        wa_buffer[wa_buffer_right].timestamp = clock_get_time();  // add timestamp in ringbuffer
+    uint32_t timestamp = clock_get_time();
 #endif // CONF_WATCHASYNC_RESOLUTION > 1
 #endif // def CONF_WATCHASYNC_TIMESTAMP
+#ifdef CONF_WATCHASYNC_BATCH
+    // count the event on an entry of the same pin and timestamp, looking back
+    // over the newest entries that are not part of the request in flight
+    for (tempright = wa_buffer_right;
+         tempright != wa_buffer_sent && wa_buffer[tempright].timestamp == timestamp;
+         tempright = (tempright + CONF_WATCHASYNC_BUFFERSIZE - 1) % CONF_WATCHASYNC_BUFFERSIZE)
+    {
+        if (wa_buffer[tempright].pin == pin && wa_buffer[tempright].count != 255)
+        {
+            wa_buffer[tempright].count ++;
+            return;
+        }
+    }
+#endif // def CONF_WATCHASYNC_BATCH
+    tempright = ((wa_buffer_right + 1) % CONF_WATCHASYNC_BUFFERSIZE);  // calculate next position in ringbuffer
+    if (tempright != wa_buffer_left)  // if ringbuffer not full
+    {
+        wa_buffer_right = tempright;  // select next space in ringbuffer
+        wa_buffer[wa_buffer_right].pin = pin;  // set pin in ringbuffer
+#ifdef CONF_WATCHASYNC_TIMESTAMP
+        wa_buffer[wa_buffer_right].timestamp = timestamp;  // add timestamp in ringbuffer
+#endif // def CONF_WATCHASYNC_TIMESTAMP
+#ifdef CONF_WATCHASYNC_BATCH
+        wa_buffer[wa_buffer_right].count = 1;
+#endif // def CONF_WATCHASYNC_BATCH
     }
 #endif // def CONF_WATCHASYNC_SUMMARIZE
 }
@@ -655,6 +677,68 @@ ISR(PCINT3_vect)
 /// Send Data
 ////////////////////////////////////////////////////////////
 
+#ifdef CONF_WATCHASYNC_BATCH
+// Build a request carrying the events after wa_buffer_left as
+//   [{"uuid":"<id>","tuples":[[<timestamp>,<count>],...]},...]
+// with one object per pin.  Takes as many events as fit into one segment,
+// at most *records if that is not 0, and returns the number taken in
+// *records, so a retransmission is identical.
+static uint16_t watchasync_batch_request(uint8_t *records)
+{
+  // head, room for the content length and "[]"
+  uint16_t size = sizeof(watchasync_batch_head) - 1 + 9 + 2;
+  uint32_t pins = 0;
+  uint8_t n = 0;
+  uint8_t pos = wa_buffer_left;
+  while (pos != wa_buffer_sent && (*records == 0 || n < *records))
+  {
+    pos = (pos + 1) % CONF_WATCHASYNC_BUFFERSIZE;
+    uint8_t pin = wa_buffer[pos].pin;
+    uint16_t need = 17;  // [4294967295,255],
+    if (!(pins & ((uint32_t) 1 << pin)))  // {"uuid":"<id>","tuples":[]},
+      need += 24 + strlen_P((PGM_P) pgm_read_word(&(watchasync_ID[pin])));
+    if (size + need > uip_mss())
+      break;
+    size += need;
+    pins |= (uint32_t) 1 << pin;
+    n++;
+  }
+  *records = n;
+
+  char *p = uip_appdata;
+  p += sprintf_P(p, watchasync_batch_head);
+  char *length = p;
+  p += sprintf_P(p, PSTR("     \r\n\r\n"));
+  char *body = p;
+  *p++ = '[';
+  for (uint8_t pin = 0; pin < WATCHASYNC_PINCOUNT; pin++)
+  {
+    if (!(pins & ((uint32_t) 1 << pin)))
+      continue;
+    if (p[-1] != '[')
+      *p++ = ',';
+    p += sprintf_P(p, PSTR("{\"uuid\":\"%S\",\"tuples\":["), (PGM_P) pgm_read_word(&(watchasync_ID[pin])));
+    pos = wa_buffer_left;
+    for (uint8_t i = 0; i < n; i++)
+    {
+      pos = (pos + 1) % CONF_WATCHASYNC_BUFFERSIZE;
+      if (wa_buffer[pos].pin != pin)
+        continue;
+      if (p[-1] != '[')
+        *p++ = ',';
+      p += sprintf_P(p, PSTR("[%lu,%u]"), wa_buffer[pos].timestamp, wa_buffer[pos].count);
+    }
+    p += sprintf_P(p, PSTR("]}"));
+  }
+  *p++ = ']';
+
+  sprintf_P(length, PSTR("%5u"), (uint16_t) (p - body));  // padding is whitespace allowed after the colon
+  length[5] = '\r';  // overwritten by the terminating zero
+
+  return p - (char *) uip_appdata;
+}
+#endif // def CONF_WATCHASYNC_BATCH
+
 static void watchasync_net_main(void)  // Network-routine called by networkstack 
 {
   if (uip_aborted() || uip_timedout() || uip_closed() ) // Connection aborted or timedout
@@ -683,6 +767,19 @@ static void watchasync_net_main(void)  // Network-routine called by networkstack
 
   if (uip_connected() || uip_rexmit()) { // (re-)transmit packet
     WATCHASYNC_DEBUG ("new connection or rexmit, sending message\n");
+#ifdef CONF_WATCHASYNC_BATCH
+    uint16_t len = watchasync_batch_request(&uip_conn->appstate.watchasync.records);
+    if (uip_conn->appstate.watchasync.records == 0)  // nothing to send or not even one event fits the segment
+    {
+      wa_sendstate = wa_buffer_left == wa_buffer_right ? 0 : 2;  // don't send an empty request
+      uip_conn->appstate.watchasync.state = WATCHASYNC_CONNSTATE_OLD;
+      uip_abort();
+      WATCHASYNC_DEBUG ("no event fits into %u bytes, aborting\n", uip_mss());
+      return;
+    }
+    uip_udp_send(len);
+    WATCHASYNC_DEBUG ("send %u events in %u bytes\n", uip_conn->appstate.watchasync.records, len);
+#else // def CONF_WATCHASYNC_BATCH
     char *p = uip_appdata;  // pointer set to uip_appdata, used to store string
     p += sprintf_P(p, watchasync_path);  // copy path from programm memory to appdata
 #ifdef CONF_WATCHASYNC_SUMMARIZE
@@ -707,12 +804,17 @@ static void watchasync_net_main(void)  // Network-routine called by networkstack
     uip_udp_send(p - (char *)uip_appdata);
 
     WATCHASYNC_DEBUG ("send %d bytes\n", p - (char *)uip_appdata);
+#endif // def CONF_WATCHASYNC_BATCH
   }
 
   if (uip_acked()) // Send packet acked, 
   {
     if (uip_conn->appstate.watchasync.state == WATCHASYNC_CONNSTATE_NEW) // If packet is still new
     {
+#ifdef CONF_WATCHASYNC_BATCH
+      wa_buffer_left = (wa_buffer_left + uip_conn->appstate.watchasync.records) % CONF_WATCHASYNC_BUFFERSIZE;  // drop the events sent
+      wa_buffer_sent = wa_buffer_left;
+#endif // def CONF_WATCHASYNC_BATCH
 #ifndef CONF_WATCHASYNC_SUMMARIZE
       wa_sendstate = 0;  // Mark event as sent, go ahead in buffer
 #endif      
@@ -733,6 +835,9 @@ static void watchasync_dns_query_cb(char *name, uip_ipaddr_t *ipaddr)  // Callba
   if(conn)  // if connection succesfully created
   {
     conn->appstate.watchasync.state = WATCHASYNC_CONNSTATE_NEW; // Set connection state to new, as data still has to be send
+#ifdef CONF_WATCHASYNC_BATCH
+    conn->appstate.watchasync.records = 0;
+#endif // def CONF_WATCHASYNC_BATCH
 #ifdef CONF_WATCHASYNC_SUMMARIZE
 #if CONF_WATCHASYNC_RESOLUTION > 1
 //    conn->appstate.watchasync.timestamp = (clock_get_time() & (uint32_t) (-1 * CONF_WATCHASYNC_BUFFERSIZE * CONF_WATCHASYNC_RESOLUTION)) + wa_buf * CONF_WATCHASYNC_RESOLUTION;
@@ -859,15 +964,30 @@ void watchasync_mainloop(void)  // Mainloop routine poll ringsbuffer
     if (wa_sendstate == 2) // Message not sent successfully
     {
       WATCHASYNC_DEBUG ("error, again please...\n"); 
+#ifdef CONF_WATCHASYNC_BATCH
+      wa_buffer_sent = wa_buffer_right; // take the events meanwhile along
+      if (wa_buffer_left == wa_buffer_right)  // nothing left to send
+        wa_sendstate = 0;
+      else
+#endif // def CONF_WATCHASYNC_BATCH
       sendmessage();   // resend current event
     } else // sendstate == 0 => Idle  // Previous send has been succesfull, send next event if any
     {
+#ifdef CONF_WATCHASYNC_BATCH
+      if (wa_buffer_left != wa_buffer_right) // there is something in the buffer
+      {
+        wa_buffer_sent = wa_buffer_right; // events up to here go into the request, new ones start a new entry
+        WATCHASYNC_DEBUG ("starting transmission: L: %u R: %u\n", wa_buffer_left, wa_buffer_right);
+        sendmessage();  // send all events
+      }
+#else // def CONF_WATCHASYNC_BATCH
       if (wa_buffer_left != wa_buffer_right) // there is something in the buffer
       {
         wa_buffer_left = ((wa_buffer_left + 1) % CONF_WATCHASYNC_BUFFERSIZE); // calculate next place in buffer
         WATCHASYNC_DEBUG ("starting transmission: L: %u R: %u Pin: %u\n", wa_buffer_left, wa_buffer_right, wa_buffer[wa_buffer_left].pin); 
         sendmessage();  // send the new event
       }
+#endif // def CONF_WATCHASYNC_BATCH
     }
 #endif // CONF_WATCHASYNC_SUMMARIZE
   }  
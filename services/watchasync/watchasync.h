@@ -442,6 +442,9 @@ struct WatchAsyncBuffer {
   uint32_t timestamp;
 #endif
   uint8_t pin;
+#ifdef CONF_WATCHASYNC_BATCH
+  uint8_t count;  // events on this pin with this timestamp
+#endif
 #endif
 };
 
@@ -44,6 +44,9 @@ struct watchasync_connection_state_t {
   uint8_t pin;
   WATCHASYNC_COUNTER_TYPE count;
 #endif
+#ifdef CONF_WATCHASYNC_BATCH
+  uint8_t records;  // events of the ringbuffer in this request, 0 until sent
+#endif
 };
 
 #endif /* WATCHASYNC_STATE_H */
@@ -42,6 +42,16 @@ static const char PROGMEM watchasync_request_end[] =
     "Host: " CONF_WATCHASYNC_SERVER "\r\n"
     "Content-Length: 0\r\n\r\n";
 
+#ifdef CONF_WATCHASYNC_BATCH
+// head of a batch request, the content length is filled in afterwards;
+// always POST, whatever CONF_WATCHASYNC_METHOD says, as it carries a body
+static const char PROGMEM watchasync_batch_head[] =
+    "POST " CONF_WATCHASYNC_BATCH_PATH " HTTP/1.1\r\n"
+    "Host: " CONF_WATCHASYNC_SERVER "\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: ";
+#endif // def CONF_WATCHASYNC_BATCH
+
 #ifndef CONF_WATCHASYNC_PORT
 #define CONF_WATCHASYNC_PORT 80
 #endif